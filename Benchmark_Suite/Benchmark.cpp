@@ -0,0 +1,446 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include "../Zhang_Shasha_Algorithm/Tree_Editing.h"
+#include "../Zhang_Shasha_Algorithm/Path_Tree_Editing.h"
+#include "../Zhang_Shasha_Algorithm/Demaine_Tree_Editing.h"
+#include "../Selkow_Algorithm/ted.h"
+
+using namespace std;
+
+/**
+* @brief Builds the Node tree, its prepared arrays and the Selkow tree of a generated shape.
+* @param shape Generated tree.
+*/
+Benchmark_Input::Benchmark_Input(const Shape_Tree& shape) : tree(nullptr) {
+   vector<Node*> nodes(shape.size());
+   vector<No*> nos(shape.size());
+   PonteiroNo raiz;
+   for (int k = 0; k < shape.size(); ++k) {
+       nodes[k] = arena.create(shape.labels[k]);
+       PonteiroNo no = arena_nos.criar(string(1, shape.labels[k]));
+       nos[k] = no.get();
+       if (shape.parent[k] < 0) {
+           raiz = move(no);
+       } else {
+           // Children are attached in index order, which is their left-to-right order
+           nodes[shape.parent[k]]->add_child(nodes[k]);
+           nos[shape.parent[k]]->adicionarFilho(move(no));
+       }
+   }
+
+   tree = Tree(nodes[0]);
+   int counter = 0;
+   tree.post_order(tree.get_root(), counter);
+   int last_li = -1;
+   tree.find_keyroots(tree.get_root(), last_li);
+   prepared = Prepared_Tree(tree);
+   arvore.reset(new Arvore(move(raiz)));
+}
+
+/**
+* @brief The engines of this repository, all with unit costs.
+*/
+vector<Benchmark_Engine> defaultEngines() {
+   vector<Benchmark_Engine> engines;
+   engines.push_back({"ZhangShasha", true, [](const Benchmark_Input& a, const Benchmark_Input& b) {
+       Tree_Editing ted;
+       return (double)ted.treeEditDistance(a.prepared, b.prepared);
+   }});
+   engines.push_back({"PathDecomposition", true, [](const Benchmark_Input& a, const Benchmark_Input& b) {
+       Path_Tree_Editing ted(nullptr, nullptr);
+       return (double)ted.treeEditDistance(a.prepared, b.prepared);
+   }});
+   engines.push_back({"Demaine", true, [](const Benchmark_Input& a, const Benchmark_Input& b) {
+       Demaine_Tree_Editing ted(nullptr, nullptr);
+       return (double)ted.treeEditDistance(a.prepared, b.prepared);
+   }});
+   engines.push_back({"Selkow", false, [](const Benchmark_Input& a, const Benchmark_Input& b) {
+       TEDSelkow<Unit_Cost<int>> ted(*a.arvore, *b.arvore);
+       return (double)ted.obterCusto();
+   }});
+   return engines;
+}
+
+/**
+* @brief Value below which a fraction of the sorted samples lie, interpolating between them.
+* @param sorted Samples in increasing order (not empty).
+* @param fraction Between 0 and 1.
+*/
+double percentile(const vector<double>& sorted, double fraction) {
+   const double position = fraction * (sorted.size() - 1);
+   const size_t below = (size_t)position;
+   if (below + 1 >= sorted.size()) {
+       return sorted.back();
+   }
+   return sorted[below] + (position - below) * (sorted[below + 1] - sorted[below]);
+}
+
+/**
+* @brief Minimum, median, 90th percentile, maximum, mean and standard deviation of the timed runs.
+* @param times_ms Run times in milliseconds (not empty).
+*/
+Timing_Stats summarizeTimes(vector<double> times_ms) {
+   sort(times_ms.begin(), times_ms.end());
+   Timing_Stats stats;
+   stats.min_ms = times_ms.front();
+   stats.max_ms = times_ms.back();
+   stats.median_ms = percentile(times_ms, 0.5);
+   stats.p90_ms = percentile(times_ms, 0.9);
+   for (double t : times_ms) stats.mean_ms += t;
+   stats.mean_ms /= times_ms.size();
+   for (double t : times_ms) stats.stddev_ms += (t - stats.mean_ms) * (t - stats.mean_ms);
+   stats.stddev_ms = times_ms.size() > 1 ? sqrt(stats.stddev_ms / (times_ms.size() - 1)) : 0.0;
+   return stats;
+}
+
+/**
+* @brief Fits median time = c * size^exponent over the results of one engine and shape.
+* @param engine Engine name.
+* @param shape Shape name.
+* @param results Every result; the others are ignored.
+* @param floor_ms Medians below this are left out.
+*/
+Exponent_Fit fitExponent(const string& engine, const string& shape, const vector<Benchmark_Result>& results, double floor_ms) {
+   Exponent_Fit fit;
+   fit.engine = engine;
+   fit.shape = shape;
+   double sx = 0, sy = 0, sxx = 0, sxy = 0, syy = 0;
+   for (const Benchmark_Result& result : results) {
+       if (result.engine != engine || result.shape != shape || result.time.median_ms < floor_ms) continue;
+       const double x = log((double)result.size), y = log(result.time.median_ms);
+       sx += x; sy += y; sxx += x * x; sxy += x * y; syy += y * y;
+       ++fit.points;
+   }
+   const double n = fit.points;
+   const double vx = n * sxx - sx * sx, vy = n * syy - sy * sy, cxy = n * sxy - sx * sy;
+   if (fit.points < 2 || vx <= 0) {
+       fit.exponent = fit.r_squared = numeric_limits<double>::quiet_NaN();
+       return fit;
+   }
+   fit.exponent = cxy / vx;
+   fit.r_squared = vy > 0 ? cxy * cxy / (vx * vy) : 1.0;
+   return fit;
+}
+
+/**
+* @brief The fit of an engine and shape, if it was computed.
+*/
+const Exponent_Fit* Benchmark_Report::fit(const string& engine, const string& shape) const {
+   for (const Exponent_Fit& f : fits) {
+       if (f.engine == engine && f.shape == shape) return &f;
+   }
+   return nullptr;
+}
+
+/**
+* @brief Formats a number for CSV and JSON; NaN becomes `nan_text`.
+*/
+static string formatNumber(double value, const char* nan_text) {
+   if (std::isnan(value)) return nan_text;
+   char text[32];
+   snprintf(text, sizeof(text), "%.6g", value);
+   return text;
+}
+
+/**
+* @brief Times one engine on a pair: warm-up runs, then the timed repetitions, each with its
+* heap measured; the process peak RSS is taken over the timed runs. With counters, one more
+* call runs under a Perf_Profile, so the engines' hot loops report their counts by bucket.
+* @param engine Engine to run.
+* @param config Warm-up and repetition counts.
+* @param a First tree.
+* @param b Second tree.
+* @param result Filled with the distance, the timing summary and the memory of the last run.
+*/
+static void timeEngine(const Benchmark_Engine& engine, const Benchmark_Config& config,
+                       const Benchmark_Input& a, const Benchmark_Input& b, Benchmark_Result& result) {
+   for (int run = 0; run < config.warmup; ++run) {
+       result.distance = engine.distance(a, b);
+   }
+   vector<double> times;
+   resetPeakRss();
+   for (int run = 0; run < max(1, config.repetitions); ++run) {
+       Heap_Scope scope;
+       auto start = chrono::steady_clock::now();
+       result.distance = engine.distance(a, b);
+       auto end = chrono::steady_clock::now();
+       result.memory = scope.sample();
+       times.push_back(chrono::duration<double, milli>(end - start).count());
+   }
+   result.peak_rss_kb = peakRssKb();
+   result.repetitions = (int)times.size();
+   result.time = summarizeTimes(times);
+
+   Perf_Counters& counters = threadPerfCounters();
+   if (config.counters && counters.available()) {
+       Perf_Profile profile;
+       {
+           Perf_Profile_Scope scope(profile);
+           Perf_Sample start = counters.read();
+           engine.distance(a, b);
+           result.counters = counters.read() - start;
+       }
+       result.counter_buckets = profile.buckets;
+       for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+           result.counted[e] = counters.has(e);
+       }
+   }
+}
+
+/**
+* @brief True when the result has a counted run.
+*/
+static bool anyCounted(const Benchmark_Result& result) {
+   for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+       if (result.counted[e]) return true;
+   }
+   return false;
+}
+
+/**
+* @brief Counter value of a result as text, empty (`missing`) when the event was not read.
+*/
+static string formatCounter(const Benchmark_Result& result, const Perf_Sample& sample, int event, const char* missing) {
+   return result.counted[event] ? to_string(sample.value[event]) : string(missing);
+}
+
+/**
+* @brief Instructions per cycle, NaN when either was not read or no cycle was counted.
+*/
+static double instructionsPerCycle(const Benchmark_Result& result, const Perf_Sample& sample) {
+   if (!result.counted[Perf_Cycles] || !result.counted[Perf_Instructions] || sample.value[Perf_Cycles] == 0) {
+       return numeric_limits<double>::quiet_NaN();
+   }
+   return (double)sample.value[Perf_Instructions] / sample.value[Perf_Cycles];
+}
+
+/**
+* @brief Logs the counted run: IPC and misses per thousand DP cells of each hot loop bucket.
+*/
+static void logCounters(const Benchmark_Result& result, ostream& out) {
+   char line[200];
+   snprintf(line, sizeof(line), "    counters: %s cycles, %s instructions, IPC %s, L1D misses %s, LLC misses %s, branch misses %s",
+            formatCounter(result, result.counters, Perf_Cycles, "-").c_str(),
+            formatCounter(result, result.counters, Perf_Instructions, "-").c_str(),
+            formatNumber(instructionsPerCycle(result, result.counters), "-").c_str(),
+            formatCounter(result, result.counters, Perf_L1D_Misses, "-").c_str(),
+            formatCounter(result, result.counters, Perf_LLC_Misses, "-").c_str(),
+            formatCounter(result, result.counters, Perf_Branch_Misses, "-").c_str());
+   out << line << endl;
+   for (const Perf_Bucket& bucket : result.counter_buckets) {
+       double kcells = max(1.0, bucket.cells / 1000.0);
+       snprintf(line, sizeof(line), "      %-16s %8zu calls %12llu cells  IPC %5s  L1D %8.2f  LLC %8.2f  branch %8.2f per kcell",
+                bucket.name.c_str(), bucket.calls, bucket.cells,
+                formatNumber(instructionsPerCycle(result, bucket.counts), "-").c_str(),
+                bucket.counts.value[Perf_L1D_Misses] / kcells, bucket.counts.value[Perf_LLC_Misses] / kcells,
+                bucket.counts.value[Perf_Branch_Misses] / kcells);
+       out << line << endl;
+   }
+}
+
+/**
+* @brief Runs the configured engines on every shape and size. Both trees of a pair are
+* generated once and shared by all engines. Sizes run in increasing order, and an engine
+* skips the rest of a shape once the next size, extrapolated from its last two medians,
+* would exceed the budget.
+* @param config What to run.
+* @param engines Available engines; config.engines selects among them.
+* @param out Progress output.
+*/
+Benchmark_Report runBenchmarks(const Benchmark_Config& config, const vector<Benchmark_Engine>& engines, ostream& out) {
+   Benchmark_Report report;
+   report.config = config;
+   vector<const Benchmark_Engine*> selected;
+   for (const Benchmark_Engine& engine : engines) {
+       if (config.engines.empty() || find(config.engines.begin(), config.engines.end(), engine.name) != config.engines.end()) {
+           selected.push_back(&engine);
+       }
+   }
+   vector<int> sizes = config.sizes;
+   sort(sizes.begin(), sizes.end());
+
+   char line[160];
+   for (Tree_Shape shape : config.shapes) {
+       out << "Shape: " << shapeName(shape) << endl;
+       vector<bool> stopped(selected.size(), false);
+       vector<Benchmark_Result> last(selected.size()), before_last(selected.size());
+       for (size_t s = 0; s < sizes.size(); ++s) {
+           bool any = false;
+           for (size_t e = 0; e < selected.size(); ++e) any = any || !stopped[e];
+           if (!any) break;
+
+           Benchmark_Input a(generateShape(shape, sizes[s], config.seed + sizes[s]));
+           Benchmark_Input b(generateShape(shape, sizes[s], config.seed + sizes[s] + 1));
+           double exact_distance = numeric_limits<double>::quiet_NaN();
+           string exact_engine;
+           for (size_t e = 0; e < selected.size(); ++e) {
+               if (stopped[e]) continue;
+               Benchmark_Result result;
+               result.engine = selected[e]->name;
+               result.shape = shapeName(shape);
+               result.size = sizes[s];
+               result.nodes1 = a.size();
+               result.nodes2 = b.size();
+               timeEngine(*selected[e], config, a, b, result);
+               report.results.push_back(result);
+               snprintf(line, sizeof(line), "  %-18s n=%-7d median %10.3f ms  p90 %10.3f ms  heap %10.1f KB  distance %g",
+                        result.engine.c_str(), result.size, result.time.median_ms, result.time.p90_ms,
+                        result.memory.peak_bytes / 1024.0, result.distance);
+               out << line << endl;
+               if (anyCounted(result)) {
+                   logCounters(result, out);
+               }
+
+               if (selected[e]->exact) {
+                   if (exact_engine.empty()) {
+                       exact_engine = result.engine;
+                       exact_distance = result.distance;
+                   } else if (result.distance != exact_distance) {
+                       report.mismatches.push_back(result.shape + " n=" + to_string(result.size) + ": " + exact_engine + " " +
+                                                   formatNumber(exact_distance, "nan") + " vs " + result.engine + " " + formatNumber(result.distance, "nan"));
+                   }
+               }
+
+               before_last[e] = last[e];
+               last[e] = result;
+               if (s + 1 < sizes.size()) {
+                   // Local growth rate from the last two sizes; quadratic until there are two
+                   double exponent = 2.0;
+                   if (before_last[e].size > 0 && before_last[e].time.median_ms >= config.fit_floor_ms) {
+                       exponent = max(1.0, log(last[e].time.median_ms / before_last[e].time.median_ms) /
+                                               log((double)last[e].size / before_last[e].size));
+                   }
+                   const double predicted = last[e].time.median_ms * pow((double)sizes[s + 1] / sizes[s], exponent);
+                   if (predicted > config.budget_ms) {
+                       stopped[e] = true;
+                       out << "  " << result.engine << ": next size predicted at " << (long long)predicted
+                           << " ms, over the budget; larger sizes skipped" << endl;
+                   }
+               }
+           }
+       }
+       for (const Benchmark_Engine* engine : selected) {
+           Exponent_Fit fit = fitExponent(engine->name, shapeName(shape), report.results, config.fit_floor_ms);
+           if (fit.points > 0) {
+               report.fits.push_back(fit);
+           }
+       }
+   }
+   return report;
+}
+
+/**
+* @brief Writes one row per result.
+* @param report Benchmark results.
+* @param path Output file.
+* @return False if the file could not be written.
+*/
+bool writeBenchmarkCSV(const Benchmark_Report& report, const string& path) {
+   ofstream file(path);
+   if (!file.is_open()) {
+       cerr << "Error creating file: " << path << endl;
+       return false;
+   }
+   file << "Engine,Shape,Size,Nodes1,Nodes2,Distance,Repetitions,MinMs,MedianMs,P90Ms,MaxMs,MeanMs,StdDevMs,PeakHeapBytes,LiveHeapBytes,Allocations,PeakRssKB,Cycles,Instructions,L1DMisses,LLCMisses,BranchMisses,IPC,Exponent\n";
+   for (const Benchmark_Result& r : report.results) {
+       const Exponent_Fit* fit = report.fit(r.engine, r.shape);
+       file << r.engine << "," << r.shape << "," << r.size << "," << r.nodes1 << "," << r.nodes2 << ","
+            << formatNumber(r.distance, "") << "," << r.repetitions << ","
+            << formatNumber(r.time.min_ms, "") << "," << formatNumber(r.time.median_ms, "") << ","
+            << formatNumber(r.time.p90_ms, "") << "," << formatNumber(r.time.max_ms, "") << ","
+            << formatNumber(r.time.mean_ms, "") << "," << formatNumber(r.time.stddev_ms, "") << ","
+            << r.memory.peak_bytes << "," << r.memory.live_bytes << "," << r.memory.allocations << ","
+            << r.peak_rss_kb << ",";
+       for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+           file << formatCounter(r, r.counters, e, "") << ",";
+       }
+       file << formatNumber(instructionsPerCycle(r, r.counters), "") << ","
+            << (fit ? formatNumber(fit->exponent, "") : "") << "\n";
+   }
+   return (bool)file;
+}
+
+/**
+* @brief Writes the configuration, the results and the fits as one JSON object.
+* @param report Benchmark results.
+* @param path Output file.
+* @return False if the file could not be written.
+*/
+bool writeBenchmarkJSON(const Benchmark_Report& report, const string& path) {
+   ofstream file(path);
+   if (!file.is_open()) {
+       cerr << "Error creating file: " << path << endl;
+       return false;
+   }
+   // Names are engine and shape identifiers, which need no escaping
+   auto list = [](const vector<string>& items) {
+       string text = "[";
+       for (size_t k = 0; k < items.size(); ++k) text += (k ? ", \"" : "\"") + items[k] + "\"";
+       return text + "]";
+   };
+   const Benchmark_Config& c = report.config;
+   vector<string> shapes;
+   for (Tree_Shape shape : c.shapes) shapes.push_back(shapeName(shape));
+   string sizes = "[";
+   for (size_t k = 0; k < c.sizes.size(); ++k) sizes += (k ? ", " : "") + to_string(c.sizes[k]);
+   sizes += "]";
+
+   file << "{\n  \"schema\": \"ted-benchmark\",\n  \"version\": 3,\n";
+   file << "  \"config\": {\"shapes\": " << list(shapes) << ", \"sizes\": " << sizes
+        << ", \"engines\": " << list(c.engines) << ", \"warmup\": " << c.warmup
+        << ", \"repetitions\": " << c.repetitions << ", \"budget_ms\": " << formatNumber(c.budget_ms, "null")
+        << ", \"seed\": " << c.seed << ", \"counters\": " << (c.counters ? "true" : "false") << "},\n";
+
+   // Counted events of one sample, then its IPC
+   auto counterFields = [](const Benchmark_Result& r, const Perf_Sample& sample) {
+       string text;
+       for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+           text += string("\"") + perfEventName(e) + "\": " + formatCounter(r, sample, e, "null") + ", ";
+       }
+       return text + "\"ipc\": " + formatNumber(instructionsPerCycle(r, sample), "null");
+   };
+
+   file << "  \"results\": [";
+   for (size_t k = 0; k < report.results.size(); ++k) {
+       const Benchmark_Result& r = report.results[k];
+       const Exponent_Fit* fit = report.fit(r.engine, r.shape);
+       file << (k ? ",\n" : "\n") << "    {\"engine\": \"" << r.engine << "\", \"shape\": \"" << r.shape
+            << "\", \"size\": " << r.size << ", \"nodes1\": " << r.nodes1 << ", \"nodes2\": " << r.nodes2
+            << ", \"distance\": " << formatNumber(r.distance, "null") << ", \"repetitions\": " << r.repetitions
+            << ", \"min_ms\": " << formatNumber(r.time.min_ms, "null")
+            << ", \"median_ms\": " << formatNumber(r.time.median_ms, "null")
+            << ", \"p90_ms\": " << formatNumber(r.time.p90_ms, "null")
+            << ", \"max_ms\": " << formatNumber(r.time.max_ms, "null")
+            << ", \"mean_ms\": " << formatNumber(r.time.mean_ms, "null")
+            << ", \"stddev_ms\": " << formatNumber(r.time.stddev_ms, "null")
+            << ", \"peak_heap_bytes\": " << r.memory.peak_bytes << ", \"live_heap_bytes\": " << r.memory.live_bytes
+            << ", \"allocations\": " << r.memory.allocations << ", \"peak_rss_kb\": " << r.peak_rss_kb
+            << ", \"exponent\": " << (fit ? formatNumber(fit->exponent, "null") : "null") << ", \"counters\": ";
+       if (!anyCounted(r)) {
+           file << "null}";
+           continue;
+       }
+       file << "{" << counterFields(r, r.counters) << ", \"buckets\": [";
+       for (size_t b = 0; b < r.counter_buckets.size(); ++b) {
+           const Perf_Bucket& bucket = r.counter_buckets[b];
+           file << (b ? ", " : "") << "{\"name\": \"" << bucket.name << "\", \"calls\": " << bucket.calls
+                << ", \"cells\": " << bucket.cells << ", " << counterFields(r, bucket.counts) << "}";
+       }
+       file << "]}}";
+   }
+   file << "\n  ],\n  \"fits\": [";
+   for (size_t k = 0; k < report.fits.size(); ++k) {
+       const Exponent_Fit& f = report.fits[k];
+       file << (k ? ",\n" : "\n") << "    {\"engine\": \"" << f.engine << "\", \"shape\": \"" << f.shape
+            << "\", \"exponent\": " << formatNumber(f.exponent, "null")
+            << ", \"r_squared\": " << formatNumber(f.r_squared, "null") << ", \"points\": " << f.points << "}";
+   }
+   file << "\n  ],\n  \"mismatches\": " << list(report.mismatches) << "\n}\n";
+   return (bool)file;
+}
@@ -0,0 +1,121 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Tree_Shapes.h"
+#include "../Zhang_Shasha_Algorithm/Tree.h"
+#include "../Zhang_Shasha_Algorithm/Prepared_Tree.h"
+#include "../Zhang_Shasha_Algorithm/Node_Arena.h"
+#include "../Zhang_Shasha_Algorithm/Memory_Usage.h"
+#include "../Zhang_Shasha_Algorithm/Perf_Counters.h"
+#include "../Selkow_Algorithm/arvore.h"
+
+using namespace std;
+
+// One generated tree in every input format the engines take, built before any timing
+// starts so every engine is timed on its own distance call only. Not copyable: the trees
+// live in the input's arenas
+class Benchmark_Input {
+public:
+    Node_Arena arena;
+    Tree tree;               // Post-order indices and keyroots already computed
+    Prepared_Tree prepared;
+    ArenaDeNos arena_nos;
+    unique_ptr<Arvore> arvore;  // Labels as one-letter strings
+
+    explicit Benchmark_Input(const Shape_Tree& shape);
+    Benchmark_Input(const Benchmark_Input&) = delete;
+    Benchmark_Input& operator=(const Benchmark_Input&) = delete;
+
+    int size() const { return prepared.size(); }
+};
+
+// An engine under test. `distance` runs one complete unit-cost distance computation,
+// including whatever workspace the engine allocates per call. Exact engines compute the
+// unrestricted tree edit distance, so they must agree on every pair; Selkow's distance
+// only matches nodes at equal depth and may be larger
+struct Benchmark_Engine {
+    string name;
+    bool exact;
+    function<double(const Benchmark_Input&, const Benchmark_Input&)> distance;
+};
+
+// ZhangShasha, PathDecomposition, Demaine and Selkow; a new engine is one more entry
+vector<Benchmark_Engine> defaultEngines();
+
+struct Benchmark_Config {
+    vector<Tree_Shape> shapes = allShapes();
+    vector<int> sizes = {64, 128, 256, 512, 1024};
+    vector<string> engines;       // Names to run, empty for all
+    int warmup = 1;               // Untimed runs before the timed ones
+    int repetitions = 5;
+    double budget_ms = 1000;      // An engine stops growing once its next run is predicted slower
+    double fit_floor_ms = 0.01;   // Faster medians are timer noise and left out of the fit
+    unsigned seed = 1;            // Tree 1 uses seed + size, tree 2 the next seed
+    bool counters = false;        // One more untimed run per pair, read with hardware counters
+};
+
+// Summary of the timed repetitions; percentiles are interpolated between samples
+struct Timing_Stats {
+    double min_ms = 0;
+    double median_ms = 0;
+    double p90_ms = 0;
+    double max_ms = 0;
+    double mean_ms = 0;
+    double stddev_ms = 0;
+};
+
+Timing_Stats summarizeTimes(vector<double> times_ms);
+double percentile(const vector<double>& sorted, double fraction);
+
+// One engine on one pair of trees
+struct Benchmark_Result {
+    string engine;
+    string shape;
+    int size = 0;
+    int nodes1 = 0;
+    int nodes2 = 0;
+    double distance = 0;
+    int repetitions = 0;
+    Timing_Stats time;
+    Heap_Sample memory;    // Heap of one timed call; live bytes are what the call left allocated
+    long peak_rss_kb = 0;  // Process peak RSS over the engine's runs on this pair
+    bool counted[PERF_EVENT_COUNT] = {};  // Events read in the counted run; all false without counters
+    Perf_Sample counters;                 // The whole counted call
+    vector<Perf_Bucket> counter_buckets;  // Hot loops of that call: ZS keyroot pairs by size, Selkow's recursion
+};
+
+// Empirical complexity: least-squares slope of log(median time) against log(size), so
+// time grows roughly like size^exponent. NaN with fewer than two usable points
+struct Exponent_Fit {
+    string engine;
+    string shape;
+    double exponent = 0;
+    double r_squared = 0;
+    int points = 0;
+};
+
+Exponent_Fit fitExponent(const string& engine, const string& shape, const vector<Benchmark_Result>& results, double floor_ms);
+
+struct Benchmark_Report {
+    Benchmark_Config config;
+    vector<Benchmark_Result> results;
+    vector<Exponent_Fit> fits;
+    vector<string> mismatches;  // Pairs where exact engines disagreed
+
+    const Exponent_Fit* fit(const string& engine, const string& shape) const;
+};
+
+// Runs every engine on every shape and size, logging progress to `out`
+Benchmark_Report runBenchmarks(const Benchmark_Config& config, const vector<Benchmark_Engine>& engines, ostream& out);
+
+// Both files hold the same fields: one row or object per result, with the fitted exponent
+// of its engine and shape; the JSON also lists the configuration and the fits
+bool writeBenchmarkCSV(const Benchmark_Report& report, const string& path);
+bool writeBenchmarkJSON(const Benchmark_Report& report, const string& path);
+
+#endif // BENCHMARK_H
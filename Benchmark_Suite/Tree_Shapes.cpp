@@ -0,0 +1,83 @@
+#include "Tree_Shapes.h"
+
+#include <algorithm>
+#include <random>
+
+using namespace std;
+
+/**
+* @brief Name of a shape, as used on the command line and in the results.
+* @param shape Shape.
+*/
+const char* shapeName(Tree_Shape shape) {
+   switch (shape) {
+       case Tree_Shape::Chain: return "chain";
+       case Tree_Shape::Balanced: return "balanced";
+       case Tree_Shape::Star: return "star";
+       case Tree_Shape::Random: return "random";
+       case Tree_Shape::Caterpillar: return "caterpillar";
+   }
+   return "unknown";
+}
+
+/**
+* @brief Looks a shape up by its name.
+* @param name Name as returned by shapeName.
+* @param shape Set to the shape when the name is known.
+* @return False for an unknown name.
+*/
+bool parseShape(const string& name, Tree_Shape& shape) {
+   for (Tree_Shape candidate : allShapes()) {
+       if (name == shapeName(candidate)) {
+           shape = candidate;
+           return true;
+       }
+   }
+   return false;
+}
+
+/**
+* @brief Every shape, in the order they are reported.
+*/
+vector<Tree_Shape> allShapes() {
+   return {Tree_Shape::Chain, Tree_Shape::Balanced, Tree_Shape::Star, Tree_Shape::Random, Tree_Shape::Caterpillar};
+}
+
+/**
+* @brief Generates a tree of the given shape with random labels.
+* @param shape Shape of the tree.
+* @param nodes Number of nodes (at least 1).
+* @param seed Seed of the labels and, for Random, of the structure.
+*/
+Shape_Tree generateShape(Tree_Shape shape, int nodes, unsigned seed) {
+   mt19937 random(seed);
+   Shape_Tree tree;
+   tree.parent.resize(max(1, nodes));
+   tree.labels.resize(tree.parent.size());
+   tree.parent[0] = -1;
+   for (int k = 1; k < tree.size(); ++k) {
+       switch (shape) {
+           case Tree_Shape::Chain:
+               tree.parent[k] = k - 1;
+               break;
+           case Tree_Shape::Balanced:
+               tree.parent[k] = (k - 1) / 2;
+               break;
+           case Tree_Shape::Star:
+               tree.parent[k] = 0;
+               break;
+           case Tree_Shape::Random:
+               tree.parent[k] = (int)(random() % k);
+               break;
+           case Tree_Shape::Caterpillar:
+               // Odd nodes are leaves and even nodes continue the spine, both under the
+               // previous spine node
+               tree.parent[k] = (k - 1) & ~1;
+               break;
+       }
+   }
+   for (char& label : tree.labels) {
+       label = (char)('a' + random() % 26);
+   }
+   return tree;
+}
@@ -0,0 +1,34 @@
+#ifndef TREE_SHAPES_H
+#define TREE_SHAPES_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Tree shapes the benchmark sweeps; each stresses the engines differently:
+//   Chain        every node has one child (depth n, one keyroot)
+//   Balanced     complete binary tree, filled level by level (depth log n)
+//   Star         a root over n - 1 leaves (depth 1, n - 1 keyroots)
+//   Random       every node hangs from a uniformly chosen earlier node
+//   Caterpillar  a spine whose nodes each have a leaf child before the next spine node, so
+//                every spine node is a keyroot and the leftmost paths stay short
+enum class Tree_Shape { Chain, Balanced, Star, Random, Caterpillar };
+
+const char* shapeName(Tree_Shape shape);
+bool parseShape(const string& name, Tree_Shape& shape);
+vector<Tree_Shape> allShapes();
+
+// Engine-neutral tree: node k hangs from parent[k] < k (-1 for the root, node 0), and the
+// children of a node are in increasing index order. Labels are drawn from 'a'..'z'
+struct Shape_Tree {
+    vector<int> parent;
+    vector<char> labels;
+
+    int size() const { return (int)parent.size(); }
+};
+
+// Same shape and seed give the same tree on every platform (the generator is mt19937)
+Shape_Tree generateShape(Tree_Shape shape, int nodes, unsigned seed);
+
+#endif // TREE_SHAPES_H
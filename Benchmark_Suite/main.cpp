@@ -0,0 +1,138 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include "Benchmark.h"
+#include "Tree_Shapes.h"
+
+using namespace std;
+
+// Splits a comma-separated list
+vector<string> splitList(const string& text) {
+    vector<string> items;
+    stringstream stream(text);
+    string item;
+    while (getline(stream, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+void printUsage(const vector<Benchmark_Engine>& engines) {
+    cout << "Usage: benchmark [options]\n"
+         << "  --engines a,b     engines to run (default: all)\n"
+         << "  --shapes a,b      chain, balanced, star, random, caterpillar (default: all)\n"
+         << "  --sizes n,m       tree sizes in nodes (default: 64,128,256,512,1024)\n"
+         << "  --warmup k        untimed runs before timing (default: 1)\n"
+         << "  --reps k          timed runs per engine and pair (default: 5)\n"
+         << "  --budget-ms t     skip sizes predicted to take longer than t ms per run (default: 1000)\n"
+         << "  --seed s          seed of the generated trees (default: 1)\n"
+         << "  --counters        one more run per pair read with hardware performance counters\n"
+         << "  --csv path        CSV output (default: BENCHMARK_results.csv)\n"
+         << "  --json path       JSON output (default: BENCHMARK_results.json)\n"
+         << "Engines:";
+    for (const Benchmark_Engine& engine : engines) cout << " " << engine.name;
+    cout << endl;
+}
+
+/**
+ * @brief Runs every engine on the same generated trees and writes one CSV and one JSON file
+ */
+int main(int argc, char** argv) {
+    vector<Benchmark_Engine> engines = defaultEngines();
+    Benchmark_Config config;
+    string csv_path = "BENCHMARK_results.csv";
+    string json_path = "BENCHMARK_results.json";
+
+    for (int i = 1; i < argc; ++i) {
+        string option = argv[i];
+        if (option == "--help" || option == "-h") {
+            printUsage(engines);
+            return 0;
+        }
+        if (option == "--counters") {
+            config.counters = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << option << endl;
+            return 1;
+        }
+        string value = argv[++i];
+        if (option == "--engines") {
+            config.engines = splitList(value);
+            for (const string& name : config.engines) {
+                bool known = false;
+                for (const Benchmark_Engine& engine : engines) known = known || engine.name == name;
+                if (!known) {
+                    cerr << "Unknown engine: " << name << endl;
+                    return 1;
+                }
+            }
+        } else if (option == "--shapes") {
+            config.shapes.clear();
+            for (const string& name : splitList(value)) {
+                Tree_Shape shape;
+                if (!parseShape(name, shape)) {
+                    cerr << "Unknown shape: " << name << endl;
+                    return 1;
+                }
+                config.shapes.push_back(shape);
+            }
+        } else if (option == "--sizes") {
+            config.sizes.clear();
+            for (const string& size : splitList(value)) config.sizes.push_back(max(1, atoi(size.c_str())));
+        } else if (option == "--warmup") {
+            config.warmup = max(0, atoi(value.c_str()));
+        } else if (option == "--reps") {
+            config.repetitions = max(1, atoi(value.c_str()));
+        } else if (option == "--budget-ms") {
+            config.budget_ms = atof(value.c_str());
+        } else if (option == "--seed") {
+            config.seed = (unsigned)strtoul(value.c_str(), nullptr, 10);
+        } else if (option == "--csv") {
+            csv_path = value;
+        } else if (option == "--json") {
+            json_path = value;
+        } else {
+            cerr << "Unknown option: " << option << endl;
+            printUsage(engines);
+            return 1;
+        }
+    }
+
+    cout << "========================================" << endl;
+    cout << "  BENCHMARK SUITE - ALL ENGINES" << endl;
+    cout << "       Tree Edit Distance (TED)" << endl;
+    cout << "========================================" << endl << endl;
+    cout << "Warm-up runs: " << config.warmup << ", timed runs: " << config.repetitions
+         << ", budget: " << config.budget_ms << " ms per run" << endl;
+    if (config.counters && !threadPerfCounters().available()) {
+        cout << "Hardware counters unavailable (perf_event_open refused, see kernel.perf_event_paranoid); timing only" << endl;
+        config.counters = false;
+    }
+    cout << "------------------------------------------------------------" << endl;
+
+    Benchmark_Report report = runBenchmarks(config, engines, cout);
+
+    cout << "------------------------------------------------------------" << endl;
+    cout << "Fitted exponents (median time ~ size^k):" << endl;
+    for (const Exponent_Fit& fit : report.fits) {
+        char line[128];
+        snprintf(line, sizeof(line), "  %-18s %-12s k = %5.2f  (r^2 %.3f, %d sizes)",
+                 fit.engine.c_str(), fit.shape.c_str(), fit.exponent, fit.r_squared, fit.points);
+        cout << line << endl;
+    }
+    for (const string& mismatch : report.mismatches) {
+        cout << "Exact engines disagree on " << mismatch << endl;
+    }
+
+    bool written = writeBenchmarkCSV(report, csv_path) && writeBenchmarkJSON(report, json_path);
+    if (written) {
+        cout << "Results saved to: " << csv_path << " and " << json_path << endl;
+    }
+    return written && report.mismatches.empty() ? 0 : 1;
+}
@@ -1,89 +1,147 @@
 #include "arvore.h"
 
+#include <algorithm>
+#include <new>
+
+void LiberadorDeNo::operator()(No* no) const {
+    if (!daArena) {
+        delete no;
+    }
+}
+
 // Implementações da classe No
-No::No(string rotuloDoNo) : rotulo(move(rotuloDoNo)) {}
+No::No(string rotuloDoNo, pmr::memory_resource* memoria) : rotulo(move(rotuloDoNo)), filhos(memoria) {}
 
-void No::adicionarFilho(unique_ptr<No> ponteiroParaNoFilho) {
+No::~No() {
+    // Os descendentes são destruídos já sem filhos, um de cada vez
+    vector<PonteiroNo> pendentes;
+    for (PonteiroNo& filho : filhos) {
+        pendentes.push_back(move(filho));
+    }
+    filhos.clear();
+    while (!pendentes.empty()) {
+        PonteiroNo no = move(pendentes.back());
+        pendentes.pop_back();
+        if (no.get_deleter().daArena) {
+            continue;
+        }
+        for (PonteiroNo& filho : no->filhos) {
+            pendentes.push_back(move(filho));
+        }
+        no->filhos.clear();
+    }
+}
+
+void No::adicionarFilho(PonteiroNo ponteiroParaNoFilho) {
     filhos.push_back(move(ponteiroParaNoFilho));
 }
 
+// Implementações da classe ArenaDeNos
+ArenaDeNos::ArenaDeNos(size_t bytesDoPrimeiroBloco) : memoria(bytesDoPrimeiroBloco) {}
+
+ArenaDeNos::~ArenaDeNos() {
+    liberar();
+}
+
+PonteiroNo ArenaDeNos::criar(const string& rotulo) {
+    void* lugar = memoria.allocate(sizeof(No), alignof(No));
+    No* no = new (lugar) No(rotulo, &memoria);
+    if (no->rotulo.capacity() > string().capacity()) {
+        comRotuloLongo.push_back(no);
+    }
+    ++nos;
+    return PonteiroNo(no, LiberadorDeNo(true));
+}
+
+void ArenaDeNos::liberar() {
+    // A lista de filhos está na arena; fora dela, só os rótulos longos
+    for (No* no : comRotuloLongo) {
+        no->~No();
+    }
+    comRotuloLongo.clear();
+    memoria.release();
+    nos = 0;
+}
+
 // Implementações da classe Arvore
-Arvore::Arvore(unique_ptr<No> ponteiroParaNoRaiz) : noRaiz(move(ponteiroParaNoRaiz)) {}
+Arvore::Arvore(PonteiroNo ponteiroParaNoRaiz) : noRaiz(move(ponteiroParaNoRaiz)) {}
 
 const No* Arvore::obterNoRaiz() const {
     return noRaiz.get();
 }
 
-void Arvore::obterNosEmPosOrdemRecursivamente(const No* noAtual, vector<const No*>& listaDeNos) const {
-    if (noAtual == nullptr) return;
-    for (const unique_ptr<No>& ponteiroParaFilho : noAtual->filhos) {
-        obterNosEmPosOrdemRecursivamente(ponteiroParaFilho.get(), listaDeNos);
+template <class Visitante>
+void Arvore::percorrerEmPreOrdem(Visitante visitar) const {
+    if (noRaiz == nullptr) return;
+    vector<pair<const No*, int>> pilha = {make_pair(noRaiz.get(), 0)};
+    while (!pilha.empty()) {
+        pair<const No*, int> atual = pilha.back();
+        pilha.pop_back();
+        if (visitar(atual.first, atual.second)) return;
+        // Da direita para a esquerda, para o filho mais à esquerda sair primeiro
+        for (auto filho = atual.first->filhos.rbegin(); filho != atual.first->filhos.rend(); ++filho) {
+            pilha.push_back(make_pair(filho->get(), atual.second + 1));
+        }
     }
-    listaDeNos.push_back(noAtual);
 }
 
 vector<const No*> Arvore::obterNosEmPosOrdem() const {
     vector<const No*> listaDeNosResultado;
-    obterNosEmPosOrdemRecursivamente(noRaiz.get(), listaDeNosResultado);
-    return listaDeNosResultado;
-}
-
-void Arvore::obterProfundidadesRecursivamente(const No* noAtual, int profundidadeAtual, unordered_map<const No*, int>& mapaDeProfundidades) const {
-    if (noAtual == nullptr) return;
-    mapaDeProfundidades[noAtual] = profundidadeAtual;
-    for (const unique_ptr<No>& ponteiroParaFilho : noAtual->filhos) {
-        obterProfundidadesRecursivamente(ponteiroParaFilho.get(), profundidadeAtual + 1, mapaDeProfundidades);
+    if (noRaiz == nullptr) return listaDeNosResultado;
+    // Pré-ordem empilhando os filhos da esquerda para a direita visita cada subárvore da
+    // direita para a esquerda; invertida, é exatamente a pós-ordem
+    vector<const No*> pilha = {noRaiz.get()};
+    while (!pilha.empty()) {
+        const No* noAtual = pilha.back();
+        pilha.pop_back();
+        listaDeNosResultado.push_back(noAtual);
+        for (const PonteiroNo& ponteiroParaFilho : noAtual->filhos) {
+            pilha.push_back(ponteiroParaFilho.get());
+        }
     }
+    reverse(listaDeNosResultado.begin(), listaDeNosResultado.end());
+    return listaDeNosResultado;
 }
 
 unordered_map<const No*, int> Arvore::obterProfundidades() const {
     unordered_map<const No*, int> mapaNoParaProfundidade;
-    obterProfundidadesRecursivamente(noRaiz.get(), 0, mapaNoParaProfundidade);
+    percorrerEmPreOrdem([&](const No* no, int profundidade) {
+        mapaNoParaProfundidade[no] = profundidade;
+        return false;
+    });
     return mapaNoParaProfundidade;
 }
 
-int Arvore::obterTamanhosDasSubarvoresRecursivamente(const No* noAtual, unordered_map<const No*, int>& mapaDeTamanhos) const {
-    if (noAtual == nullptr) return 0;
-    int tamanhoAcumulado = 1; // Começa em 1 para contar o próprio nó.
-    for (const unique_ptr<No>& ponteiroParaFilho : noAtual->filhos) {
-        tamanhoAcumulado += obterTamanhosDasSubarvoresRecursivamente(ponteiroParaFilho.get(), mapaDeTamanhos);
-    }
-    mapaDeTamanhos[noAtual] = tamanhoAcumulado;
-    return tamanhoAcumulado;
-}
-
 unordered_map<const No*, int> Arvore::obterTamanhosDasSubarvores() const {
     unordered_map<const No*, int> mapaNoParaTamanho;
-    obterTamanhosDasSubarvoresRecursivamente(noRaiz.get(), mapaNoParaTamanho);
-    return mapaNoParaTamanho;
-}
-
-int Arvore::obterProfundidadeDoNoRecursivamente(const No* noAtual, const No* noProcurado, int profundidadeAtual) const {
-    if (noAtual == nullptr) return -1;
-    if (noAtual == noProcurado) return profundidadeAtual;
-    
-    for (const unique_ptr<No>& filho : noAtual->filhos) {
-        int resultado = obterProfundidadeDoNoRecursivamente(filho.get(), noProcurado, profundidadeAtual + 1);
-        if (resultado != -1) return resultado;
+    // Na pós-ordem os filhos já têm tamanho quando o pai é visitado
+    for (const No* no : obterNosEmPosOrdem()) {
+        int tamanhoAcumulado = 1; // Começa em 1 para contar o próprio nó.
+        for (const PonteiroNo& ponteiroParaFilho : no->filhos) {
+            tamanhoAcumulado += mapaNoParaTamanho[ponteiroParaFilho.get()];
+        }
+        mapaNoParaTamanho[no] = tamanhoAcumulado;
     }
-    return -1;
+    return mapaNoParaTamanho;
 }
 
 int Arvore::obterProfundidadeDoNo(const No* no) const {
-    return obterProfundidadeDoNoRecursivamente(noRaiz.get(), no, 0);
-}
-
-int Arvore::contarNosRecursivamente(const No* noAtual) const {
-    if (noAtual == nullptr) return 0;
-    int contador = 1; // Conta o nó atual
-    for (const unique_ptr<No>& filho : noAtual->filhos) {
-        contador += contarNosRecursivamente(filho.get());
-    }
-    return contador;
+    int profundidadeEncontrada = -1;
+    percorrerEmPreOrdem([&](const No* noAtual, int profundidade) {
+        if (noAtual != no) return false;
+        profundidadeEncontrada = profundidade;
+        return true;
+    });
+    return profundidadeEncontrada;
 }
 
 int Arvore::contarNos() const {
-    return contarNosRecursivamente(noRaiz.get());
+    int contador = 0;
+    percorrerEmPreOrdem([&](const No*, int) {
+        ++contador;
+        return false;
+    });
+    return contador;
 }
 
 bool Arvore::ehFolha(const No* no) const {
@@ -109,7 +167,7 @@ void imprimirArvoreRecursivamente(ostream& streamDeSaida, const No* noAtual, con
 
     // Prepara o prefixo para os nós filhos
     const string novoPrefixo = prefixoDeIndentacao + (ehUltimoFilho ? "    " : "│   ");
-    const vector<unique_ptr<No>>& filhosDoNoAtual = noAtual->filhos;
+    const pmr::vector<PonteiroNo>& filhosDoNoAtual = noAtual->filhos;
     for (size_t i = 0; i < filhosDoNoAtual.size(); ++i) {
         imprimirArvoreRecursivamente(streamDeSaida, filhosDoNoAtual[i].get(), novoPrefixo, i == filhosDoNoAtual.size() - 1);
     }
@@ -123,18 +181,18 @@ ostream& operator<<(ostream& streamDeSaida, const Arvore& arvoreParaImprimir) {
     }
 
     streamDeSaida << ponteiroParaRaiz->rotulo << "\n";
-    const vector<unique_ptr<No>>& filhosDaRaiz = ponteiroParaRaiz->filhos;
+    const pmr::vector<PonteiroNo>& filhosDaRaiz = ponteiroParaRaiz->filhos;
     for (size_t i = 0; i < filhosDaRaiz.size(); ++i) {
         imprimirArvoreRecursivamente(streamDeSaida, filhosDaRaiz[i].get(), "", i == filhosDaRaiz.size() - 1);
     }
     return streamDeSaida;
 }
 
-unique_ptr<No> criarNo(const string& rotulo) {
-    return make_unique<No>(rotulo);
+PonteiroNo criarNo(const string& rotulo, ArenaDeNos* arena) {
+    return arena ? arena->criar(rotulo) : PonteiroNo(new No(rotulo));
 }
 
-unique_ptr<No> criarArvoreAleatoria(int numNos, int seed) {
+PonteiroNo criarArvoreAleatoria(int numNos, int seed, ArenaDeNos* arena) {
     int numeroNo = 0;
     if (numNos <= 0) {
         return nullptr;
@@ -145,13 +203,13 @@ unique_ptr<No> criarArvoreAleatoria(int numNos, int seed) {
     vector<No*> nosDisponiveis; // Pool de nós que podem receber filhos
     
     // Criar nó raiz
-    auto raiz = criarNo(to_string(numeroNo)); 
+    auto raiz = criarNo(to_string(numeroNo), arena); 
     numeroNo++;
     nosDisponiveis.push_back(raiz.get());
     
     // Adicionar nós restantes
     for (int i = 1; i < numNos; ++i) {
-        auto novoNo = criarNo(to_string(numeroNo));
+        auto novoNo = criarNo(to_string(numeroNo), arena);
         numeroNo++;
         // Escolher pai aleatório
         No* pai = nosDisponiveis[rand() % nosDisponiveis.size()];
@@ -163,22 +221,22 @@ unique_ptr<No> criarArvoreAleatoria(int numNos, int seed) {
       return raiz;
 }
 
-unique_ptr<No> criarArvoreCompleta(int numNos) {
+PonteiroNo criarArvoreCompleta(int numNos, ArenaDeNos* arena) {
     if (numNos <= 0) {
         return nullptr;
     }
     
     if (numNos == 1) {
         // Árvore com apenas a raiz
-        return criarNo("0");
+        return criarNo("0", arena);
     }
     
     // Criar nó raiz
-    auto raiz = criarNo("0");
+    auto raiz = criarNo("0", arena);
     
     // Adicionar N-1 filhos (todos são folhas)
     for (int i = 1; i < numNos; ++i) {
-        auto filho = criarNo(to_string(i));
+        auto filho = criarNo(to_string(i), arena);
         raiz->adicionarFilho(move(filho));
     }
     
@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <memory_resource>
 #include <utility>
 #include <unordered_map>
 #include <cstdlib>
@@ -12,6 +13,25 @@
 
 using namespace std;
 
+class No;
+
+/**
+ * @brief Liberador dos ponteiros de nós: apaga os nós criados com new e ignora os de uma
+ * ArenaDeNos, que são liberados junto com a arena.
+ */
+struct LiberadorDeNo {
+    bool daArena = false;
+
+    LiberadorDeNo() = default;
+    explicit LiberadorDeNo(bool noDaArena) : daArena(noDaArena) {}
+    // Permite passar unique_ptr<No> onde se espera um PonteiroNo
+    LiberadorDeNo(default_delete<No>) {}
+
+    void operator()(No* no) const;
+};
+
+using PonteiroNo = unique_ptr<No, LiberadorDeNo>;
+
 /**
  * @brief Representa um único nó (ou vértice) em uma árvore.
  * Cada nó contém um dado (o rótulo) e ponteiros para seus descendentes diretos (os filhos).
@@ -19,20 +39,63 @@ using namespace std;
 class No {
 public:
     string rotulo;
-    vector<unique_ptr<No>> filhos;
+    pmr::vector<PonteiroNo> filhos;  // Alocados na arena do nó, se ele vier de uma
 
     /**
      * @brief Construtor que cria um nó com um rótulo específico.
      * @param rotuloDoNo O valor textual que este nó irá armazenar.
+     * @param memoria Onde a lista de filhos é alocada (o heap, fora de uma ArenaDeNos).
+     */
+    No(string rotuloDoNo, pmr::memory_resource* memoria = pmr::get_default_resource());
+
+    /**
+     * @brief Destrói a subárvore com uma pilha explícita: os filhos são desligados antes de
+     * serem destruídos, então uma cadeia longa não esgota a pilha de chamadas. Filhos de
+     * arena ficam para a arena.
      */
-    No(string rotuloDoNo);
+    ~No();
 
     /**
      * @brief Adiciona um nó à lista de filhos deste nó.
      * A posse do ponteiro do filho é transferida para a lista de filhos.
      * @param ponteiroParaNoFilho O ponteiro inteligente para o nó a ser adicionado.
      */
-    void adicionarFilho(unique_ptr<No> ponteiroParaNoFilho);
+    void adicionarFilho(PonteiroNo ponteiroParaNoFilho);
+};
+
+/**
+ * @brief Aloca nós e listas de filhos em blocos grandes, na ordem de criação, em vez de
+ * uma alocação por nó e outra por lista de filhos, e libera a árvore inteira de uma vez,
+ * sem percorrer os nós. Os ponteiros criados pela arena não apagam o nó: a Arvore
+ * que os usa deve ser destruída antes da arena ou de liberar(), e os filhos de um nó da
+ * arena devem vir da mesma arena.
+ */
+class ArenaDeNos {
+public:
+    explicit ArenaDeNos(size_t bytesDoPrimeiroBloco = 1 << 16);
+    ~ArenaDeNos();
+    ArenaDeNos(const ArenaDeNos&) = delete;
+    ArenaDeNos& operator=(const ArenaDeNos&) = delete;
+
+    /**
+     * @brief Cria um nó na arena.
+     * @param rotulo Rótulo do nó.
+     */
+    PonteiroNo criar(const string& rotulo);
+
+    /**
+     * @brief Libera todos os nós criados até aqui.
+     */
+    void liberar();
+
+    size_t tamanho() const { return nos; }
+
+private:
+    pmr::monotonic_buffer_resource memoria;
+    // Nós cujo rótulo não coube na própria string e foi alocado no heap na criação; só eles
+    // precisam do destrutor
+    vector<No*> comRotuloLongo;
+    size_t nos = 0;
 };
 
 /**
@@ -41,22 +104,22 @@ public:
  */
 class Arvore {
 private:
-    unique_ptr<No> noRaiz;
+    PonteiroNo noRaiz;
 
     // Funções Auxiliares Recursivas
      const No* encontrarNoPorRotuloRecursivamente(const No* noAtual, const string& rotulo) const;
-    void obterNosEmPosOrdemRecursivamente(const No* noAtual, vector<const No*>& listaDeNos) const;
-    void obterProfundidadesRecursivamente(const No* noAtual, int profundidadeAtual, unordered_map<const No*, int>& mapaDeProfundidades) const;
-    int obterTamanhosDasSubarvoresRecursivamente(const No* noAtual, unordered_map<const No*, int>& mapaDeTamanhos) const;
-    int obterProfundidadeDoNoRecursivamente(const No* noAtual, const No* noProcurado, int profundidadeAtual) const;
-    int contarNosRecursivamente(const No* noAtual) const;
+
+    // Percorre os nós em pré-ordem com uma pilha explícita, chamando visitar(no, profundidade);
+    // visitar devolve true para interromper o percurso
+    template <class Visitante>
+    void percorrerEmPreOrdem(Visitante visitar) const;
 
 public:
     /**
      * @brief Constrói um objeto Arvore, tomando posse do nó raiz fornecido.
      * @param ponteiroParaNoRaiz O ponteiro inteligente para o nó que será a raiz da árvore.
      */
-    explicit Arvore(unique_ptr<No> ponteiroParaNoRaiz);
+    explicit Arvore(PonteiroNo ponteiroParaNoRaiz);
 
     /**
      * @brief Fornece acesso de apenas leitura ao nó raiz da árvore.
@@ -132,8 +195,9 @@ public:
 // Funções utilitárias
 void imprimirArvoreRecursivamente(ostream& streamDeSaida, const No* noAtual, const string& prefixoDeIndentacao, bool ehUltimoFilho);
 ostream& operator<<(ostream& streamDeSaida, const Arvore& arvoreParaImprimir);
-unique_ptr<No> criarNo(const string& rotulo);
-unique_ptr<No> criarArvoreAleatoria(int numNos, int seed);
-unique_ptr<No> criarArvoreCompleta(int numNos);
+// Com uma arena, os nós são criados nela; sem arena, no heap
+PonteiroNo criarNo(const string& rotulo, ArenaDeNos* arena = nullptr);
+PonteiroNo criarArvoreAleatoria(int numNos, int seed, ArenaDeNos* arena = nullptr);
+PonteiroNo criarArvoreCompleta(int numNos, ArenaDeNos* arena = nullptr);
 
 #endif // ARVORE_H
\ No newline at end of file
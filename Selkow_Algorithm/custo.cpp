@@ -9,6 +9,7 @@
 #include <functional>
 #include <cstdlib>
 #include <ctime>
+#include <mutex>
 #include "arvore.h"
 #include "custo.h"
 
@@ -21,42 +22,48 @@ CalculadorDeCustos::CalculadorDeCustos(double custoIns, double custoDel, double
     : custoInsercaoBasico(custoIns), custoDelecaoBasico(custoDel), custoRotulacaoBasico(custoRot) {
 }
 
-// Método privado para cálculo recursivo de inserção
-double CalculadorDeCustos::calcularCustoInsercaoRecursivo(const No* no) const {
-    if (no == nullptr) return 0.0;
-    
-    auto it = cacheInsercao.find(no);
-    if (it != cacheInsercao.end()) {
-        return it->second;
-    }
-    
-    double custoTotal = custoInsercaoUnico(no);
-    
-    for (const auto& filho : no->filhos) {
-        custoTotal += calcularCustoInsercaoRecursivo(filho.get());
-    }
-    
-    cacheInsercao[no] = custoTotal;
-    return custoTotal;
+CalculadorDeCustos::CalculadorDeCustos(double custoIns, double custoDel, double custoRot, bool protegido)
+    : cachesProtegidos(protegido), custoInsercaoBasico(custoIns), custoDelecaoBasico(custoDel), custoRotulacaoBasico(custoRot) {
 }
 
-// Método privado para cálculo recursivo de deleção
-double CalculadorDeCustos::calcularCustoDelecaoRecursivo(const No* no) const {
+shared_ptr<const CalculadorDeCustos> CalculadorDeCustos::copiaEntreThreads() const {
+    return shared_ptr<const CalculadorDeCustos>(
+        new CalculadorDeCustos(custoInsercaoBasico, custoDelecaoBasico, custoRotulacaoBasico, true));
+}
+
+// Custo de uma subárvore inteira (soma dos custos unitários), em pós-ordem com uma pilha
+// explícita; toda subárvore calculada fica no cache
+double CalculadorDeCustos::calcularCustoSubarvore(const No* no, unordered_map<const No*, double>& cache,
+                                                  double (CalculadorDeCustos::*custoUnico)(const No*) const) const {
     if (no == nullptr) return 0.0;
-    
-    auto it = cacheDelecao.find(no);
-    if (it != cacheDelecao.end()) {
-        return it->second;
+    unique_lock<shared_mutex> trava(travaDoCache, defer_lock);
+    if (cachesProtegidos) {
+        trava.lock();
     }
-    
-    double custoTotal = custoDelecaoUnico(no);
-    
-    for (const auto& filho : no->filhos) {
-        custoTotal += calcularCustoDelecaoRecursivo(filho.get());
+
+    // (nó, filhos já empilhados): o nó é somado quando volta ao topo depois dos filhos
+    vector<pair<const No*, bool>> pilha = {make_pair(no, false)};
+    while (!pilha.empty()) {
+        pair<const No*, bool> atual = pilha.back();
+        if (cache.count(atual.first)) {
+            pilha.pop_back();
+            continue;
+        }
+        if (!atual.second) {
+            pilha.back().second = true;
+            for (const auto& filho : atual.first->filhos) {
+                pilha.push_back(make_pair(filho.get(), false));
+            }
+            continue;
+        }
+        double custoTotal = (this->*custoUnico)(atual.first);
+        for (const auto& filho : atual.first->filhos) {
+            custoTotal += cache[filho.get()];
+        }
+        cache[atual.first] = custoTotal;
+        pilha.pop_back();
     }
-    
-    cacheDelecao[no] = custoTotal;
-    return custoTotal;
+    return cache[no];
 }
 
 // Implementação dos métodos públicos
@@ -113,9 +120,15 @@ double CalculadorDeCustos::custoRotulacao(const string& rotuloOrigem, const stri
     
     // Verificar cache
     auto chave = make_pair(rotuloOrigem, rotuloDestino);
-    auto it = cacheRotulacao.find(chave);
-    if (it != cacheRotulacao.end()) {
-        return it->second;
+    {
+        shared_lock<shared_mutex> trava(travaDoCache, defer_lock);
+        if (cachesProtegidos) {
+            trava.lock();
+        }
+        auto it = cacheRotulacao.find(chave);
+        if (it != cacheRotulacao.end()) {
+            return it->second;
+        }
     }
     
     // Calcular distância de Levenshtein
@@ -124,8 +137,12 @@ double CalculadorDeCustos::custoRotulacao(const string& rotuloOrigem, const stri
     // Custo baseado na distância de Levenshtein multiplicado pelo custo básico
     double custo = custoRotulacaoBasico * distanciaLevenshtein;
     
-    // Armazenar no cache
-    cacheRotulacao[chave] = custo;
+    // Armazenar no cache (outra thread pode ter guardado o mesmo valor antes)
+    unique_lock<shared_mutex> trava(travaDoCache, defer_lock);
+    if (cachesProtegidos) {
+        trava.lock();
+    }
+    cacheRotulacao.emplace(move(chave), custo);
     return custo;
 }
 
@@ -166,14 +183,18 @@ double CalculadorDeCustos::calcularDistanciaLevenshtein(const string& s1, const
 }
 
 double CalculadorDeCustos::custoInsercaoSubarvore(const No* no) const {
-    return calcularCustoInsercaoRecursivo(no);
+    return calcularCustoSubarvore(no, cacheInsercao, &CalculadorDeCustos::custoInsercaoUnico);
 }
 
 double CalculadorDeCustos::custoDelecaoSubarvore(const No* no) const {
-    return calcularCustoDelecaoRecursivo(no);
+    return calcularCustoSubarvore(no, cacheDelecao, &CalculadorDeCustos::custoDelecaoUnico);
 }
 
 void CalculadorDeCustos::limparCache() {
+    unique_lock<shared_mutex> trava(travaDoCache, defer_lock);
+    if (cachesProtegidos) {
+        trava.lock();
+    }
     cacheInsercao.clear();
     cacheDelecao.clear();
     cacheRotulacao.clear();
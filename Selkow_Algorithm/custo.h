@@ -3,6 +3,8 @@
 
 #include "arvore.h"
 #include <string>
+#include <memory>
+#include <shared_mutex>
 
 struct PairHash {
     size_t operator()(const pair<string, string>& p) const {
@@ -24,7 +26,18 @@ public:
 
     void limparCache();
 
+    // Calculador com os mesmos custos básicos e caches vazios protegidos por uma trava, que
+    // pode ser consultado de várias threads. O TED paralelo usa esta cópia, e o calculador
+    // original não é tocado
+    std::shared_ptr<const CalculadorDeCustos> copiaEntreThreads() const;
+
 private:
+    CalculadorDeCustos(double custoIns, double custoDel, double custoRot, bool protegido);
+
+    // Só a cópia entre threads toma a trava; consultas que acertam o cache tomam a
+    // compartilhada. Sem ela, consultar o cache não custa nenhuma operação atômica
+    mutable std::shared_mutex travaDoCache;
+    const bool cachesProtegidos = false;
     mutable std::unordered_map<const No*, double> cacheInsercao;
     mutable std::unordered_map<const No*, double> cacheDelecao;
     mutable std::unordered_map<std::pair<std::string, std::string>, double, struct PairHash> cacheRotulacao;
@@ -33,8 +46,8 @@ private:
     double custoDelecaoBasico;
     double custoRotulacaoBasico;
 
-    double calcularCustoInsercaoRecursivo(const No* no) const;
-    double calcularCustoDelecaoRecursivo(const No* no) const;
+    double calcularCustoSubarvore(const No* no, std::unordered_map<const No*, double>& cache,
+                                  double (CalculadorDeCustos::*custoUnico)(const No*) const) const;
 };
 
 #endif // CUSTO_H
\ No newline at end of file
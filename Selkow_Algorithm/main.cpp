@@ -1,48 +1,117 @@
 #include "ted.h"
+#include "../Zhang_Shasha_Algorithm/Demaine_Tree_Editing.h"
+#include "../Zhang_Shasha_Algorithm/Memory_Usage.h"
 #include <chrono>
 #include <iomanip>
 #include <fstream>
 #include <cmath>
+#include <thread>
 
 using namespace std::chrono;
 
+// ========== MOTORES DE DISTÂNCIA DE EDIÇÃO ==========
+
+// Motores que os testes de performance podem executar sobre as mesmas árvores
+enum class MotorTED { Selkow, Demaine };
+
+const char* nomeDoMotor(MotorTED motor) {
+    return motor == MotorTED::Demaine ? "Demaine" : "Selkow";
+}
+
+/**
+ * @brief Converte uma Arvore nos vetores em pós-ordem usados pelos motores do Zhang_Shasha_Algorithm.
+ * Os rótulos são convertidos em inteiros (rótulos iguais recebem o mesmo inteiro); o dicionário
+ * deve ser o mesmo para as duas árvores comparadas.
+ */
+Prepared_Tree prepararArvore(const Arvore& arvore, unordered_map<string, int>& rotulosInternos) {
+    vector<const No*> nos = arvore.obterNosEmPosOrdem();
+    unordered_map<const No*, int> indices;
+    vector<int> rotulos(nos.size());
+    vector<int> pais(nos.size(), -1);
+    for (size_t i = 0; i < nos.size(); ++i) {
+        indices[nos[i]] = (int)i;
+        rotulos[i] = rotulosInternos.emplace(nos[i]->rotulo, (int)rotulosInternos.size()).first->second;
+    }
+    for (size_t i = 0; i < nos.size(); ++i) {
+        for (const auto& filho : nos[i]->filhos) {
+            pais[indices[filho.get()]] = (int)i;
+        }
+    }
+    return Prepared_Tree(rotulos, pais);
+}
+
 // ========== ESTRUTURA PARA RESULTADOS DE PERFORMANCE ==========
 
 struct ResultadoPerformance {
+    string motor;
     int tamanhoArvore1;
     int tamanhoArvore2;
     double tempoExecucaoMs;
     double custoTED;
-    double espacoUtilizadoBytes;
+    double picoHeapBytes;   // Maior volume de heap alocado pelo motor ao mesmo tempo (Memory_Usage)
+    double heapVivoBytes;   // Heap que o motor ainda mantinha ao devolver o custo
+    size_t alocacoes;       // Alocações de heap feitas pelo motor
+    long picoRssKb;         // Pico de RSS do processo durante o cálculo (árvores incluídas)
 };
 
+/**
+ * @brief Preenche os campos de memória do resultado com a medição de heap do motor e o pico
+ * de RSS do processo
+ */
+void registrarMemoria(ResultadoPerformance& resultado, const Heap_Sample& memoria) {
+    resultado.picoHeapBytes = (double)memoria.peak_bytes;
+    resultado.heapVivoBytes = (double)memoria.live_bytes;
+    resultado.alocacoes = memoria.allocations;
+    resultado.picoRssKb = peakRssKb();
+}
+
 // ========== FUNÇÕES DE ANÁLISE DE PERFORMANCE ==========
 
 /**
  * @brief Executa um teste de performance para um par de árvores
  */
-ResultadoPerformance executarTestePerformance(int tamanho1, int tamanho2, int seed1, int seed2) {
-    // Criar árvores aleatórias
-    Arvore arvore1(criarArvoreAleatoria(tamanho1, seed1));
-    Arvore arvore2(criarArvoreAleatoria(tamanho2, seed2));
+ResultadoPerformance executarTestePerformance(int tamanho1, int tamanho2, int seed1, int seed2,
+                                              MotorTED motor = MotorTED::Selkow) {
+    // Criar árvores aleatórias (a arena vem antes, para ser destruída depois delas)
+    ArenaDeNos arena;
+    Arvore arvore1(criarArvoreAleatoria(tamanho1, seed1, &arena));
+    Arvore arvore2(criarArvoreAleatoria(tamanho2, seed2, &arena));
     
     // Configurar calculador de custos
     CalculadorDeCustos calculador(1.0, 1.0, 1.0);
     
-    // Medir tempo de execução
+    double custo;
+    Heap_Sample memoria;
+    
+    // Medir tempo de execução; a medição de heap começa junto e é lida antes de o motor
+    // liberar suas estruturas
+    resetPeakRss();
     auto inicio = high_resolution_clock::now();
+    Heap_Scope medicao;
     
-    TED ted(arvore1, arvore2, calculador);
-    double custo = ted.obterCusto();
+    if (motor == MotorTED::Demaine) {
+        // Custos unitários; a conversão para pós-ordem entra na medição
+        Demaine_Tree_Editing demaine(nullptr, nullptr);
+        unordered_map<string, int> rotulosInternos;
+        Prepared_Tree preparada1 = prepararArvore(arvore1, rotulosInternos);
+        Prepared_Tree preparada2 = prepararArvore(arvore2, rotulosInternos);
+        custo = demaine.treeEditDistance(preparada1, preparada2);
+        memoria = medicao.sample();
+    } else {
+        TED ted(arvore1, arvore2, calculador);
+        custo = ted.obterCusto();
+        memoria = medicao.sample();
+    }
     
     auto fim = high_resolution_clock::now();
     auto duracao = duration_cast<microseconds>(fim - inicio);
-      ResultadoPerformance resultado;
+    ResultadoPerformance resultado;
+    resultado.motor = nomeDoMotor(motor);
     resultado.tamanhoArvore1 = tamanho1;
     resultado.tamanhoArvore2 = tamanho2;
     resultado.tempoExecucaoMs = duracao.count() / 1000.0; // Converter para millisegundos
     resultado.custoTED = custo;
-    resultado.espacoUtilizadoBytes = ted.obterEspacoUtilizado();
+    registrarMemoria(resultado, memoria);
     
     return resultado;
 }
@@ -52,27 +121,74 @@ ResultadoPerformance executarTestePerformance(int tamanho1, int tamanho2, int se
  */
 ResultadoPerformance executarTestePerformanceCompletas(int tamanho1, int tamanho2) {
     // Criar árvores completas
-    Arvore arvore1(criarArvoreCompleta(tamanho1));
-    Arvore arvore2(criarArvoreCompleta(tamanho2));
+    ArenaDeNos arena;
+    Arvore arvore1(criarArvoreCompleta(tamanho1, &arena));
+    Arvore arvore2(criarArvoreCompleta(tamanho2, &arena));
     
     // Configurar calculador de custos
     CalculadorDeCustos calculador(1.0, 1.0, 1.0);
     
     // Medir tempo de execução
+    resetPeakRss();
     auto inicio = high_resolution_clock::now();
+    Heap_Scope medicao;
     
     TED ted(arvore1, arvore2, calculador);
     double custo = ted.obterCusto();
+    Heap_Sample memoria = medicao.sample();
     
     auto fim = high_resolution_clock::now();
     auto duracao = duration_cast<microseconds>(fim - inicio);
     
     ResultadoPerformance resultado;
+    resultado.motor = nomeDoMotor(MotorTED::Selkow);
     resultado.tamanhoArvore1 = tamanho1;
     resultado.tamanhoArvore2 = tamanho2;
     resultado.tempoExecucaoMs = duracao.count() / 1000.0; // Converter para millisegundos
     resultado.custoTED = custo;
-    resultado.espacoUtilizadoBytes = ted.obterEspacoUtilizado();
+    registrarMemoria(resultado, memoria);
+    
+    return resultado;
+}
+
+/**
+ * @brief Árvore larga: uma raiz com `numFilhos` subárvores aleatórias de `nosPorFilho` nós
+ */
+PonteiroNo criarArvoreLarga(int numFilhos, int nosPorFilho, int seed, ArenaDeNos* arena) {
+    PonteiroNo raiz = criarNo("raiz", arena);
+    for (int k = 0; k < numFilhos; ++k) {
+        raiz->adicionarFilho(criarArvoreAleatoria(nosPorFilho, seed + k, arena));
+    }
+    return raiz;
+}
+
+/**
+ * @brief Executa Selkow sobre duas árvores com `threads` threads (1 é a execução sequencial)
+ */
+ResultadoPerformance executarTesteParalelo(const Arvore& arvore1, const Arvore& arvore2, int threads) {
+    // Um calculador novo por execução, para nenhuma encontrar o cache da outra já cheio
+    CalculadorDeCustos calculador(1.0, 1.0, 1.0);
+    ExecucaoParalela execucao;
+    execucao.threads = threads;
+    
+    resetPeakRss();
+    auto inicio = high_resolution_clock::now();
+    Heap_Scope medicao;
+    
+    TED ted(arvore1, arvore2, calculador, execucao);
+    double custo = ted.obterCusto();
+    Heap_Sample memoria = medicao.sample();
+    
+    auto fim = high_resolution_clock::now();
+    auto duracao = duration_cast<microseconds>(fim - inicio);
+    
+    ResultadoPerformance resultado;
+    resultado.motor = threads > 1 ? "Selkow " + to_string(threads) + " threads" : "Selkow";
+    resultado.tamanhoArvore1 = arvore1.contarNos();
+    resultado.tamanhoArvore2 = arvore2.contarNos();
+    resultado.tempoExecucaoMs = duracao.count() / 1000.0; // Converter para millisegundos
+    resultado.custoTED = custo;
+    registrarMemoria(resultado, memoria);
     
     return resultado;
 }
@@ -87,21 +203,55 @@ void salvarResultadosCSV(const vector<ResultadoPerformance>& resultados, const s
         cout << "Erro: Não foi possível criar o arquivo " << nomeArquivo << endl;
         return;
     }    // Cabeçalho CSV
-    arquivo << "Tamanho1,Tamanho2,TempoMs,CustoTED,EspacoBytes" << endl;
+    arquivo << "Motor,Tamanho1,Tamanho2,TempoMs,CustoTED,PicoHeapBytes,HeapVivoBytes,Alocacoes,PicoRssKB" << endl;
     
     // Dados
     for (const auto& resultado : resultados) {
-        arquivo << resultado.tamanhoArvore1 << ","
+        arquivo << resultado.motor << ","
+                << resultado.tamanhoArvore1 << ","
                 << resultado.tamanhoArvore2 << ","
                 << fixed << setprecision(4) << resultado.tempoExecucaoMs << ","
                 << resultado.custoTED << ","
-                << resultado.espacoUtilizadoBytes << endl;
+                << setprecision(0) << resultado.picoHeapBytes << ","
+                << resultado.heapVivoBytes << ","
+                << resultado.alocacoes << ","
+                << resultado.picoRssKb << endl;
     }
     
     arquivo.close();
     cout << "Resultados salvos em: " << nomeArquivo << endl;
 }
 
+/**
+ * @brief Mede a construção e a destruição de uma árvore aleatória com nós no heap e numa
+ * ArenaDeNos, e o pico de memória residente acima do uso antes da construção
+ */
+void executarTesteAlocacao(int tamanho, bool usarArena, ofstream& arquivo) {
+    resetPeakRss();
+    long memoriaInicialKb = currentRssKb();
+    unique_ptr<ArenaDeNos> arena(usarArena ? new ArenaDeNos() : nullptr);
+
+    auto inicio = high_resolution_clock::now();
+    unique_ptr<Arvore> arvore(new Arvore(criarArvoreAleatoria(tamanho, tamanho, arena.get())));
+    auto construida = high_resolution_clock::now();
+    long picoKb = peakRssKb() - memoriaInicialKb;
+
+    arvore.reset();
+    if (arena) {
+        arena->liberar();
+    }
+    auto fim = high_resolution_clock::now();
+
+    double construcaoMs = duration_cast<microseconds>(construida - inicio).count() / 1000.0;
+    double destruicaoMs = duration_cast<microseconds>(fim - construida).count() / 1000.0;
+    const char* alocador = usarArena ? "Arena" : "Heap";
+    cout << "  " << setw(5) << alocador << " " << setw(8) << tamanho << " nós: construção " << fixed
+         << setprecision(2) << construcaoMs << " ms, destruição " << destruicaoMs << " ms, pico de RSS +"
+         << picoKb << " KB" << endl;
+    arquivo << alocador << "," << tamanho << "," << fixed << setprecision(4) << construcaoMs << ","
+            << destruicaoMs << "," << picoKb << endl;
+}
+
 /**
  * @brief Função principal - Análise de Performance do Algoritmo de Selkow
  * 
@@ -145,19 +295,19 @@ int main() {
         cout << "  Tempo de execução: " << fixed << setprecision(2) 
              << resultado.tempoExecucaoMs << " ms" << endl;
         cout << "  Custo TED (operações mínimas): " << resultado.custoTED << endl;
-        cout << "  Espaço utilizado: " << setprecision(1) 
-             << (resultado.espacoUtilizadoBytes / 1024.0) << " KB" << endl;
+        cout << "  Pico de heap: " << setprecision(1) << (resultado.picoHeapBytes / 1024.0) << " KB em "
+             << resultado.alocacoes << " alocações, pico de RSS: " << resultado.picoRssKb << " KB" << endl;
         cout << endl;
     }    cout << string(70, '-') << endl;
       // Análise comparativa dos resultados
     cout << "RESUMO DOS RESULTADOS:" << endl;
     cout << endl;
-    cout << "Tamanho\tTempo(ms)\tEspaço(KB)\tCusto TED" << endl;
+    cout << "Tamanho\tTempo(ms)\tHeap(KB)\tCusto TED" << endl;
     cout << string(50, '-') << endl;
     for (const auto& resultado : resultados) {
         cout << resultado.tamanhoArvore1 << "\t"
              << fixed << setprecision(2) << resultado.tempoExecucaoMs << "\t\t"
-             << setprecision(1) << (resultado.espacoUtilizadoBytes / 1024.0) << "\t\t"
+             << setprecision(1) << (resultado.picoHeapBytes / 1024.0) << "\t\t"
              << resultado.custoTED << endl;
     }
     cout << endl;
@@ -195,8 +345,8 @@ int main() {
         cout << "  Tempo de execução: " << fixed << setprecision(2) 
              << resultado.tempoExecucaoMs << " ms" << endl;
         cout << "  Custo TED (operações mínimas): " << resultado.custoTED << endl;
-        cout << "  Espaço utilizado: " << setprecision(1) 
-             << (resultado.espacoUtilizadoBytes / 1024.0) << " KB" << endl;
+        cout << "  Pico de heap: " << setprecision(1) << (resultado.picoHeapBytes / 1024.0) << " KB em "
+             << resultado.alocacoes << " alocações, pico de RSS: " << resultado.picoRssKb << " KB" << endl;
         cout << endl;
     }
     
@@ -205,12 +355,12 @@ int main() {
     // Análise comparativa dos resultados para árvores completas
     cout << "RESUMO DOS RESULTADOS (ÁRVORES COMPLETAS):" << endl;
     cout << endl;
-    cout << "Tamanho\tTempo(ms)\tEspaço(KB)\tCusto TED" << endl;
+    cout << "Tamanho\tTempo(ms)\tHeap(KB)\tCusto TED" << endl;
     cout << string(50, '-') << endl;
     for (const auto& resultado : resultadosCompletas) {
         cout << resultado.tamanhoArvore1 << "\t"
              << fixed << setprecision(2) << resultado.tempoExecucaoMs << "\t\t"
-             << setprecision(1) << (resultado.espacoUtilizadoBytes / 1024.0) << "\t\t"
+             << setprecision(1) << (resultado.picoHeapBytes / 1024.0) << "\t\t"
              << resultado.custoTED << endl;
     }
     cout << endl;
@@ -218,6 +368,86 @@ int main() {
     // Salvar resultados das árvores completas em arquivo CSV separado
     salvarResultadosCSV(resultadosCompletas, "resultados_selkow_completas.csv");
     
+    cout << "========================================" << endl;
+    cout << "        COMPARAÇÃO DE MOTORES" << endl;
+    cout << "========================================" << endl;
+    cout << endl;
+    
+    vector<ResultadoPerformance> resultadosMotores;
+    vector<int> tamanhosMotores = {10, 100, 1000};
+    
+    cout << "Selkow e Demaine (O(n^3)) sobre as mesmas árvores aleatórias." << endl;
+    cout << string(70, '-') << endl;
+    
+    for (int tamanho : tamanhosMotores) {
+        cout << "Árvores de tamanho " << tamanho << " nós:" << endl;
+        for (MotorTED motor : {MotorTED::Selkow, MotorTED::Demaine}) {
+            ResultadoPerformance resultado = executarTestePerformance(tamanho, tamanho,
+                                                                     tamanho * 10,
+                                                                     tamanho * 20, motor);
+            resultadosMotores.push_back(resultado);
+            cout << "  " << setw(8) << left << resultado.motor << right
+                 << " tempo: " << fixed << setprecision(2) << resultado.tempoExecucaoMs << " ms"
+                 << ", custo TED: " << resultado.custoTED
+                 << ", pico de heap: " << setprecision(1) << (resultado.picoHeapBytes / 1024.0) << " KB" << endl;
+        }
+        cout << endl;
+    }
+    
+    salvarResultadosCSV(resultadosMotores, "resultados_motores.csv");
+    
+    cout << "========================================" << endl;
+    cout << "        SELKOW PARALELO" << endl;
+    cout << "========================================" << endl;
+    cout << endl;
+    
+    // Com um só núcleo, 2 threads ainda exercitam a execução paralela
+    int threads = max(2, (int)std::thread::hardware_concurrency());
+    cout << "Execução sequencial e com " << threads << " threads sobre árvores largas (raiz com 24" << endl;
+    cout << "subárvores aleatórias de 150 nós) e completas de tamanhos diferentes." << endl;
+    cout << string(70, '-') << endl;
+    
+    vector<ResultadoPerformance> resultadosParalelos;
+    {
+        ArenaDeNos arena;
+        Arvore larga1(criarArvoreLarga(24, 150, 1, &arena));
+        Arvore larga2(criarArvoreLarga(24, 150, 101, &arena));
+        Arvore completa1(criarArvoreCompleta(600, &arena));
+        Arvore completa2(criarArvoreCompleta(599, &arena));
+        const pair<const char*, pair<const Arvore*, const Arvore*>> testes[] = {
+            {"Largas", {&larga1, &larga2}},
+            {"Completas", {&completa1, &completa2}}
+        };
+        for (const auto& teste : testes) {
+            ResultadoPerformance sequencial = executarTesteParalelo(*teste.second.first, *teste.second.second, 1);
+            ResultadoPerformance paralelo = executarTesteParalelo(*teste.second.first, *teste.second.second, threads);
+            resultadosParalelos.push_back(sequencial);
+            resultadosParalelos.push_back(paralelo);
+            cout << "  " << setw(10) << left << teste.first << right << fixed << setprecision(2)
+                 << "1 thread: " << sequencial.tempoExecucaoMs << " ms, " << threads << " threads: "
+                 << paralelo.tempoExecucaoMs << " ms (" << sequencial.tempoExecucaoMs / paralelo.tempoExecucaoMs
+                 << "x), custo TED " << paralelo.custoTED
+                 << (paralelo.custoTED == sequencial.custoTED ? " (igual)" : " (DIFERENTE)") << endl;
+        }
+    }
+    cout << endl;
+    
+    salvarResultadosCSV(resultadosParalelos, "resultados_paralelo.csv");
+    
+    cout << "========================================" << endl;
+    cout << "        ALOCAÇÃO DE NÓS: HEAP E ARENA" << endl;
+    cout << "========================================" << endl;
+    cout << endl;
+    
+    ofstream arquivoAlocacao("resultados_alocacao.csv");
+    arquivoAlocacao << "Alocador,Nos,ConstrucaoMs,DestruicaoMs,PicoRssKB" << endl;
+    for (int tamanho : {10000, 100000, 1000000}) {
+        executarTesteAlocacao(tamanho, false, arquivoAlocacao);
+        executarTesteAlocacao(tamanho, true, arquivoAlocacao);
+    }
+    cout << "Resultados salvos em: resultados_alocacao.csv" << endl;
+    cout << endl;
+    
     cout << "========================================" << endl;
     cout << "        TESTES COMPLETOS" << endl;
     cout << "========================================" << endl;
@@ -230,7 +460,9 @@ int main() {
     cout << "3. O espaço utilizado representa a memória das matrizes" << endl;
     cout << "   criadas durante a execução do algoritmo." << endl;
     cout << "4. O custo TED representa o número mínimo de operações" << endl;
-    cout << "   (inserção, deleção, substituição) necessárias." << endl;    cout << "5. Os resultados foram salvos em dois arquivos CSV separados." << endl;
+    cout << "   (inserção, deleção, substituição) necessárias." << endl;    cout << "5. Os resultados foram salvos em cinco arquivos CSV separados." << endl;
+    cout << "6. O motor de Demaine usa custos unitários (renomeação 0 ou 1)," << endl;
+    cout << "   por isso seu custo TED pode diferir do de Selkow." << endl;
     cout << endl;
     
     return 0;
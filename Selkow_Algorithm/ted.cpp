@@ -2,96 +2,568 @@
 #include <algorithm>
 #include <iostream>
 #include <iomanip>
+#include <limits>
+#include <cstdlib>
+#include <atomic>
+#include <memory>
+#include "../Zhang_Shasha_Algorithm/Memory_Usage.h"
+#include "../Zhang_Shasha_Algorithm/Perf_Counters.h"
+#include "../Zhang_Shasha_Algorithm/Thread_Pool.h"
 
 // Implementação PURA do algoritmo de Selkow para Tree Edit Distance
 
-TED::TED(const Arvore& a1, const Arvore& a2, const CalculadorDeCustos& calc) 
-    : calculador(&calc), arvore1(&a1), arvore2(&a2), custoFinal(0.0), espacoTotalMatrizes(0.0) {
-    
+PoliticaDoCalculador::PoliticaDoCalculador(const CalculadorDeCustos& calc, const Arvore& a1, const Arvore& a2)
+    : calculador(&calc), nos1(a1.obterNosEmPosOrdem()), nos2(a2.obterNosEmPosOrdem()) {
+}
+
+PoliticaDoCalculador::PoliticaDoCalculador(shared_ptr<const CalculadorDeCustos> copiaDoCalculador, const Arvore& a1, const Arvore& a2)
+    : copia(move(copiaDoCalculador)), calculador(copia.get()), nos1(a1.obterNosEmPosOrdem()), nos2(a2.obterNosEmPosOrdem()) {
+}
+
+TED::TED(const Arvore& a1, const Arvore& a2, const CalculadorDeCustos& calc)
+    : TEDSelkow<PoliticaDoCalculador>(a1, a2, PoliticaDoCalculador(calc, a1, a2)) {
+}
+
+// Com mais de uma thread, a execução consulta uma cópia do calculador com caches travados;
+// o calculador de quem chamou fica como estava e pode seguir em uso em outras threads
+TED::TED(const Arvore& a1, const Arvore& a2, const CalculadorDeCustos& calc, const ExecucaoParalela& execucao)
+    : TEDSelkow<PoliticaDoCalculador>(a1, a2, execucao, execucao.threads > 1
+          ? PoliticaDoCalculador(calc.copiaEntreThreads(), a1, a2) : PoliticaDoCalculador(calc, a1, a2)) {
+}
+
+// Rótulo no tipo que a política recebe: o próprio texto ou seu id internado (comum às duas árvores)
+static void converterRotulo(const string& rotulo, string& destino, unordered_map<string, int>&) {
+    destino = rotulo;
+}
+
+static void converterRotulo(const string& rotulo, int& destino, unordered_map<string, int>& rotulosInternos) {
+    destino = rotulosInternos.emplace(rotulo, (int)rotulosInternos.size()).first->second;
+}
+
+template <class PoliticaDeCusto>
+TEDSelkow<PoliticaDeCusto>::TEDSelkow(const Arvore& a1, const Arvore& a2, const PoliticaDeCusto& politicaDeCusto)
+    : politica(politicaDeCusto), arvore1(&a1), arvore2(&a2), custoFinal(0), limite(numeric_limits<Custo>::max()),
+      menorCustoIndel(0), subproblemasIgnorados(0), picoDeHeap(0) {
+    Heap_Scope medicao;
+    prepararCustos();
+
     // Calcular a distância de edição entre as duas árvores
     const No* raiz1 = a1.obterNoRaiz();
     const No* raiz2 = a2.obterNoRaiz();
     
     custoFinal = selkowRecursivo(raiz1, raiz2);
-    
-    // Multiplicar pelo tamanho de um double para obter o espaço em bytes
-    espacoTotalMatrizes *= sizeof(double);
+    picoDeHeap = medicao.sample().peak_bytes;
 }
 
-double TED::selkowRecursivo(const No* a1, const No* a2) const {
-    double resultado;
-    
-    // Caso base 1: uma árvore é nula (vazia)
+template <class PoliticaDeCusto>
+TEDSelkow<PoliticaDeCusto>::TEDSelkow(const Arvore& a1, const Arvore& a2, Custo limiteDeCusto, const PoliticaDeCusto& politicaDeCusto)
+    : politica(politicaDeCusto), arvore1(&a1), arvore2(&a2), custoFinal(0), limite(limiteDeCusto),
+      menorCustoIndel(0), subproblemasIgnorados(0), picoDeHeap(0) {
+    Heap_Scope medicao;
+    prepararCustos();
+
+    const No* raiz1 = a1.obterNoRaiz();
+    const No* raiz2 = a2.obterNoRaiz();
+    if (limite < 0) {
+        custoFinal = limite + 1;
+    } else if (raiz1 == nullptr || raiz2 == nullptr) {
+        custoFinal = min(selkowRecursivo(raiz1, raiz2), (Custo)(limite + 1));
+    } else {
+        custoFinal = selkowLimitado(raiz1, raiz2);
+    }
+    picoDeHeap = medicao.sample().peak_bytes;
+}
+
+template <class PoliticaDeCusto>
+TEDSelkow<PoliticaDeCusto>::TEDSelkow(const Arvore& a1, const Arvore& a2, const ExecucaoParalela& execucao, const PoliticaDeCusto& politicaDeCusto)
+    : politica(politicaDeCusto), arvore1(&a1), arvore2(&a2), custoFinal(0), limite(numeric_limits<Custo>::max()),
+      menorCustoIndel(0), subproblemasIgnorados(0), picoDeHeap(0) {
+    Heap_Scope medicao;
+    prepararCustos();
+
+    const No* raiz1 = a1.obterNoRaiz();
+    const No* raiz2 = a2.obterNoRaiz();
+    if (raiz1 == nullptr || raiz2 == nullptr || execucao.threads <= 1) {
+        custoFinal = selkowRecursivo(raiz1, raiz2);
+    } else {
+        custoFinal = selkowParalelo(indices1.at(raiz1), indices2.at(raiz2), execucao);
+    }
+    picoDeHeap = medicao.sample().peak_bytes;
+}
+
+template <class PoliticaDeCusto>
+void TEDSelkow<PoliticaDeCusto>::prepararCustos() {
+    // Índices em pós-ordem, rótulos, tamanhos, hashes de Merkle e custo de remover/inserir
+    // cada subárvore inteira (os filhos vêm antes do pai na pós-ordem)
+    unordered_map<string, int> rotulosInternos;
+    vector<const No*> nos1 = indexarArvore(*arvore1, indices1, rotulos1, rotulosInternos);
+    vector<const No*> nos2 = indexarArvore(*arvore2, indices2, rotulos2, rotulosInternos);
+    bool primeiro = true;
+    custoDelecaoSubarvore1.resize(nos1.size());
+    tamanhos1.resize(nos1.size());
+    hashes1.resize(nos1.size());
+    for (size_t k = 0; k < nos1.size(); ++k) {
+        Custo custoNo = politica.remove((int)k);
+        Custo custoTotal = custoNo;
+        int tamanho = 1;
+        unsigned long long hash = combineSubtreeHash(0, std::hash<string>{}(nos1[k]->rotulo));
+        for (const auto& filho : nos1[k]->filhos) {
+            custoTotal += custoDelecaoSubarvore1[indices1[filho.get()]];
+            tamanho += tamanhos1[indices1[filho.get()]];
+            hash = combineSubtreeHash(hash, hashes1[indices1[filho.get()]]);
+        }
+        custoDelecaoSubarvore1[k] = custoTotal;
+        tamanhos1[k] = tamanho;
+        hashes1[k] = hash;
+        menorCustoIndel = primeiro ? custoNo : min(menorCustoIndel, custoNo);
+        primeiro = false;
+    }
+    custoInsercaoSubarvore2.resize(nos2.size());
+    tamanhos2.resize(nos2.size());
+    hashes2.resize(nos2.size());
+    for (size_t k = 0; k < nos2.size(); ++k) {
+        Custo custoNo = politica.insert((int)k);
+        Custo custoTotal = custoNo;
+        int tamanho = 1;
+        unsigned long long hash = combineSubtreeHash(0, std::hash<string>{}(nos2[k]->rotulo));
+        for (const auto& filho : nos2[k]->filhos) {
+            custoTotal += custoInsercaoSubarvore2[indices2[filho.get()]];
+            tamanho += tamanhos2[indices2[filho.get()]];
+            hash = combineSubtreeHash(hash, hashes2[indices2[filho.get()]]);
+        }
+        custoInsercaoSubarvore2[k] = custoTotal;
+        tamanhos2[k] = tamanho;
+        hashes2[k] = hash;
+        menorCustoIndel = primeiro ? custoNo : min(menorCustoIndel, custoNo);
+        primeiro = false;
+    }
+    indexarFilhos(nos1, indices1, primeiroFilho1, listaFilhos1);
+    indexarFilhos(nos2, indices2, primeiroFilho2, listaFilhos2);
+}
+
+// Listas de filhos por índice em pós-ordem, contíguas, para o laço principal não consultar
+// os nós nem os mapas de índices
+template <class PoliticaDeCusto>
+void TEDSelkow<PoliticaDeCusto>::indexarFilhos(const vector<const No*>& nos, const unordered_map<const No*, int>& indices,
+                                               vector<int>& primeiroFilho, vector<int>& listaFilhos) {
+    primeiroFilho.assign(nos.size() + 1, 0);
+    listaFilhos.clear();
+    listaFilhos.reserve(nos.empty() ? 0 : nos.size() - 1);
+    for (size_t k = 0; k < nos.size(); ++k) {
+        primeiroFilho[k] = (int)listaFilhos.size();
+        for (const auto& filho : nos[k]->filhos) {
+            listaFilhos.push_back(indices.at(filho.get()));
+        }
+    }
+    primeiroFilho[nos.size()] = (int)listaFilhos.size();
+}
+
+template <class PoliticaDeCusto>
+vector<const No*> TEDSelkow<PoliticaDeCusto>::indexarArvore(const Arvore& arvore, unordered_map<const No*, int>& indices, vector<Rotulo>& rotulos,
+                                                            unordered_map<string, int>& rotulosInternos) {
+    vector<const No*> nos = arvore.obterNosEmPosOrdem();
+    rotulos.resize(nos.size());
+    for (size_t k = 0; k < nos.size(); ++k) {
+        indices[nos[k]] = (int)k;
+        converterRotulo(nos[k]->rotulo, rotulos[k], rotulosInternos);
+    }
+    return nos;
+}
+
+// Subárvores idênticas: o hash descarta quase todos os pares de imediato e uma igualdade é
+// confirmada pelos rótulos e tamanhos em pós-ordem, que determinam a forma da subárvore
+template <class PoliticaDeCusto>
+bool TEDSelkow<PoliticaDeCusto>::subarvoresIguais(int indice1, int indice2) const {
+    if (hashes1[indice1] != hashes2[indice2] || tamanhos1[indice1] != tamanhos2[indice2]) {
+        return false;
+    }
+    const int inicio1 = indice1 - tamanhos1[indice1] + 1;
+    const int inicio2 = indice2 - tamanhos2[indice2] + 1;
+    for (int deslocamento = 0; deslocamento < tamanhos1[indice1]; ++deslocamento) {
+        if (!(rotulos1[inicio1 + deslocamento] == rotulos2[inicio2 + deslocamento]) ||
+            tamanhos1[inicio1 + deslocamento] != tamanhos2[inicio2 + deslocamento]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <class PoliticaDeCusto>
+typename TEDSelkow<PoliticaDeCusto>::Custo TEDSelkow<PoliticaDeCusto>::selkowRecursivo(const No* a1, const No* a2) const {
+    // Caso base: uma árvore é nula (vazia)
     if (a1 == nullptr && a2 == nullptr) {
-        resultado = 0.0;
+        return 0;
     }
-    else if (a1 == nullptr) {
+    if (a1 == nullptr) {
         // Inserir toda a subárvore a2
-        resultado = calculador->custoInsercaoSubarvore(a2);
+        return custoInsercao(a2);
     }
-    else if (a2 == nullptr) {
+    if (a2 == nullptr) {
         // Deletar toda a subárvore a1
-        resultado = calculador->custoDelecaoSubarvore(a1);    } else {    
-        // Algoritmo de Selkow:
-       vector<const No*> filhos1 = arvore1->obterFilhos(a1);
-       vector<const No*> filhos2 = arvore2->obterFilhos(a2);
-       int m = filhos1.size();
-       int n = filhos2.size();
-
-       // Contabilizar o espaço da matriz atual (linhas × colunas)
-       espacoTotalMatrizes += (m + 1) * (n + 1);
-
-       //Soma-se 1 às dimensões para incluir as raízes A1 e A2
-       vector<vector<double>> matrizCustos(m + 1, vector<double>(n + 1, 0.0));
-
-       //Inicializa a primeira posição da matriz com o custo de edição da raíz A para a raíz B
-       matrizCustos[0][0] = calculador->custoRotulacao(a1->rotulo, a2->rotulo);
-
-       // Inicializa a primeira coluna (deletando subárvores de A1)
-         for (int i = 1; i <= m; i++) {
-              matrizCustos[i][0] = matrizCustos[i-1][0] + calculador->custoDelecaoSubarvore(filhos1[i-1]);
-         }
-
-       // Inicializa a primeira linha (inserindo subárvores de A2)
-         for (int j = 1; j <= n; j++) {
-              matrizCustos[0][j] = matrizCustos[0][j-1] + calculador->custoInsercaoSubarvore(filhos2[j-1]);
-         }
-
-       // Preencheenchendo a matriz de custos
-       for(int i = 1; i < m + 1; i++) {
-           for(int j = 1; j < n + 1; j++) {
-               // Opção 1: Deletar subárvore de A1
-               double custoDelecao = matrizCustos[i][j - 1] + calculador->custoDelecaoSubarvore(filhos1[i - 1]);
-               
-               // Opção 2: Inserir subárvore de A2
-               double custoInsercao = matrizCustos[i - 1][j] + calculador->custoInsercaoSubarvore(filhos2[j - 1]);
-               
-               // Opção 3: Editar subárvore de A1 para A2 (CHAMADA RECURSIVA)
-               double custoEdicao = matrizCustos[i - 1][j - 1] + selkowRecursivo(filhos1[i - 1], filhos2[j - 1]);
-               
-               matrizCustos[i][j] = min(custoDelecao, custoInsercao, custoEdicao);
-           }
-       }
-       resultado = matrizCustos[m][n];
+        return custoDelecao(a1);
     }
-    
-    return resultado;
+    Perf_Profile* perfil = activePerfProfile();
+    if (perfil != nullptr) {
+        // Contadores de hardware só quando alguém está perfilando esta thread
+        unsigned long long celulas = (unsigned long long)tamanhos1[indices1.at(a1)] * tamanhos2[indices2.at(a2)];
+        Perf_Region regiao(perfil->bucket("selkowRecursivo"), celulas);
+        return selkowComPilha<false>(indices1.at(a1), indices2.at(a2), quadrosPorNivel, subproblemasIgnorados);
+    }
+    return selkowComPilha<false>(indices1.at(a1), indices2.at(a2), quadrosPorNivel, subproblemasIgnorados);
 }
 
-double TED::min(double a, double b, double c) const {
-    return std::min({a, b, c});
+// Mesma recorrência de selkowRecursivo com todos os valores limitados a limite + 1. Remover
+// ou inserir nós custa ao menos menorCustoIndel, então um par de subárvores custa ao menos
+// |tamanho(a1) - tamanho(a2)| * menorCustoIndel e a célula [i][j] ao menos a diferença entre
+// os tamanhos dos i primeiros filhos de a1 e dos j primeiros de a2 vezes esse custo. Pares e
+// células cujo limite inferior excede o limite valem limite + 1 sem serem calculados.
+template <class PoliticaDeCusto>
+typename TEDSelkow<PoliticaDeCusto>::Custo TEDSelkow<PoliticaDeCusto>::selkowLimitado(const No* a1, const No* a2) const {
+    return selkowComPilha<true>(indices1.at(a1), indices2.at(a2), quadrosPorNivel, subproblemasIgnorados);
 }
 
-double TED::obterCusto() const {
+// Par resolvido sem matriz: subárvores idênticas valem 0 (renomear um rótulo para ele mesmo
+// custa 0 em qualquer política) e, com limite, pares cuja diferença de tamanho já o excede
+// valem limite + 1
+template <class PoliticaDeCusto>
+template <bool Limitado>
+bool TEDSelkow<PoliticaDeCusto>::resolverSemMatriz(int indice1, int indice2, Custo& resultado, size_t& ignorados) const {
+    if (Limitado && excedeLimite(abs(tamanhos1[indice1] - tamanhos2[indice2]))) {
+        resultado = limite + 1;
+        return true;
+    }
+    if (subarvoresIguais(indice1, indice2)) {
+        ++ignorados;
+        resultado = 0;
+        return true;
+    }
+    return false;
+}
+
+// Prepara o quadro do par (indice1, indice2) no lugar, reaproveitando seus vetores: primeira
+// linha e coluna na recorrência completa, todas as células em limite + 1 e os tamanhos
+// acumulados dos filhos na limitada
+template <class PoliticaDeCusto>
+template <bool Limitado>
+void TEDSelkow<PoliticaDeCusto>::abrirQuadro(QuadroSelkow& quadro, int indice1, int indice2) const {
+    quadro.indice1 = indice1;
+    quadro.indice2 = indice2;
+    const int* filhos1 = listaFilhos1.data() + primeiroFilho1[indice1];
+    const int* filhos2 = listaFilhos2.data() + primeiroFilho2[indice2];
+    const int m = quadro.m = primeiroFilho1[indice1 + 1] - primeiroFilho1[indice1];
+    const int n = quadro.n = primeiroFilho2[indice2 + 1] - primeiroFilho2[indice2];
+
+    //Soma-se 1 às dimensões para incluir as raízes A1 e A2
+    const Custo rotulacao = politica.rename(rotulos1[indice1], rotulos2[indice2]);
+    if (Limitado) {
+        const Custo teto = limite + 1;
+        quadro.matriz.assign((size_t)(m + 1) * (n + 1), teto);
+        quadro.celula(0, 0) = min(teto, rotulacao);
+        quadro.prefixo1.assign(m + 1, 0);
+        quadro.prefixo2.assign(n + 1, 0);
+        for (int i = 1; i <= m; i++) {
+            quadro.prefixo1[i] = quadro.prefixo1[i - 1] + tamanhos1[filhos1[i - 1]];
+        }
+        for (int j = 1; j <= n; j++) {
+            quadro.prefixo2[j] = quadro.prefixo2[j - 1] + tamanhos2[filhos2[j - 1]];
+        }
+        quadro.i = 0;
+        quadro.j = 0;
+    } else {
+        quadro.matriz.resize((size_t)(m + 1) * (n + 1));
+
+        //Inicializa a primeira posição da matriz com o custo de edição da raíz A para a raíz B
+        quadro.celula(0, 0) = rotulacao;
+
+        // Inicializa a primeira coluna (deletando subárvores de A1)
+        for (int i = 1; i <= m; i++) {
+            quadro.celula(i, 0) = quadro.celula(i - 1, 0) + custoDelecaoSubarvore1[filhos1[i - 1]];
+        }
+
+        // Inicializa a primeira linha (inserindo subárvores de A2)
+        for (int j = 1; j <= n; j++) {
+            quadro.celula(0, j) = quadro.celula(0, j - 1) + custoInsercaoSubarvore2[filhos2[j - 1]];
+        }
+        // Sem filhos de um dos lados não há células a calcular
+        quadro.i = n == 0 ? m + 1 : 1;
+        quadro.j = 1;
+    }
+}
+
+// A recorrência de Selkow sem recursão. Selkow só casa nós de mesma profundidade, então o par
+// que uma célula espera está sempre um nível abaixo do par da célula: a pilha desce e sobe um
+// nível por vez, e o k-ésimo nível abaixo do par inicial usa o quadro quadros[k]. Uma célula
+// que precisa da distância de um par de filhos guarda o mínimo de deleção/inserção em
+// `parcial`, abre o quadro do par no nível seguinte e é concluída quando ele termina. As células são
+// preenchidas na mesma ordem da versão recursiva, então custos e contadores são os mesmos;
+// depois que os quadros crescem até o maior par de cada profundidade, o laço não aloca nada.
+template <class PoliticaDeCusto>
+template <bool Limitado>
+typename TEDSelkow<PoliticaDeCusto>::Custo TEDSelkow<PoliticaDeCusto>::selkowComPilha(int raiz1, int raiz2, vector<QuadroSelkow>& quadros,
+                                                                                       size_t& ignorados) const {
+    Custo resultado;
+    if (resolverSemMatriz<Limitado>(raiz1, raiz2, resultado, ignorados)) {
+        return resultado;
+    }
+    const Custo teto = limite + 1;
+
+    size_t nivel = 0;
+    if (quadros.empty()) {
+        quadros.emplace_back();
+    }
+    abrirQuadro<Limitado>(quadros[0], raiz1, raiz2);
+    bool retornou = false;  // `resultado` traz a distância do par de filhos do nível atual
+    while (true) {
+        QuadroSelkow& quadro = quadros[nivel];
+        const int m = quadro.m;
+        const int n = quadro.n;
+        const int* filhos1 = listaFilhos1.data() + primeiroFilho1[quadro.indice1];
+        const int* filhos2 = listaFilhos2.data() + primeiroFilho2[quadro.indice2];
+        auto avancar = [&]() {
+            if (++quadro.j > n) {
+                quadro.j = Limitado ? 0 : 1;
+                ++quadro.i;
+            }
+        };
+
+        if (retornou) {
+            // Opção 3: Editar subárvore de A1 para A2, com a distância do par já calculada
+            Custo custoDeEdicao = quadro.celula(quadro.i - 1, quadro.j - 1) + resultado;
+            quadro.celula(quadro.i, quadro.j) = min(quadro.parcial, custoDeEdicao);
+            avancar();
+            retornou = false;
+        }
+
+        bool desceu = false;
+        while (quadro.i <= m && !desceu) {
+            const int i = quadro.i;
+            const int j = quadro.j;
+            if (Limitado && ((i == 0 && j == 0) || excedeLimite(abs(quadro.prefixo1[i] - quadro.prefixo2[j])))) {
+                avancar();
+                continue;
+            }
+
+            // Opção 1: Deletar subárvore de A1; Opção 2: Inserir subárvore de A2
+            Custo parcial = Limitado ? teto : numeric_limits<Custo>::max();
+            if (i > 0) {
+                parcial = min(parcial, (Custo)(quadro.celula(i - 1, j) + custoDelecaoSubarvore1[filhos1[i - 1]]));
+            }
+            if (j > 0) {
+                parcial = min(parcial, (Custo)(quadro.celula(i, j - 1) + custoInsercaoSubarvore2[filhos2[j - 1]]));
+            }
+            if (i == 0 || j == 0 || (Limitado && quadro.celula(i - 1, j - 1) >= teto)) {
+                quadro.celula(i, j) = parcial;
+                avancar();
+                continue;
+            }
+
+            Custo distanciaDoPar;
+            if (resolverSemMatriz<Limitado>(filhos1[i - 1], filhos2[j - 1], distanciaDoPar, ignorados)) {
+                quadro.celula(i, j) = min(parcial, (Custo)(quadro.celula(i - 1, j - 1) + distanciaDoPar));
+                avancar();
+            } else {
+                quadro.parcial = parcial;
+                desceu = true;
+            }
+        }
+
+        if (desceu) {
+            // Referências a quadros deixam de valer se o vetor de níveis crescer
+            const int filho1 = filhos1[quadro.i - 1];
+            const int filho2 = filhos2[quadro.j - 1];
+            if (++nivel == quadros.size()) {
+                quadros.emplace_back();
+            }
+            abrirQuadro<Limitado>(quadros[nivel], filho1, filho2);
+            continue;
+        }
+
+        resultado = quadro.celula(m, n);
+        if (nivel == 0) {
+            return resultado;
+        }
+        --nivel;
+        retornou = true;
+    }
+}
+
+// Execução paralela (ver ExecucaoParalela). A expansão, nesta thread, parte das raízes e
+// divide os pares de filhos de cada par acima do corte em pares também acima do corte, que
+// são expandidos por sua vez, e blocos de pares pequenos. As tarefas da Thread_Pool são os
+// blocos: quem conclui o último bloco ou filho pendente de um par calcula a recorrência dele
+// e segue para o pai, como os pares de keyroots do Zhang-Shasha paralelo. Cada par de
+// subárvores passa uma única vez por resolverSemMatriz, então o número de subproblemas
+// ignorados é o mesmo da execução sequencial.
+template <class PoliticaDeCusto>
+typename TEDSelkow<PoliticaDeCusto>::Custo TEDSelkow<PoliticaDeCusto>::selkowParalelo(int raiz1, int raiz2, const ExecucaoParalela& execucao) {
+    const long long corte = max(1LL, execucao.corteDeCelulas);
+    auto acimaDoCorte = [&](int indice1, int indice2) {
+        return (long long)tamanhos1[indice1] * tamanhos2[indice2] > corte;
+    };
+    Custo resultado;
+    if (!acimaDoCorte(raiz1, raiz2)) {
+        return selkowComPilha<false>(raiz1, raiz2, quadrosPorNivel, subproblemasIgnorados);
+    }
+    if (resolverSemMatriz<false>(raiz1, raiz2, resultado, subproblemasIgnorados)) {
+        return resultado;
+    }
+
+    vector<ParParalelo> pares;
+    vector<BlocoParalelo> blocos;
+    pares.push_back({raiz1, raiz2, -1, 0, 0, {}});
+    for (size_t p = 0; p < pares.size(); ++p) {
+        // pares cresce dentro do laço, então o par é sempre relido pelo índice
+        const int* filhos1 = listaFilhos1.data() + primeiroFilho1[pares[p].indice1];
+        const int* filhos2 = listaFilhos2.data() + primeiroFilho2[pares[p].indice2];
+        const size_t m = primeiroFilho1[pares[p].indice1 + 1] - primeiroFilho1[pares[p].indice1];
+        const size_t n = primeiroFilho2[pares[p].indice2 + 1] - primeiroFilho2[pares[p].indice2];
+        pares[p].distancias.resize(m * n);
+
+        size_t inicioDoBloco = m * n;  // Nenhum bloco aberto
+        long long celulasDoBloco = 0;
+        for (size_t posicao = 0; posicao < m * n; ++posicao) {
+            const int filho1 = filhos1[posicao / n];
+            const int filho2 = filhos2[posicao % n];
+            if (acimaDoCorte(filho1, filho2)) {
+                Custo distancia;
+                if (resolverSemMatriz<false>(filho1, filho2, distancia, subproblemasIgnorados)) {
+                    pares[p].distancias[posicao] = distancia;
+                } else {
+                    pares[p].pendentes++;
+                    pares.push_back({filho1, filho2, (int)p, posicao, 0, {}});
+                }
+                continue;
+            }
+            if (inicioDoBloco == m * n) {
+                inicioDoBloco = posicao;
+            }
+            celulasDoBloco += (long long)tamanhos1[filho1] * tamanhos2[filho2];
+            if (celulasDoBloco >= corte) {
+                blocos.push_back({(int)p, inicioDoBloco, posicao + 1});
+                pares[p].pendentes++;
+                inicioDoBloco = m * n;
+                celulasDoBloco = 0;
+            }
+        }
+        if (inicioDoBloco < m * n) {
+            blocos.push_back({(int)p, inicioDoBloco, m * n});
+            pares[p].pendentes++;
+        }
+    }
+
+    // Tarefas: o bloco b é a tarefa b e a recorrência do par p, a tarefa blocos.size() + p
+    unique_ptr<atomic<int>[]> pendentes(new atomic<int>[pares.size()]);
+    vector<Thread_Pool::Task> prontas;
+    for (size_t b = 0; b < blocos.size(); ++b) {
+        prontas.push_back((Thread_Pool::Task)b);
+    }
+    for (size_t p = 0; p < pares.size(); ++p) {
+        pendentes[p].store(pares[p].pendentes, memory_order_relaxed);
+        if (pares[p].pendentes == 0) {
+            prontas.push_back((Thread_Pool::Task)(blocos.size() + p));
+        }
+    }
+
+    // Quadros da pilha, matriz da recorrência e subárvores idênticas de cada thread
+    struct EstadoDaThread {
+        vector<QuadroSelkow> quadros;
+        vector<Custo> matriz;
+        size_t ignorados = 0;
+    };
+    Thread_Pool pool(execucao.threads);
+    vector<EstadoDaThread> estados(pool.size());
+    Custo distanciaDasRaizes = 0;
+
+    // Recorrência do par p e, enquanto ele for o último pendente do pai, a do pai
+    auto concluirPar = [&](EstadoDaThread& estado, int p) {
+        while (true) {
+            Custo distancia = alinharFilhos(pares[p], estado.matriz);
+            const int pai = pares[p].pai;
+            if (pai < 0) {
+                distanciaDasRaizes = distancia;
+                return;
+            }
+            pares[pai].distancias[pares[p].posicao] = distancia;
+            if (pendentes[pai].fetch_sub(1, memory_order_acq_rel) != 1) {
+                return;
+            }
+            p = pai;
+        }
+    };
+    Thread_Pool::Handler executar = [&](int trabalhador, Thread_Pool::Task tarefa) {
+        EstadoDaThread& estado = estados[trabalhador];
+        if (tarefa >= (Thread_Pool::Task)blocos.size()) {
+            concluirPar(estado, (int)(tarefa - (Thread_Pool::Task)blocos.size()));
+            return;
+        }
+        const BlocoParalelo& bloco = blocos[tarefa];
+        ParParalelo& par = pares[bloco.par];
+        const int* filhos1 = listaFilhos1.data() + primeiroFilho1[par.indice1];
+        const int* filhos2 = listaFilhos2.data() + primeiroFilho2[par.indice2];
+        const size_t n = primeiroFilho2[par.indice2 + 1] - primeiroFilho2[par.indice2];
+        for (size_t posicao = bloco.inicio; posicao < bloco.fim; ++posicao) {
+            const int filho1 = filhos1[posicao / n];
+            const int filho2 = filhos2[posicao % n];
+            if (!acimaDoCorte(filho1, filho2)) {
+                par.distancias[posicao] = selkowComPilha<false>(filho1, filho2, estado.quadros, estado.ignorados);
+            }
+        }
+        if (pendentes[bloco.par].fetch_sub(1, memory_order_acq_rel) == 1) {
+            concluirPar(estado, bloco.par);
+        }
+    };
+    pool.run(prontas, executar);
+
+    for (const EstadoDaThread& estado : estados) {
+        subproblemasIgnorados += estado.ignorados;
+    }
+    return distanciaDasRaizes;
+}
+
+// Recorrência sem limite de um par cujas distâncias de pares de filhos já estão calculadas,
+// com as mesmas operações, na mesma ordem, das células de selkowComPilha<false>
+template <class PoliticaDeCusto>
+typename TEDSelkow<PoliticaDeCusto>::Custo TEDSelkow<PoliticaDeCusto>::alinharFilhos(const ParParalelo& par, vector<Custo>& matriz) const {
+    const int* filhos1 = listaFilhos1.data() + primeiroFilho1[par.indice1];
+    const int* filhos2 = listaFilhos2.data() + primeiroFilho2[par.indice2];
+    const size_t m = primeiroFilho1[par.indice1 + 1] - primeiroFilho1[par.indice1];
+    const size_t n = primeiroFilho2[par.indice2 + 1] - primeiroFilho2[par.indice2];
+    const size_t largura = n + 1;
+    matriz.resize((m + 1) * largura);
+
+    matriz[0] = politica.rename(rotulos1[par.indice1], rotulos2[par.indice2]);
+    for (size_t i = 1; i <= m; i++) {
+        matriz[i * largura] = matriz[(i - 1) * largura] + custoDelecaoSubarvore1[filhos1[i - 1]];
+    }
+    for (size_t j = 1; j <= n; j++) {
+        matriz[j] = matriz[j - 1] + custoInsercaoSubarvore2[filhos2[j - 1]];
+    }
+    for (size_t i = 1; i <= m; i++) {
+        const Custo delecao = custoDelecaoSubarvore1[filhos1[i - 1]];
+        for (size_t j = 1; j <= n; j++) {
+            Custo parcial = numeric_limits<Custo>::max();
+            parcial = min(parcial, (Custo)(matriz[(i - 1) * largura + j] + delecao));
+            parcial = min(parcial, (Custo)(matriz[i * largura + j - 1] + custoInsercaoSubarvore2[filhos2[j - 1]]));
+            Custo custoDeEdicao = matriz[(i - 1) * largura + j - 1] + par.distancias[(i - 1) * n + j - 1];
+            matriz[i * largura + j] = min(parcial, custoDeEdicao);
+        }
+    }
+    return matriz[m * largura + n];
+}
+
+template <class PoliticaDeCusto>
+typename TEDSelkow<PoliticaDeCusto>::Custo TEDSelkow<PoliticaDeCusto>::obterCusto() const {
     return custoFinal;
 }
 
-double TED::obterEspacoUtilizado() const {
-    return espacoTotalMatrizes;
+template <class PoliticaDeCusto>
+double TEDSelkow<PoliticaDeCusto>::obterEspacoUtilizado() const {
+    return (double)picoDeHeap;
 }
 
 
-void TED::imprimirDetalhesCalculo() const {
+template <class PoliticaDeCusto>
+void TEDSelkow<PoliticaDeCusto>::imprimirDetalhesCalculo() const {
     cout << "=== Detalhes do Cálculo TED (Selkow) ===" << endl;
     
     const No* raiz1 = arvore1->obterNoRaiz();
@@ -104,18 +576,18 @@ void TED::imprimirDetalhesCalculo() const {
     
     if (raiz1 == nullptr) {
         cout << "Árvore A1 vazia, inserindo árvore A2: custo = " 
-             << calculador->custoInsercaoSubarvore(raiz2) << endl;
+             << custoInsercao(raiz2) << endl;
         return;
     }
     
     if (raiz2 == nullptr) {
         cout << "Árvore A2 vazia, deletando árvore A1: custo = " 
-             << calculador->custoDelecaoSubarvore(raiz1) << endl;        return;
+             << custoDelecao(raiz1) << endl;        return;
     }
     
     cout << "Cenário em que ambas as raízes não são nulas:" << endl;
     cout << "Comparando raízes: '" << raiz1->rotulo << "' vs '" << raiz2->rotulo << "'" << endl;
-    double custoRenomeacao = calculador->custoRotulacao(raiz1->rotulo, raiz2->rotulo);
+    Custo custoRenomeacao = politica.rename(rotulos1[indices1.at(raiz1)], rotulos2[indices2.at(raiz2)]);
     cout << "Custo de rotulação da raiz: " << custoRenomeacao << endl;
     
     vector<const No*> filhos1 = arvore1->obterFilhos(raiz1);
@@ -137,12 +609,13 @@ void TED::imprimirDetalhesCalculo() const {
     // O algoritmo de Selkow executa uma chamada recursiva que constrói a matriz
     // matrizCustos[0][0] = custo de rotulação das raízes
     // matrizCustos[m][n] = resultado final da transformação
-    double custoFinalSelkow = selkowRecursivo(raiz1, raiz2);
+    Custo custoFinalSelkow = selkowRecursivo(raiz1, raiz2);
     cout << "Custo final do algoritmo de Selkow: " << custoFinalSelkow << endl;
     cout << "  (Matriz inicia com rotulação das raízes em [0][0], custo de inserção de A2 de [0][1] até [0][n] e custo de remoção de A1 de [1][0] até [m][0]. Resultado final encontra-se na posição [m][n])" << endl;
 }
 
-void TED::imprimirMatrizesCustos() const {
+template <class PoliticaDeCusto>
+void TEDSelkow<PoliticaDeCusto>::imprimirMatrizesCustos() const {
     cout << "=== ALGORITMO DE SELKOW (IMPLEMENTAÇÃO RECURSIVA) ===" << endl;
     
     cout << "O algoritmo de Selkow implementado funciona de forma recursiva:" << endl;
@@ -159,4 +632,13 @@ void TED::imprimirMatrizesCustos() const {
     cout << "==========================================" << endl;
     cout << "Custo final calculado: " << custoFinal << endl;
     cout << "==========================================" << endl;
-}
\ No newline at end of file
+}
+
+template class TEDSelkow<PoliticaDoCalculador>;
+template class TEDSelkow<Unit_Cost<short>>;
+template class TEDSelkow<Unit_Cost<int>>;
+template class TEDSelkow<Unit_Cost<double>>;
+template class TEDSelkow<Per_Node_Cost<int>>;
+template class TEDSelkow<Per_Node_Cost<double>>;
+template class TEDSelkow<Per_Node_Cost<double, Constant_Rename<double>, string>>;
+template class TEDSelkow<Per_Node_Cost<double, function<double(const string&, const string&)>, string>>;
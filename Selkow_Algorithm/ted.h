@@ -3,43 +3,200 @@
 
 #include "arvore.h"
 #include "custo.h"
+#include "../Zhang_Shasha_Algorithm/Cost_Model.h"
+#include "../Zhang_Shasha_Algorithm/Tree.h"
+#include <functional>
 #include <vector>
 #include <iostream>
-#include <map>
+#include <unordered_map>
 
 using namespace std;
 
-class TED {
+/**
+ * @brief Expõe um CalculadorDeCustos como política de custo (ver Cost_Model.h):
+ * custos em double e rótulos em string, com os mesmos valores que o calculador devolve.
+ */
+class PoliticaDoCalculador {
+public:
+    typedef double cost_type;
+    typedef string label_type;
+
+    PoliticaDoCalculador(const CalculadorDeCustos& calculador, const Arvore& a1, const Arvore& a2);
+    // Usa e mantém viva uma cópia do calculador (a da execução paralela)
+    PoliticaDoCalculador(shared_ptr<const CalculadorDeCustos> copia, const Arvore& a1, const Arvore& a2);
+
+    double remove(int no) const { return calculador->custoDelecaoUnico(nos1[no]); }
+    double insert(int no) const { return calculador->custoInsercaoUnico(nos2[no]); }
+    double rename(const string& rotulo1, const string& rotulo2) const { return calculador->custoRotulacao(rotulo1, rotulo2); }
+
 private:
-    // Cache para memoização - evita recálculos
-    mutable map<pair<const No*, const No*>, double> cache;
-    
+    shared_ptr<const CalculadorDeCustos> copia;  // Vazio quando o calculador é o de quem chamou
     const CalculadorDeCustos* calculador;
-    const Arvore* arvore1;
-    const Arvore* arvore2;
-    mutable double custoFinal;
-    
-    // Variável para armazenar o somatório das proporções das matrizes
-    mutable double espacoTotalMatrizes;
-    
-    // Estrutura para armazenar informações de debug
-    mutable vector<vector<double>> ultimaMatrizCalculada;
-    mutable vector<const No*> ultimaFlorestaA1;
-    mutable vector<const No*> ultimaFlorestaA2;
-    
-    // Métodos auxiliares para o algoritmo de Selkow
-    double selkowRecursivo(const No* a1, const No* a2) const;
-    double min(double a, double b, double c) const;
+    vector<const No*> nos1;  // Nós em pós-ordem, para os custos por índice
+    vector<const No*> nos2;
+};
+
+/**
+ * @brief Execução paralela do Selkow sem limite. Num par de subárvores, as distâncias dos
+ * pares de filhos são independentes entre si; só a recorrência sobre elas precisa da ordem.
+ * Pares com mais de `corteDeCelulas` (produto dos tamanhos das subárvores) têm essas
+ * distâncias calculadas em tarefas de uma Thread_Pool antes da recorrência. Pares menores
+ * são agrupados em blocos de ao menos `corteDeCelulas` células, calculados por uma só thread.
+ */
+struct ExecucaoParalela {
+    int threads = 1;
+    long long corteDeCelulas = 1 << 14;
+};
 
+/**
+ * @brief Algoritmo de Selkow parametrizado por uma política de custo (Cost_Model.h), a mesma
+ * aceita pelo Zhang-Shasha. Os custos de inserção/remoção de subárvores inteiras são somados
+ * uma vez por nó no construtor; com Unit_Cost<int> as células da matriz são só somas e mínimos
+ * de inteiros. Políticas com label_type int recebem os rótulos internados em inteiros.
+ */
+template <class PoliticaDeCusto>
+class TEDSelkow {
 public:
-    TED(const Arvore& a1, const Arvore& a2, const CalculadorDeCustos& calculador);
-    
-    double obterCusto() const;
+    typedef typename PoliticaDeCusto::cost_type Custo;
+    typedef typename PoliticaDeCusto::label_type Rotulo;
+
+    TEDSelkow(const Arvore& a1, const Arvore& a2, const PoliticaDeCusto& politica = PoliticaDeCusto());
+
+    /**
+     * @brief Distância limitada: o custo exato quando é no máximo `limite`, senão limite + 1.
+     * Pares de subárvores e células cuja diferença de tamanho já custa mais que o limite
+     * (cada inserção/remoção custa ao menos o menor custo da política) não são calculados.
+     */
+    TEDSelkow(const Arvore& a1, const Arvore& a2, Custo limite, const PoliticaDeCusto& politica = PoliticaDeCusto());
+
+    /**
+     * @brief Distância sem limite calculada em `execucao.threads` threads, com o mesmo
+     * resultado e os mesmos subproblemas ignorados do construtor sequencial. A política
+     * deve aceitar chamadas concorrentes de rename (TED já protege os caches do calculador).
+     */
+    TEDSelkow(const Arvore& a1, const Arvore& a2, const ExecucaoParalela& execucao, const PoliticaDeCusto& politica = PoliticaDeCusto());
+
+    Custo obterCusto() const;
+    bool dentroDoLimite() const { return custoFinal <= limite; }
+
+    /**
+     * @brief Pares de subárvores idênticas (mesmo hash de Merkle, confirmado nó a nó) que
+     * valeram 0 sem recursão nem matriz.
+     */
+    size_t obterSubproblemasIgnorados() const { return subproblemasIgnorados; }
+
+    /**
+     * @brief Maior volume de heap, em bytes, que o cálculo manteve alocado ao mesmo tempo
+     * (índices, custos e matrizes), medido pelo contador de alocações de Memory_Usage; 0 num
+     * build com TED_NO_HEAP_COUNTING.
+     */
     double obterEspacoUtilizado() const;
-    
+
     // Métodos para debug/análise
     void imprimirDetalhesCalculo() const;
     void imprimirMatrizesCustos() const;
+
+private:
+    PoliticaDeCusto politica;
+    const Arvore* arvore1;
+    const Arvore* arvore2;
+    Custo custoFinal;
+    Custo limite;            // Sem limite no construtor sem limite
+    Custo menorCustoIndel;   // Menor custo de remover/inserir um nó, para os limites inferiores
+
+    // Índice em pós-ordem de cada nó, rótulos e custos de subárvore por índice
+    unordered_map<const No*, int> indices1;
+    unordered_map<const No*, int> indices2;
+    vector<Rotulo> rotulos1;
+    vector<Rotulo> rotulos2;
+    vector<Custo> custoDelecaoSubarvore1;
+    vector<Custo> custoInsercaoSubarvore2;
+    vector<int> tamanhos1;   // Nós de cada subárvore, por índice
+    vector<int> tamanhos2;
+    vector<unsigned long long> hashes1;  // Hash de Merkle de cada subárvore (rótulo e filhos em ordem)
+    vector<unsigned long long> hashes2;
+    // Filhos por índice: os de k, em ordem, ficam em listaFilhos[primeiroFilho[k]] até
+    // listaFilhos[primeiroFilho[k + 1] - 1]
+    vector<int> primeiroFilho1;
+    vector<int> primeiroFilho2;
+    vector<int> listaFilhos1;
+    vector<int> listaFilhos2;
+    mutable size_t subproblemasIgnorados;
+
+    // Pico de heap do construtor, medido por um Heap_Scope
+    size_t picoDeHeap;
+
+    // Métodos auxiliares para o algoritmo de Selkow
+    vector<const No*> indexarArvore(const Arvore& arvore, unordered_map<const No*, int>& indices, vector<Rotulo>& rotulos,
+                                    unordered_map<string, int>& rotulosInternos);
+    void prepararCustos();
+    Custo selkowRecursivo(const No* a1, const No* a2) const;
+    Custo selkowLimitado(const No* a1, const No* a2) const;
+
+    // Estado de um par de subárvores na pilha explícita de selkowComPilha. O par do nível k
+    // da pilha tem nós de profundidade k nas duas árvores, então cada nível usa sempre o
+    // mesmo quadro e seus vetores só crescem até o maior par daquela profundidade
+    struct QuadroSelkow {
+        int indice1, indice2;   // Raízes do par, em pós-ordem
+        int m, n;               // Número de filhos de cada raiz
+        vector<Custo> matriz;   // (m + 1) x (n + 1), linha a linha
+        vector<int> prefixo1;   // Tamanhos acumulados dos filhos (só na versão limitada)
+        vector<int> prefixo2;
+        int i, j;               // Próxima célula a preencher
+        Custo parcial;          // Mínimo de deleção/inserção da célula que espera o par de filhos
+
+        Custo& celula(int linha, int coluna) { return matriz[(size_t)linha * (n + 1) + coluna]; }
+    };
+    mutable vector<QuadroSelkow> quadrosPorNivel;
+
+    // Os quadros e o contador de subárvores idênticas são os membros na execução sequencial e
+    // os de cada thread na paralela
+    template <bool Limitado> Custo selkowComPilha(int indice1, int indice2, vector<QuadroSelkow>& quadros, size_t& ignorados) const;
+    template <bool Limitado> bool resolverSemMatriz(int indice1, int indice2, Custo& resultado, size_t& ignorados) const;
+    template <bool Limitado> void abrirQuadro(QuadroSelkow& quadro, int indice1, int indice2) const;
+    void indexarFilhos(const vector<const No*>& nos, const unordered_map<const No*, int>& indices,
+                       vector<int>& primeiroFilho, vector<int>& listaFilhos);
+    bool subarvoresIguais(int indice1, int indice2) const;
+
+    // Execução paralela: pares acima do corte, com as distâncias dos pares de filhos, e blocos
+    // de pares pequenos de um mesmo pai
+    struct ParParalelo {
+        int indice1, indice2;
+        int pai;                  // Posição do par pai em pares; -1 na raiz
+        size_t posicao;           // Posição da distância deste par nas distâncias do pai
+        int pendentes;            // Filhos acima do corte e blocos ainda não calculados
+        vector<Custo> distancias; // m x n distâncias dos pares de filhos, linha a linha
+    };
+    struct BlocoParalelo {
+        int par;                  // Par dono dos filhos
+        size_t inicio, fim;       // Intervalo de posições em distancias (os pares acima do corte são pulados)
+    };
+    Custo selkowParalelo(int raiz1, int raiz2, const ExecucaoParalela& execucao);
+    Custo alinharFilhos(const ParParalelo& par, vector<Custo>& matriz) const;
+    bool excedeLimite(int diferencaDeTamanho) const {
+        return menorCustoIndel > 0 && (double)diferencaDeTamanho * menorCustoIndel > (double)limite;
+    }
+    Custo custoDelecao(const No* no) const { return custoDelecaoSubarvore1[indices1.at(no)]; }
+    Custo custoInsercao(const No* no) const { return custoInsercaoSubarvore2[indices2.at(no)]; }
+};
+
+/**
+ * @brief Selkow com os custos de um CalculadorDeCustos (interface original).
+ */
+class TED : public TEDSelkow<PoliticaDoCalculador> {
+public:
+    TED(const Arvore& a1, const Arvore& a2, const CalculadorDeCustos& calculador);
+    TED(const Arvore& a1, const Arvore& a2, const CalculadorDeCustos& calculador, const ExecucaoParalela& execucao);
 };
 
-#endif // TED_H
\ No newline at end of file
+// Políticas para as quais TEDSelkow é compilado (ted.cpp)
+extern template class TEDSelkow<PoliticaDoCalculador>;
+extern template class TEDSelkow<Unit_Cost<short>>;
+extern template class TEDSelkow<Unit_Cost<int>>;
+extern template class TEDSelkow<Unit_Cost<double>>;
+extern template class TEDSelkow<Per_Node_Cost<int>>;
+extern template class TEDSelkow<Per_Node_Cost<double>>;
+extern template class TEDSelkow<Per_Node_Cost<double, Constant_Rename<double>, string>>;
+extern template class TEDSelkow<Per_Node_Cost<double, function<double(const string&, const string&)>, string>>;
+
+#endif // TED_H
@@ -0,0 +1,240 @@
+#include "Corpus_File.h"
+
+#include <cstring>
+
+using namespace std;
+
+static_assert(sizeof(int) == 4, "Corpus files store int32 arrays as int");
+static_assert(sizeof(Corpus_Header) == 64 && sizeof(Corpus_Entry) == 16, "Corpus structs must not be padded");
+
+static const char CORPUS_MAGIC[8] = {'T', 'E', 'D', 'C', 'O', 'R', 'P', 'S'};
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+static uint64_t alignedTo8(uint64_t bytes) {
+   return (bytes + 7) & ~(uint64_t)7;
+}
+
+// Bytes from a block's start to its hashes, and its total size
+static uint64_t hashesOffset(uint64_t nodes, uint64_t keyroots) {
+   return alignedTo8((4 * nodes + 2 * keyroots) * sizeof(int));
+}
+
+static uint64_t blockBytes(uint64_t nodes, uint64_t keyroots) {
+   return hashesOffset(nodes, keyroots) + nodes * sizeof(unsigned long long);
+}
+
+/**
+* @brief Records an error and leaves the file closed.
+* @param message What was wrong.
+* @return False, for returning straight from open().
+*/
+bool Corpus_File::fail(const string& message) {
+   last_error = message;
+   header = nullptr;
+   entries = nullptr;
+   label_offsets = nullptr;
+   file.close();
+   return false;
+}
+
+/**
+* @brief Maps a corpus file and checks its header and section bounds.
+* @param path File written by Corpus_Writer.
+* @return False if the file cannot be read as a corpus of this version.
+*/
+bool Corpus_File::open(const string& path) {
+   last_error.clear();
+   if (!file.open(path)) {
+       return fail("Could not open " + path);
+   }
+   const uint64_t size = file.size();
+   if (size < sizeof(Corpus_Header)) {
+       return fail(path + " is too small to be a tree corpus");
+   }
+   const Corpus_Header* h = reinterpret_cast<const Corpus_Header*>(file.data());
+   if (memcmp(h->magic, CORPUS_MAGIC, sizeof(CORPUS_MAGIC)) != 0) {
+       return fail(path + " is not a tree corpus");
+   }
+   if (h->byte_order != BYTE_ORDER_MARK) {
+       return fail(path + " was written on a machine with another byte order");
+   }
+   if (h->version != VERSION) {
+       return fail(path + " has format version " + to_string(h->version) + ", expected " + to_string(VERSION));
+   }
+   if (h->file_size != size) {
+       return fail(path + " is truncated");
+   }
+   // Sections in order and inside the file; each check keeps the next from overflowing
+   if (h->table_offset % 8 || h->table_offset < sizeof(Corpus_Header) || h->table_offset > h->label_offset
+       || h->tree_count > (h->label_offset - h->table_offset) / sizeof(Corpus_Entry)
+       || h->label_offset % 8 || h->label_offset > size
+       || h->label_count >= (size - h->label_offset) / sizeof(uint64_t)) {
+       return fail(path + " has a corrupt section table");
+   }
+
+   header = h;
+   entries = reinterpret_cast<const Corpus_Entry*>(file.data() + h->table_offset);
+   label_offsets = reinterpret_cast<const uint64_t*>(file.data() + h->label_offset);
+   return true;
+}
+
+/**
+* @brief View of one tree's arrays. A tree whose block lies outside the tree section (a
+* corrupt entry) comes back empty.
+* @param k Tree number, in the order the trees were added.
+*/
+Corpus_Tree Corpus_File::tree(int k) const {
+   Corpus_Tree view;
+   if (!header || k < 0 || k >= size()) {
+       return view;
+   }
+   const Corpus_Entry& entry = entries[k];
+   if (entry.offset % 8 || entry.offset < sizeof(Corpus_Header) || entry.offset > header->table_offset
+       || blockBytes(entry.nodes, entry.keyroots) > header->table_offset - entry.offset
+       || entry.keyroots > entry.nodes) {
+       return view;
+   }
+
+   const int n = (int)entry.nodes;
+   const int* arrays = reinterpret_cast<const int*>(file.data() + entry.offset);
+   view.nodes = n;
+   view.keyroot_count = (int)entry.keyroots;
+   view.labels = arrays;
+   view.lld = arrays + n;
+   view.parent = arrays + 2 * n;
+   view.subtree_size = arrays + 3 * n;
+   view.keyroots = arrays + 4 * n;
+   view.keyroot_parent = arrays + 4 * n + view.keyroot_count;
+   view.hashes = reinterpret_cast<const unsigned long long*>(file.data() + entry.offset + hashesOffset(entry.nodes, entry.keyroots));
+   return view;
+}
+
+/**
+* @brief Copies a tree into a Prepared_Tree for the engines; no tree pass is run.
+* @param k Tree number.
+* @param out Tree to fill.
+*/
+void Corpus_File::load(int k, Prepared_Tree& out) const {
+   tree(k).copyTo(out);
+}
+
+/**
+* @brief Copies the mapped arrays of a tree into a Prepared_Tree for the engines.
+* @param out Replaced; its vectors keep their capacity.
+*/
+void Corpus_Tree::copyTo(Prepared_Tree& out) const {
+   out.labels.assign(labels, labels + nodes);
+   out.lld.assign(lld, lld + nodes);
+   out.parent.assign(parent, parent + nodes);
+   out.hashes.assign(hashes, hashes + nodes);
+   out.keyroots.assign(keyroots, keyroots + keyroot_count);
+   out.keyroot_parent.assign(keyroot_parent, keyroot_parent + keyroot_count);
+}
+
+/**
+* @brief Name of a label id; empty for ids without a name.
+* @param id Label id.
+*/
+string_view Corpus_File::label(int id) const {
+   if (id < 0 || id >= labelCount()) {
+       return string_view();
+   }
+   const uint64_t begin = label_offsets[id];
+   const uint64_t end = label_offsets[id + 1];
+   if (begin > end || end > header->file_size) {
+       return string_view();
+   }
+   return string_view(file.data() + begin, end - begin);
+}
+
+// =================== Corpus_Writer ===================
+
+/**
+* @brief Creates the file, leaving room for the header.
+* @param path File to write; an existing file is replaced.
+*/
+bool Corpus_Writer::open(const string& path) {
+   out.open(path, ios::binary | ios::trunc);
+   entries.clear();
+   nodes = 0;
+   Corpus_Header placeholder = {};
+   out.write(reinterpret_cast<const char*>(&placeholder), sizeof(placeholder));
+   return (bool)out;
+}
+
+/**
+* @brief Pads the file to the next multiple of 8 bytes.
+*/
+void Corpus_Writer::align() {
+   static const char zeros[8] = {};
+   const uint64_t at = (uint64_t)out.tellp();
+   out.write(zeros, alignedTo8(at) - at);
+}
+
+/**
+* @brief Appends one tree's block.
+* @param tree Tree to store; its arrays are written as they are.
+*/
+void Corpus_Writer::add(const Prepared_Tree& tree) {
+   auto write = [&](const auto& values) {
+       out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(values[0]));
+   };
+   Corpus_Entry entry;
+   entry.offset = (uint64_t)out.tellp();
+   entry.nodes = (uint32_t)tree.size();
+   entry.keyroots = (uint32_t)tree.keyroots.size();
+
+   vector<int> subtree_size(tree.size());
+   for (int k = 0; k < tree.size(); ++k) {
+       subtree_size[k] = k - tree.lld[k] + 1;
+   }
+   write(tree.labels);
+   write(tree.lld);
+   write(tree.parent);
+   write(subtree_size);
+   write(tree.keyroots);
+   write(tree.keyroot_parent);
+   align();
+   write(tree.hashes);
+
+   entries.push_back(entry);
+   nodes += entry.nodes;
+}
+
+/**
+* @brief Writes the entry table and the label dictionary, then the header.
+* @param label_names Name of each label id (may be empty).
+* @return False if any write failed.
+*/
+bool Corpus_Writer::close(const vector<string_view>& label_names) {
+   Corpus_Header header = {};
+   memcpy(header.magic, CORPUS_MAGIC, sizeof(CORPUS_MAGIC));
+   header.version = Corpus_File::VERSION;
+   header.byte_order = BYTE_ORDER_MARK;
+   header.tree_count = entries.size();
+   header.node_count = nodes;
+
+   header.table_offset = (uint64_t)out.tellp();
+   out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(Corpus_Entry));
+
+   header.label_offset = (uint64_t)out.tellp();
+   header.label_count = label_names.size();
+   vector<uint64_t> offsets(label_names.size() + 1);
+   uint64_t at = header.label_offset + offsets.size() * sizeof(uint64_t);
+   for (size_t k = 0; k < label_names.size(); ++k) {
+       offsets[k] = at;
+       at += label_names[k].size();
+   }
+   offsets.back() = at;
+   out.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+   for (string_view name : label_names) {
+       out.write(name.data(), name.size());
+   }
+   align();
+
+   header.file_size = (uint64_t)out.tellp();
+   out.seekp(0);
+   out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+   out.close();
+   return !out.fail();
+}
@@ -0,0 +1,101 @@
+#ifndef CORPUS_FILE_H
+#define CORPUS_FILE_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Prepared_Tree.h"
+#include "Mapped_File.h"
+
+using namespace std;
+
+// Binary corpus of prepared trees, read through a memory map without any parsing. Layout
+// (native byte order, every section 8-byte aligned):
+//   Corpus_Header
+//   one block per tree: labels, lld, parent, subtree sizes (int32 x nodes), keyroots and
+//                       keyroot_parent (int32 x keyroots), hashes (uint64 x nodes)
+//   Corpus_Entry table (offset and counts of every block)
+//   label dictionary: uint64 x (labels + 1) name offsets, then the names back to back
+// Opening reads the header only, so it takes the same time for any corpus size; a tree's
+// pages are read when it is first used.
+struct Corpus_Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;    // 0x01020304 as written, to reject files from other byte orders
+    uint64_t tree_count;
+    uint64_t node_count;
+    uint64_t table_offset;
+    uint64_t label_count;
+    uint64_t label_offset;
+    uint64_t file_size;
+};
+
+struct Corpus_Entry {
+    uint64_t offset;
+    uint32_t nodes;
+    uint32_t keyroots;
+};
+
+// One tree of a Corpus_File: the Prepared_Tree arrays, pointing into the mapping
+struct Corpus_Tree {
+    int nodes = 0;
+    int keyroot_count = 0;
+    const int* labels = nullptr;
+    const int* lld = nullptr;
+    const int* parent = nullptr;
+    const int* subtree_size = nullptr;
+    const int* keyroots = nullptr;
+    const int* keyroot_parent = nullptr;
+    const unsigned long long* hashes = nullptr;
+
+    int size() const { return nodes; }
+    void copyTo(Prepared_Tree& out) const;  // Into out's arrays, reusing their capacity
+};
+
+class Corpus_File {
+public:
+    static const uint32_t VERSION = 1;
+
+    // Maps the file and checks its header; false with error() set if it is not a corpus
+    bool open(const string& path);
+    const string& error() const { return last_error; }
+
+    int size() const { return header ? (int)header->tree_count : 0; }
+    long long nodeCount() const { return header ? (long long)header->node_count : 0; }
+    Corpus_Tree tree(int k) const;
+    // Copies tree k into a Prepared_Tree, reusing its capacity
+    void load(int k, Prepared_Tree& out) const;
+
+    // Label names, when the labels stand for strings (e.g. from a Tree_Parser)
+    int labelCount() const { return header ? (int)header->label_count : 0; }
+    string_view label(int id) const;
+
+private:
+    Mapped_File file;
+    const Corpus_Header* header = nullptr;
+    const Corpus_Entry* entries = nullptr;
+    const uint64_t* label_offsets = nullptr;
+    string last_error;
+
+    bool fail(const string& message);
+};
+
+// Writes a corpus one tree at a time, so the corpus never has to be in memory at once
+class Corpus_Writer {
+public:
+    bool open(const string& path);
+    void add(const Prepared_Tree& tree);
+    // Writes the table and the label names (by label id) and completes the header
+    bool close(const vector<string_view>& label_names = {});
+
+private:
+    ofstream out;
+    vector<Corpus_Entry> entries;
+    uint64_t nodes = 0;
+
+    void align();
+};
+
+#endif // CORPUS_FILE_H
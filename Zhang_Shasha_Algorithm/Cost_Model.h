@@ -0,0 +1,89 @@
+#ifndef COST_MODEL_H
+#define COST_MODEL_H
+
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+// Cost policies taken as a template parameter by the edit distance engines
+// (Basic_Tree_Editing here, TEDSelkow in Selkow_Algorithm). A policy provides
+//   cost_type                  short, int, double, ...: the type every DP table is stored in
+//   label_type                 type of the labels passed to rename (the ZS engines intern
+//                              labels to int; Selkow also accepts string)
+//   remove(node), insert(node) cost of deleting a node of T1 / inserting a node of T2,
+//                              by post-order index
+//   rename(label1, label2)     cost of relabeling; must be 0 for equal labels
+// The calls are resolved at compile time, so they inline into the DP inner loops.
+// Distances must fit in cost_type: with short, keep them below 32768.
+
+// Every operation costs 1. rename is a comparison turned into 0/1, so unit-cost DP cells
+// are pure integer adds and mins with no branches
+template <typename Cost, typename Label = int>
+struct Unit_Cost {
+    typedef Cost cost_type;
+    typedef Label label_type;
+
+    Cost remove(int) const { return 1; }
+    Cost insert(int) const { return 1; }
+    Cost rename(const Label& label1, const Label& label2) const { return (Cost)(label1 != label2); }
+};
+
+// Rename functors for Per_Node_Cost. The functor is a template parameter of the policy,
+// so its call inlines into the DP cells instead of going through a function pointer.
+
+// Every rename of two different labels costs `cost`
+template <typename Cost>
+struct Constant_Rename {
+    Cost cost = 1;
+
+    template <typename Label>
+    Cost operator()(const Label&, const Label&) const { return cost; }
+};
+
+// Rename cost read from a label_count x label_count table, row = label of T1. The ZS
+// engines pass the node characters, so 256 labels cover every tree built from Node
+template <typename Cost>
+struct Rename_Table {
+    int label_count = 0;
+    vector<Cost> costs;
+
+    template <typename Function>
+    void assign(int count, Function function) {
+        label_count = count;
+        costs.resize((size_t)count * count);
+        for (int label1 = 0; label1 < count; ++label1) {
+            for (int label2 = 0; label2 < count; ++label2) {
+                costs[(size_t)label1 * count + label2] = function(label1, label2);
+            }
+        }
+    }
+    Cost operator()(int label1, int label2) const { return costs[(size_t)label1 * label_count + label2]; }
+};
+
+// Insert/delete cost of every node given by post-order index, and a rename functor.
+// Rename may also be a std::function for costs no table covers (e.g. over string labels),
+// at the price of one indirect call per rename
+template <typename Cost, typename Rename = Constant_Rename<Cost>, typename Label = int>
+struct Per_Node_Cost {
+    typedef Cost cost_type;
+    typedef Label label_type;
+
+    vector<Cost> remove_costs;  // One per node of T1
+    vector<Cost> insert_costs;  // One per node of T2
+    Rename rename_function;
+
+    Cost remove(int node) const { return remove_costs[node]; }
+    Cost insert(int node) const { return insert_costs[node]; }
+    Cost rename(const Label& label1, const Label& label2) const {
+        return label1 == label2 ? Cost(0) : rename_function(label1, label2);
+    }
+};
+
+// Kernels specialised for unit costs (the SIMD anti-diagonal sweeps) check this trait
+template <typename Policy>
+struct Is_Unit_Cost : false_type {};
+template <typename Cost, typename Label>
+struct Is_Unit_Cost<Unit_Cost<Cost, Label>> : true_type {};
+
+#endif // COST_MODEL_H
@@ -0,0 +1,42 @@
+#include "Demaine_Tree_Editing.h"
+
+Demaine_Tree_Editing::Demaine_Tree_Editing(Tree* tree1, Tree* tree2)
+    : Path_Tree_Editing(tree1, tree2) {
+}
+
+// Path kind that walks the same nodes as the heavy path of every subtree: Left when the
+// heavy child is always the first child down to the leaf, Right when it is always the
+// last one, Heavy otherwise. Children come before their parent in post-order.
+static vector<unsigned char> heavyPathKinds(const Path_Tree& tree) {
+    const int n = tree.size();
+    vector<unsigned char> kinds(n, (unsigned char)Path_Kind::Left);
+    vector<unsigned char> right(n, 1);
+    for (int v = 0; v < n; ++v) {
+        const int heavy = tree.heavy_child[v];
+        if (heavy < 0) continue;
+        const bool left = heavy == tree.first_child(v) && kinds[heavy] == (unsigned char)Path_Kind::Left;
+        right[v] = heavy == tree.last_child(v) && right[heavy];
+        kinds[v] = (unsigned char)(left ? Path_Kind::Left : right[v] ? Path_Kind::Right : Path_Kind::Heavy);
+    }
+    return kinds;
+}
+
+// Heavy path in T1 when its subtree is at least as large, otherwise in T2. Subtree
+// sizes come straight from the post-order and leftmost-leaf indices. Where the heavy
+// path is also the left or right path, the Zhang-Shasha single-path function is used:
+// it decomposes along the same nodes but only sweeps the keyroot subforests, while
+// spfHeavy sweeps the full (m+1) x (m+1) table of the other subtree at every level.
+void Demaine_Tree_Editing::computeStrategy() {
+    const int n1 = path1.size();
+    const int n2 = path2.size();
+    const vector<unsigned char> kinds1 = heavyPathKinds(path1);
+    const vector<unsigned char> kinds2 = heavyPathKinds(path2);
+    strategy.resize((size_t)n1 * n2);
+    for (int v = 0; v < n1; ++v) {
+        unsigned char* row = strategy.data() + (size_t)v * n2;
+        const int size_v = path1.subtree_size[v];
+        for (int w = 0; w < n2; ++w) {
+            row[w] = size_v >= path2.subtree_size[w] ? kinds1[v] : kinds2[w] | 4;
+        }
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef DEMAINE_TREE_EDITING_H
+#define DEMAINE_TREE_EDITING_H
+
+#include "Path_Tree_Editing.h"
+
+using namespace std;
+
+// Demaine, Mozes, Rossman and Weimann's algorithm: every subtree pair is decomposed
+// along the heavy path of the larger of the two subtrees. The strategy is fixed, so
+// nothing is computed up front, and the worst case is O(n^3) time with O(n^2) memory
+// whatever the tree shapes are. Heavy paths that are not also left or right paths are
+// swept over the full subforest table, so on random trees the run is cubic as well
+// and much slower than Zhang-Shasha; the engine is a worst-case bound, not a speedup.
+class Demaine_Tree_Editing : public Path_Tree_Editing {
+public:
+    Demaine_Tree_Editing(Tree* t1, Tree* t2);
+
+    void computeStrategy() override;
+};
+
+#endif // DEMAINE_TREE_EDITING_H
@@ -0,0 +1,133 @@
+#include "Distance_Matrix.h"
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+using namespace std;
+
+/**
+* @brief Creates an empty corpus.
+* @param num_threads Worker threads used by compute().
+*/
+Distance_Matrix::Distance_Matrix(int num_threads) : num_threads(max(1, num_threads)) {
+}
+
+/**
+* @brief Selects how many worker threads compute() uses.
+* @param threads Number of threads (values below 1 run on one thread).
+*/
+void Distance_Matrix::set_num_threads(int threads) {
+   num_threads = max(1, threads);
+}
+
+/**
+* @brief Flattens a tree and adds it to the corpus.
+* @param tree Tree whose post-order indices and keyroots are already computed.
+* @return Index of the tree in the corpus.
+*/
+int Distance_Matrix::add(Tree& tree) {
+   return add(Prepared_Tree(tree));
+}
+
+/**
+* @brief Adds an already flattened tree to the corpus and computes its weight.
+* @param tree Post-order arrays of the tree.
+* @return Index of the tree in the corpus.
+*/
+int Distance_Matrix::add(const Prepared_Tree& tree) {
+   unsigned long long weight = 0;
+   for (int keyroot : tree.keyroots) {
+       weight += keyroot - tree.lld[keyroot] + 1;
+   }
+   trees.push_back(tree);
+   weights.push_back(weight);
+   return (int)trees.size() - 1;
+}
+
+/**
+* @brief Computes the distance of every pair of corpus trees.
+*/
+void Distance_Matrix::compute() {
+   const int n = size();
+   upper.assign((size_t)n * (n > 0 ? n - 1 : 0) / 2, 0);
+   worker_pairs.assign(num_threads, 0);
+   heavy_pairs = 0;
+   if (n < 2) {
+       return;
+   }
+
+   // Pairs with their estimated forest cell counts, largest first
+   vector<pair<unsigned long long, pair<int, int>>> pairs;
+   pairs.reserve(upper.size());
+   unsigned long long total = 0;
+   for (int a = 0; a < n; ++a) {
+       for (int b = a + 1; b < n; ++b) {
+           unsigned long long cells = weights[a] * weights[b];
+           pairs.push_back(make_pair(cells, make_pair(a, b)));
+           total += cells;
+       }
+   }
+   sort(pairs.begin(), pairs.end(), [](const pair<unsigned long long, pair<int, int>>& x,
+                                       const pair<unsigned long long, pair<int, int>>& y) { return x.first > y.first; });
+
+   if (engines.size() != (size_t)num_threads) {
+       engines.clear();
+       for (int t = 0; t < num_threads; ++t) {
+           engines.push_back(make_unique<Tree_Editing>());
+       }
+   }
+
+   // Pairs that would leave the other workers idle get every thread to themselves
+   size_t first_shared = 0;
+   if (num_threads > 1) {
+       Tree_Editing& engine = *engines[0];
+       engine.set_num_threads(num_threads);
+       while (first_shared < pairs.size() && pairs[first_shared].first > total / num_threads) {
+           int a = pairs[first_shared].second.first;
+           int b = pairs[first_shared].second.second;
+           upper[pairIndex(a, b)] = engine.treeEditDistance(trees[a], trees[b]);
+           ++heavy_pairs;
+           ++first_shared;
+       }
+       engine.set_num_threads(1);
+   }
+
+   atomic<size_t> next(first_shared);
+   auto drain = [&](int worker) {
+       Tree_Editing& engine = *engines[worker];
+       for (size_t k = next.fetch_add(1, memory_order_relaxed); k < pairs.size(); k = next.fetch_add(1, memory_order_relaxed)) {
+           int a = pairs[k].second.first;
+           int b = pairs[k].second.second;
+           upper[pairIndex(a, b)] = engine.treeEditDistance(trees[a], trees[b]);
+           ++worker_pairs[worker];
+       }
+   };
+   if (num_threads == 1) {
+       drain(0);
+       return;
+   }
+
+   // One task per worker; each keeps taking the next largest pair until none are left
+   if (!pool || pool->size() != num_threads) {
+       pool.reset(new Thread_Pool(num_threads));
+   }
+   vector<Thread_Pool::Task> workers;
+   for (int t = 0; t < num_threads; ++t) {
+       workers.push_back(t);
+   }
+   Thread_Pool::Handler run_worker = [&](int, Thread_Pool::Task task) { drain((int)task); };
+   pool->run(workers, run_worker);
+}
+
+/**
+* @brief Distance between two corpus trees.
+* @param a Index of the first tree.
+* @param b Index of the second tree.
+*/
+int Distance_Matrix::distance(int a, int b) const {
+   if (a == b) {
+       return 0;
+   }
+   return a < b ? upper[pairIndex(a, b)] : upper[pairIndex(b, a)];
+}
@@ -0,0 +1,61 @@
+#ifndef DISTANCE_MATRIX_H
+#define DISTANCE_MATRIX_H
+
+#include <memory>
+#include <vector>
+#include "Tree.h"
+#include "Prepared_Tree.h"
+#include "Tree_Editing.h"
+#include "Thread_Pool.h"
+
+using namespace std;
+
+// Pairwise unit-cost TED of a tree corpus, for clustering. Every tree is flattened once
+// when added; compute() fills the upper triangle on a thread pool where each worker owns
+// a Tree_Editing engine, so tree_dist and the forest scratch are reused across its pairs.
+//
+// The cost of a pair is estimated up front as weight(T1) * weight(T2) forest cells,
+// weight(T) being the summed subtree sizes of T's keyroots. That is an upper bound on the
+// inner cells the keyroot pairs fill: it leaves out the border row and column of each
+// forest table, and pairs of identical subtrees skip their table altogether. It only
+// orders and splits the work. Pairs are handed out largest first from one shared counter,
+// so the big ones start early and the small ones fill the tail. A pair heavier than a
+// worker's fair share of the total is run before the others with all threads on its own
+// keyroot pairs.
+class Distance_Matrix {
+public:
+    explicit Distance_Matrix(int num_threads = 1);
+
+    // Adds a tree (after Tree::post_order and Tree::find_keyroots); returns its index
+    int add(Tree& tree);
+    int add(const Prepared_Tree& tree);
+    int size() const { return (int)trees.size(); }
+
+    // Fills every pair a < b
+    void compute();
+    void set_num_threads(int threads);
+
+    // Distance between trees a and b (0 for a == b); valid after compute()
+    int distance(int a, int b) const;
+    unsigned long long weight(int tree) const { return weights[tree]; }
+
+    // Pairs computed by each worker in the last compute(), and how many ran alone
+    // with all threads
+    vector<size_t> worker_pairs;
+    size_t heavy_pairs = 0;
+
+private:
+    int num_threads;
+    vector<Prepared_Tree> trees;
+    vector<unsigned long long> weights;
+    vector<int> upper;  // Pair (a, b), a < b, at a * (2n - a - 1) / 2 + (b - a - 1)
+
+    unique_ptr<Thread_Pool> pool;
+    vector<unique_ptr<Tree_Editing>> engines;  // One per worker
+
+    size_t pairIndex(int a, int b) const {
+        return (size_t)a * (2 * trees.size() - a - 1) / 2 + (b - a - 1);
+    }
+};
+
+#endif // DISTANCE_MATRIX_H
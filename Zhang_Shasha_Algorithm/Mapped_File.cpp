@@ -0,0 +1,82 @@
+#include "Mapped_File.h"
+
+#include <fstream>
+#include <iostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MAPPED_FILE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+/**
+* @brief Unmaps the file.
+*/
+Mapped_File::~Mapped_File() {
+   close();
+}
+
+/**
+* @brief Maps a file read-only, or reads it into memory where mmap is unavailable.
+* @param path File to open.
+* @return False if the file could not be opened.
+*/
+bool Mapped_File::open(const string& path) {
+   close();
+#ifdef MAPPED_FILE_MMAP
+   int fd = ::open(path.c_str(), O_RDONLY);
+   if (fd < 0) {
+       cerr << "Could not open " << path << endl;
+       return false;
+   }
+   struct stat info;
+   if (fstat(fd, &info) != 0) {
+       cerr << "Could not read the size of " << path << endl;
+       ::close(fd);
+       return false;
+   }
+   length = (size_t)info.st_size;
+   if (length > 0) {
+       void* map = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+       if (map != MAP_FAILED) {
+           // Parsers and loaders read front to back
+           madvise(map, length, MADV_SEQUENTIAL);
+           bytes = (const char*)map;
+           mapped = true;
+       }
+   }
+   ::close(fd);
+   if (mapped || length == 0) {
+       return true;
+   }
+#endif
+   ifstream in(path, ios::binary);
+   if (!in) {
+       cerr << "Could not open " << path << endl;
+       return false;
+   }
+   buffer.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+   bytes = buffer.data();
+   length = buffer.size();
+   return true;
+}
+
+/**
+* @brief Releases the mapping or buffer.
+*/
+void Mapped_File::close() {
+#ifdef MAPPED_FILE_MMAP
+   if (mapped) {
+       munmap((void*)bytes, length);
+   }
+#endif
+   bytes = nullptr;
+   length = 0;
+   mapped = false;
+   buffer.clear();
+   buffer.shrink_to_fit();
+}
@@ -0,0 +1,33 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Read-only view of a whole file. The file is memory-mapped where mmap is available, so
+// opening costs no reads and pages come in as they are touched; elsewhere it is read into
+// a buffer. The view stays valid until the object is destroyed or reopened.
+class Mapped_File {
+public:
+    Mapped_File() = default;
+    ~Mapped_File();
+    Mapped_File(const Mapped_File&) = delete;
+    Mapped_File& operator=(const Mapped_File&) = delete;
+
+    // Maps the file; returns false (with a message on cerr) when it cannot be opened
+    bool open(const string& path);
+    void close();
+
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+    bool mapped = false;
+    vector<char> buffer;  // Contents when the file could not be mapped
+};
+
+#endif // MAPPED_FILE_H
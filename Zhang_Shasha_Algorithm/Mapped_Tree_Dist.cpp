@@ -0,0 +1,191 @@
+#include "Mapped_Tree_Dist.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TREE_DIST_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+/**
+* @brief Creates the scratch file and maps a tiled (rows x cols) matrix from it.
+* @param directory Directory for the scratch file; it is unlinked right away and freed on close.
+* @param rows Number of matrix rows (|T1| + 1).
+* @param cols Number of matrix columns (|T2| + 1).
+* @param cell_bytes Size of one cell (the engine's cost type).
+* @param resident_budget Bytes of the matrix allowed to stay in memory (at least two blocks).
+* @return The mapped matrix, or nullptr if the file could not be created or mapped.
+*/
+unique_ptr<Mapped_Tree_Dist> Mapped_Tree_Dist::create(const string& directory, int rows, int cols, size_t cell_bytes, size_t resident_budget) {
+#ifdef TREE_DIST_MMAP
+   unique_ptr<Mapped_Tree_Dist> store(new Mapped_Tree_Dist());
+   const int tiles_per_band = (cols + TILE - 1) >> TILE_SHIFT;
+   store->num_rows = rows;
+   store->num_cols = cols;
+   store->cell_bytes = cell_bytes;
+   store->num_bands = (rows + TILE - 1) >> TILE_SHIFT;
+   store->blocks_per_band = (tiles_per_band + BLOCK_TILES - 1) / BLOCK_TILES;
+   store->band_cells = (size_t)tiles_per_band << (2 * TILE_SHIFT);
+   store->block_bytes = ((size_t)BLOCK_TILES << (2 * TILE_SHIFT)) * cell_bytes;
+   store->budget = max(resident_budget, 2 * store->block_bytes);
+   const size_t bytes = store->size() * cell_bytes;
+
+   string path = (directory.empty() ? string(".") : directory) + "/tree_dist.XXXXXX";
+   vector<char> name(path.begin(), path.end());
+   name.push_back('\0');
+   store->fd = mkstemp(name.data());
+   if (store->fd < 0) {
+       cerr << "Could not create tree_dist scratch file in " << directory << endl;
+       return nullptr;
+   }
+   unlink(name.data());
+
+   // A sparse file of zeros; pages are only backed once written
+   if (ftruncate(store->fd, (off_t)bytes) != 0) {
+       cerr << "Could not size tree_dist scratch file to " << bytes << " bytes" << endl;
+       return nullptr;
+   }
+   void* map = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, store->fd, 0);
+   if (map == MAP_FAILED) {
+       cerr << "Could not map tree_dist scratch file" << endl;
+       return nullptr;
+   }
+   store->cells = (char*)map;
+   // Keyroot pairs jump between tiles; readahead would only pull in unrelated pages
+   madvise(map, bytes, MADV_RANDOM);
+
+   const size_t blocks = (size_t)store->num_bands * store->blocks_per_band;
+   store->block_last_use.reset(new atomic<unsigned long long>[blocks]);
+   for (size_t b = 0; b < blocks; ++b) {
+       store->block_last_use[b].store(0, memory_order_relaxed);
+   }
+   return store;
+#else
+   (void)directory; (void)rows; (void)cols; (void)cell_bytes; (void)resident_budget;
+   cerr << "Memory-mapped tree_dist is not supported on this platform" << endl;
+   return nullptr;
+#endif
+}
+
+/**
+* @brief Unmaps the matrix and closes (and thereby deletes) the scratch file.
+*/
+Mapped_Tree_Dist::~Mapped_Tree_Dist() {
+#ifdef TREE_DIST_MMAP
+   if (cells) {
+       munmap(cells, size() * cell_bytes);
+   }
+   if (fd >= 0) {
+       close(fd);
+   }
+#endif
+}
+
+/**
+* @brief First byte of the given block in the mapping.
+* @param block Block index (band * blocks_per_band + block column).
+*/
+char* Mapped_Tree_Dist::blockStart(int block) const {
+   const size_t band = block / blocks_per_band;
+   const size_t column = block % blocks_per_band;
+   return cells + band * band_cells * cell_bytes + column * block_bytes;
+}
+
+/**
+* @brief Bytes of the given block; the last block of a band may be shorter.
+* @param block Block index (band * blocks_per_band + block column).
+*/
+size_t Mapped_Tree_Dist::blockLength(int block) const {
+   const size_t band_bytes = band_cells * cell_bytes;
+   const size_t offset = (size_t)(block % blocks_per_band) * block_bytes;
+   return min(block_bytes, band_bytes - offset);
+}
+
+/**
+* @brief Records that a rectangle of cells is in use and enforces the resident budget.
+* @param first_row First matrix row read or written.
+* @param last_row Last matrix row read or written.
+* @param first_col First matrix column read or written.
+* @param last_col Last matrix column read or written.
+*/
+void Mapped_Tree_Dist::touch(int first_row, int last_row, int first_col, int last_col) {
+   const int first_band = first_row >> TILE_SHIFT;
+   const int last_band = last_row >> TILE_SHIFT;
+   const int first_block = first_col >> BLOCK_SHIFT;
+   const int last_block = last_col >> BLOCK_SHIFT;
+   const unsigned long long now = clock.fetch_add(1, memory_order_relaxed) + 1;
+   size_t added = 0;
+   for (int band = first_band; band <= last_band; ++band) {
+       for (int column = first_block; column <= last_block; ++column) {
+           int block = band * blocks_per_band + column;
+           if (block_last_use[block].exchange(now, memory_order_relaxed) != 0) continue;
+           added += blockLength(block);
+#ifdef TREE_DIST_MMAP
+           // Readahead is off (MADV_RANDOM), so fetch the whole block in one request
+           // instead of faulting its pages in one at a time
+           madvise(blockStart(block), blockLength(block), MADV_WILLNEED);
+#endif
+       }
+   }
+   if (added > 0 && resident.fetch_add(added, memory_order_relaxed) + added > budget) {
+       evictToBudget(first_band, last_band, first_block, last_block);
+   }
+}
+
+/**
+* @brief Writes back and drops least recently used blocks until usage is 3/4 of the budget.
+* @param keep_first_band First band of the caller's current rectangle (never evicted here).
+* @param keep_last_band Last band of the caller's current rectangle.
+* @param keep_first_block First block column of the caller's current rectangle.
+* @param keep_last_block Last block column of the caller's current rectangle.
+*/
+void Mapped_Tree_Dist::evictToBudget(int keep_first_band, int keep_last_band, int keep_first_block, int keep_last_block) {
+#ifdef TREE_DIST_MMAP
+   // One evicting thread is enough; the others carry on with their pairs
+   unique_lock<mutex> guard(evict_lock, try_to_lock);
+   if (!guard.owns_lock() || resident.load(memory_order_relaxed) <= budget) {
+       return;
+   }
+
+   vector<pair<unsigned long long, int>> candidates;
+   const int blocks = num_bands * blocks_per_band;
+   for (int block = 0; block < blocks; ++block) {
+       unsigned long long last_use = block_last_use[block].load(memory_order_relaxed);
+       if (last_use == 0) continue;
+       int band = block / blocks_per_band;
+       int column = block % blocks_per_band;
+       if (band >= keep_first_band && band <= keep_last_band &&
+           column >= keep_first_block && column <= keep_last_block) continue;
+       candidates.push_back(make_pair(last_use, block));
+   }
+   sort(candidates.begin(), candidates.end());
+
+   const size_t target = budget - budget / 4;
+   for (const auto& candidate : candidates) {
+       if (resident.load(memory_order_relaxed) <= target) break;
+       // Skip blocks another thread touched since the scan
+       unsigned long long seen = candidate.first;
+       if (!block_last_use[candidate.second].compare_exchange_strong(seen, 0, memory_order_relaxed)) continue;
+
+       // Write the block back first so its page cache copy is clean and can be
+       // released as well, not just this mapping of it
+       char* start = blockStart(candidate.second);
+       size_t length = blockLength(candidate.second);
+       msync(start, length, MS_SYNC);
+       madvise(start, length, MADV_DONTNEED);
+#ifdef POSIX_FADV_DONTNEED
+       posix_fadvise(fd, (off_t)(start - cells), length, POSIX_FADV_DONTNEED);
+#endif
+       resident.fetch_sub(length, memory_order_relaxed);
+       evictions.fetch_add(1, memory_order_relaxed);
+   }
+#else
+   (void)keep_first_band; (void)keep_last_band; (void)keep_first_block; (void)keep_last_block;
+#endif
+}
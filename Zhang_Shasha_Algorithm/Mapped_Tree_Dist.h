@@ -0,0 +1,78 @@
+#ifndef MAPPED_TREE_DIST_H
+#define MAPPED_TREE_DIST_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+using namespace std;
+
+// Tree distance matrix stored in a memory-mapped scratch file instead of RAM, for
+// tree pairs whose (|T1|+1) x (|T2|+1) matrix does not fit in memory.
+//
+// Cells are laid out in TILE x TILE tiles (one 4 KB page for int cells), and each band
+// of TILE rows stores its tiles left to right, so the rectangle of cells a keyroot pair
+// reads is one short run of contiguous pages per band. Runs of BLOCK_TILES tiles form
+// the blocks the resident memory budget is accounted in: once the blocks in use exceed
+// it, the least recently used ones are written back and dropped from memory
+// (msync + madvise/fadvise DONTNEED).
+class Mapped_Tree_Dist {
+public:
+    static const int TILE_SHIFT = 5;
+    static const int TILE = 1 << TILE_SHIFT;
+    static const int BLOCK_SHIFT = 8;  // Columns per block, as a shift
+    static const int BLOCK_TILES = 1 << (BLOCK_SHIFT - TILE_SHIFT);
+
+    // Creates an unlinked scratch file in `directory` for cells of `cell_bytes` bytes;
+    // returns nullptr (with a message on cerr) when the file cannot be created or
+    // mapped, or mmap is unavailable
+    static unique_ptr<Mapped_Tree_Dist> create(const string& directory, int rows, int cols, size_t cell_bytes, size_t resident_budget);
+    ~Mapped_Tree_Dist();
+
+    void* data() const { return cells; }
+    int rows() const { return num_rows; }
+    int cols() const { return num_cols; }
+    size_t size() const { return (size_t)num_bands * band_cells; }
+
+    // Offset of cell (i, j) is rowOffset(i) + colOffset(j)
+    size_t rowOffset(int i) const { return (size_t)(i >> TILE_SHIFT) * band_cells + (size_t)(i & (TILE - 1)) * TILE; }
+    static size_t colOffset(int j) { return ((size_t)(j >> TILE_SHIFT) << (2 * TILE_SHIFT)) + (j & (TILE - 1)); }
+
+    // Marks the cells of rows first_row..last_row and columns first_col..last_col as in
+    // use, reads newly used blocks ahead and evicts older blocks beyond the budget;
+    // safe to call from several threads
+    void touch(int first_row, int last_row, int first_col, int last_col);
+
+    size_t resident_bytes() const { return resident.load(memory_order_relaxed); }
+    size_t resident_budget() const { return budget; }
+    size_t evicted_blocks() const { return evictions.load(memory_order_relaxed); }
+
+private:
+    Mapped_Tree_Dist() = default;
+
+    int fd = -1;
+    char* cells = nullptr;
+    size_t cell_bytes = 0;
+    int num_rows = 0;
+    int num_cols = 0;
+    int num_bands = 0;
+    int blocks_per_band = 0;
+    size_t band_cells = 0;
+    size_t block_bytes = 0;
+    size_t budget = 0;
+
+    unique_ptr<atomic<unsigned long long>[]> block_last_use;  // 0 while not resident
+    atomic<unsigned long long> clock{0};
+    atomic<size_t> resident{0};
+    atomic<size_t> evictions{0};
+    mutex evict_lock;
+
+    // Blocks are numbered band * blocks_per_band + block column; the last block of a
+    // band may hold fewer tiles than BLOCK_TILES
+    char* blockStart(int block) const;
+    size_t blockLength(int block) const;
+    void evictToBudget(int keep_first_band, int keep_last_band, int keep_first_block, int keep_last_block);
+};
+
+#endif // MAPPED_TREE_DIST_H
@@ -0,0 +1,215 @@
+#include "Memory_Usage.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+using namespace std;
+
+/**
+* @brief Reads a "Name:   1234 kB" field of /proc/self/status.
+* @param field Field name with its colon.
+* @return The value in KB, or -1 if the field is missing.
+*/
+static long statusFieldKb(const string& field) {
+   ifstream status("/proc/self/status");
+   string line;
+   while (getline(status, line)) {
+       if (line.compare(0, field.size(), field) == 0) {
+           return stol(line.substr(field.size()));
+       }
+   }
+   return -1;
+}
+
+/**
+* @brief Memory currently resident.
+*/
+long currentRssKb() {
+   long kb = statusFieldKb("VmRSS:");
+   return kb < 0 ? 0 : kb;
+}
+
+/**
+* @brief Highest resident memory since the start or the last resetPeakRss().
+*/
+long peakRssKb() {
+   long kb = statusFieldKb("VmHWM:");
+   if (kb >= 0) {
+       return kb;
+   }
+#if defined(__unix__) || defined(__APPLE__)
+   struct rusage usage;
+   if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+       return usage.ru_maxrss / 1024;  // Bytes on macOS
+#else
+       return usage.ru_maxrss;
+#endif
+   }
+#endif
+   return 0;
+}
+
+/**
+* @brief Resets the peak to the current RSS by writing 5 to /proc/self/clear_refs. Free heap
+* memory is handed back to the system first (glibc), so pages freed by an earlier run do not
+* hide the next run's growth.
+*/
+bool resetPeakRss() {
+#ifdef __GLIBC__
+   malloc_trim(0);
+#endif
+   ofstream clear_refs("/proc/self/clear_refs");
+   clear_refs << "5";
+   clear_refs.close();
+   return (bool)clear_refs;
+}
+
+static atomic<size_t> live_bytes(0);
+static atomic<size_t> peak_bytes(0);
+static atomic<size_t> allocation_count(0);
+
+/**
+* @brief Raises the recorded peak to `bytes` if it is higher.
+*/
+static void raisePeak(size_t bytes) {
+   size_t seen = peak_bytes.load(memory_order_relaxed);
+   while (bytes > seen && !peak_bytes.compare_exchange_weak(seen, bytes, memory_order_relaxed)) {
+   }
+}
+
+/**
+* @brief Heap bytes allocated and not yet freed, by requested size.
+*/
+size_t heapLiveBytes() {
+   return live_bytes.load(memory_order_relaxed);
+}
+
+/**
+* @brief operator new calls since the start of the program.
+*/
+size_t heapAllocations() {
+   return allocation_count.load(memory_order_relaxed);
+}
+
+/**
+* @brief Starts measuring: the peak restarts from the bytes live now.
+*/
+Heap_Scope::Heap_Scope() {
+   start_live = live_bytes.load(memory_order_relaxed);
+   start_allocations = allocation_count.load(memory_order_relaxed);
+   outer_peak = peak_bytes.exchange(start_live, memory_order_relaxed);
+}
+
+/**
+* @brief Folds the peak of this scope back into the enclosing one.
+*/
+Heap_Scope::~Heap_Scope() {
+   raisePeak(outer_peak);
+}
+
+/**
+* @brief Peak, live bytes and allocations since the scope started.
+*/
+Heap_Sample Heap_Scope::sample() const {
+   Heap_Sample sample;
+   const size_t peak = peak_bytes.load(memory_order_relaxed);
+   sample.peak_bytes = peak > start_live ? peak - start_live : 0;
+   sample.live_bytes = (long long)live_bytes.load(memory_order_relaxed) - (long long)start_live;
+   sample.allocations = allocation_count.load(memory_order_relaxed) - start_allocations;
+   return sample;
+}
+
+/**
+* @brief Whether this build counts allocations (see TED_NO_HEAP_COUNTING).
+*/
+bool heapCountingEnabled() {
+#ifdef TED_NO_HEAP_COUNTING
+   return false;
+#else
+   return true;
+#endif
+}
+
+#ifndef TED_NO_HEAP_COUNTING
+
+// Every block carries its requested size in a header, so delete knows how much to uncount;
+// the header keeps the fundamental alignment that malloc gives
+static const size_t HEADER_BYTES = alignof(max_align_t);
+
+/**
+* @brief Allocates and counts a block, calling the new-handler while memory runs out.
+* @param size Requested bytes.
+* @return The block, or nullptr if there is no new-handler left to try.
+*/
+static void* countedAllocate(size_t size) {
+   while (true) {
+       void* block = malloc(size + HEADER_BYTES);
+       if (block != nullptr) {
+           *(size_t*)block = size;
+           raisePeak(live_bytes.fetch_add(size, memory_order_relaxed) + size);
+           allocation_count.fetch_add(1, memory_order_relaxed);
+           return (char*)block + HEADER_BYTES;
+       }
+       new_handler handler = get_new_handler();
+       if (handler == nullptr) {
+           return nullptr;
+       }
+       handler();
+   }
+}
+
+/**
+* @brief Uncounts and frees a block from countedAllocate.
+*/
+static void countedFree(void* pointer) {
+   if (pointer == nullptr) {
+       return;
+   }
+   char* block = (char*)pointer - HEADER_BYTES;
+   live_bytes.fetch_sub(*(size_t*)block, memory_order_relaxed);
+   free(block);
+}
+
+void* operator new(size_t size) {
+   void* pointer = countedAllocate(size);
+   if (pointer == nullptr) {
+       throw bad_alloc();
+   }
+   return pointer;
+}
+
+void* operator new[](size_t size) {
+   return operator new(size);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept {
+   try {
+       return countedAllocate(size);
+   } catch (...) {
+       return nullptr;  // Thrown by a new-handler
+   }
+}
+
+void* operator new[](size_t size, const nothrow_t& tag) noexcept {
+   return operator new(size, tag);
+}
+
+void operator delete(void* pointer) noexcept { countedFree(pointer); }
+void operator delete[](void* pointer) noexcept { countedFree(pointer); }
+void operator delete(void* pointer, size_t) noexcept { countedFree(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { countedFree(pointer); }
+void operator delete(void* pointer, const nothrow_t&) noexcept { countedFree(pointer); }
+void operator delete[](void* pointer, const nothrow_t&) noexcept { countedFree(pointer); }
+
+#endif // TED_NO_HEAP_COUNTING
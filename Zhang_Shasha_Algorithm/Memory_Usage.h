@@ -0,0 +1,50 @@
+#ifndef MEMORY_USAGE_H
+#define MEMORY_USAGE_H
+
+#include <cstddef>
+
+// Resident set size of this process in KB, read from /proc/self/status on Linux; the peak
+// falls back to getrusage elsewhere, and 0 means unknown
+long currentRssKb();
+long peakRssKb();
+
+// Restarts peak tracking from the current RSS (Linux), so peakRssKb() covers only what
+// runs next; returns false where the peak can only grow
+bool resetPeakRss();
+
+// Heap accounting. Linking Memory_Usage.cpp replaces the global operator new and delete with
+// counting versions, so every heap allocation of the program (engine workspaces, STL
+// containers, arena blocks) is counted by its requested size; memory mapped from files is
+// not, and shows up only in the RSS. Counts are process-wide, so a measured region should
+// not overlap with work on other threads. Building with TED_NO_HEAP_COUNTING keeps the
+// standard operators and the counts stay 0.
+size_t heapLiveBytes();      // Bytes allocated and not yet freed
+size_t heapAllocations();    // operator new calls so far
+bool heapCountingEnabled();
+
+// What a measured region allocated
+struct Heap_Sample {
+    size_t peak_bytes = 0;     // Most bytes live at once, above the live bytes at the start
+    long long live_bytes = 0;  // Bytes allocated in the region and still live (negative if it freed older memory)
+    size_t allocations = 0;    // operator new calls in the region
+};
+
+// Measures the heap from its construction: sample() can be taken at any point, e.g. just
+// before an engine's workspace is destroyed. Scopes nest; an inner scope restarts the peak
+// and folds it back into the enclosing scope when destroyed.
+class Heap_Scope {
+public:
+    Heap_Scope();
+    ~Heap_Scope();
+    Heap_Scope(const Heap_Scope&) = delete;
+    Heap_Scope& operator=(const Heap_Scope&) = delete;
+
+    Heap_Sample sample() const;
+
+private:
+    size_t start_live;
+    size_t start_allocations;
+    size_t outer_peak;
+};
+
+#endif // MEMORY_USAGE_H
@@ -0,0 +1,286 @@
+#include "Metric_Index.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+
+using namespace std;
+
+/**
+* @brief Creates an empty index.
+* @param bucket_size Items a leaf holds before it is split (at least 1).
+*/
+Metric_Index::Metric_Index(int bucket_size) : bucket_size(max(1, bucket_size)) {
+}
+
+/**
+* @brief Unit-cost TED between a tree and an indexed item, counted in `calls`.
+* @param a Prepared tree.
+* @param id Item id.
+* @param calls Counter incremented once.
+*/
+int Metric_Index::distance(const Prepared_Tree& a, int id, size_t& calls) {
+   ++calls;
+   return engine.treeEditDistance(a, items[id]);
+}
+
+/**
+* @brief Flattens a tree and inserts it.
+* @param tree Tree whose post-order indices and keyroots are already computed.
+* @return Id of the new item.
+*/
+int Metric_Index::insert(Tree& tree) {
+   return insert(Prepared_Tree(tree));
+}
+
+/**
+* @brief Inserts an item, descending to its leaf and splitting the leaf if it overflows.
+* @param tree Post-order arrays of the tree.
+* @return Id of the new item.
+*/
+int Metric_Index::insert(const Prepared_Tree& tree) {
+   const int id = (int)items.size();
+   items.push_back(tree);
+   alive.push_back(true);
+   leaf_of.push_back(-1);
+   ++live_items;
+
+   if (root < 0) {
+       vector<pair<int, int>> entries = {make_pair(id, -1)};
+       root = (int)nodes.size();
+       nodes.push_back(VP_Node());
+       buildNode(root, entries);
+       return id;
+   }
+
+   int node = root;
+   int parent_distance = -1;
+   while (nodes[node].vantage >= 0) {
+       int d = distance(items[id], nodes[node].vantage, build_distance_calls);
+       VP_Node& inner = nodes[node];
+       if (d <= inner.radius) {
+           inner.inside_min = inner.inside_min > inner.inside_max ? d : min(inner.inside_min, d);
+           inner.inside_max = max(inner.inside_max, d);
+           node = inner.inside;
+       } else {
+           inner.outside_min = inner.outside_min > inner.outside_max ? d : min(inner.outside_min, d);
+           inner.outside_max = max(inner.outside_max, d);
+           node = inner.outside;
+       }
+       parent_distance = d;
+   }
+
+   nodes[node].bucket.push_back(make_pair(id, parent_distance));
+   leaf_of[id] = node;
+   if ((int)nodes[node].bucket.size() > bucket_size) {
+       // Turn the leaf into a subtree of its entries
+       vector<pair<int, int>> entries;
+       entries.swap(nodes[node].bucket);
+       buildNode(node, entries);
+   }
+   return id;
+}
+
+/**
+* @brief Builds a subtree over the given entries: a leaf if they fit in a bucket, otherwise
+* an inner node split at the median distance to a vantage item.
+* @param node Index in nodes the subtree root is stored at (its old contents are replaced).
+* @param entries (item id, distance to the parent vantage or -1); reordered and consumed.
+*/
+void Metric_Index::buildNode(int node, vector<pair<int, int>>& entries) {
+   if ((int)entries.size() <= bucket_size) {
+       for (const auto& entry : entries) {
+           leaf_of[entry.first] = node;
+       }
+       nodes[node] = VP_Node();
+       nodes[node].bucket = entries;
+       return;
+   }
+
+   // The item farthest from the parent vantage tends to spread the rest the most
+   size_t pick = 0;
+   for (size_t k = 1; k < entries.size(); ++k) {
+       if (entries[k].second > entries[pick].second) pick = k;
+   }
+   const int vantage = entries[pick].first;
+   entries.erase(entries.begin() + pick);
+   leaf_of[vantage] = -1;
+   for (auto& entry : entries) {
+       entry.second = distance(items[vantage], entry.first, build_distance_calls);
+   }
+
+   // Median split; inside gets distances <= radius
+   const size_t middle = (entries.size() - 1) / 2;
+   nth_element(entries.begin(), entries.begin() + middle, entries.end(),
+               [](const pair<int, int>& x, const pair<int, int>& y) { return x.second < y.second; });
+   const int radius = entries[middle].second;
+   vector<pair<int, int>> inside, outside;
+   for (const auto& entry : entries) {
+       (entry.second <= radius ? inside : outside).push_back(entry);
+   }
+
+   VP_Node split;
+   split.vantage = vantage;
+   split.radius = radius;
+   for (const auto& entry : inside) {
+       split.inside_min = split.inside_min > split.inside_max ? entry.second : min(split.inside_min, entry.second);
+       split.inside_max = max(split.inside_max, entry.second);
+   }
+   for (const auto& entry : outside) {
+       split.outside_min = split.outside_min > split.outside_max ? entry.second : min(split.outside_min, entry.second);
+       split.outside_max = max(split.outside_max, entry.second);
+   }
+   split.inside = (int)nodes.size();
+   nodes.push_back(VP_Node());
+   split.outside = (int)nodes.size();
+   nodes.push_back(VP_Node());
+   nodes[node] = split;
+   buildNode(split.inside, inside);
+   buildNode(split.outside, outside);
+}
+
+/**
+* @brief Removes an item from the results of later queries.
+* @param id Item id.
+* @return True if the item was live.
+*/
+bool Metric_Index::remove(int id) {
+   if (id < 0 || id >= (int)items.size() || !alive[id]) {
+       return false;
+   }
+   alive[id] = false;
+   --live_items;
+   if (leaf_of[id] >= 0) {
+       vector<pair<int, int>>& bucket = nodes[leaf_of[id]].bucket;
+       for (size_t k = 0; k < bucket.size(); ++k) {
+           if (bucket[k].first == id) {
+               bucket.erase(bucket.begin() + k);
+               break;
+           }
+       }
+       leaf_of[id] = -1;
+   }
+   // A removed vantage stays in place: it still bounds the distances of its sides
+   return true;
+}
+
+/**
+* @brief Rebuilds a balanced tree from the live items, dropping removed vantages.
+*/
+void Metric_Index::rebuild() {
+   nodes.clear();
+   root = -1;
+   vector<pair<int, int>> entries;
+   for (int id = 0; id < (int)items.size(); ++id) {
+       leaf_of[id] = -1;
+       if (alive[id]) {
+           entries.push_back(make_pair(id, -1));
+       }
+   }
+   if (!entries.empty()) {
+       root = 0;
+       nodes.push_back(VP_Node());
+       buildNode(root, entries);
+   }
+}
+
+/**
+* @brief Depth-first search that visits the side holding the query first and skips every
+* side whose distance range cannot come within the current radius.
+* @param node Subtree root.
+* @param query Query tree.
+* @param parent_distance Query distance to the parent vantage, -1 at the root.
+* @param k Number of neighbours wanted, or 0 for a fixed-radius query.
+* @param radius Search radius; shrinks to the k-th best distance once k items are found.
+* @param found Results; a max-heap on (distance, id) when k > 0.
+*/
+void Metric_Index::search(int node, const Prepared_Tree& query, int parent_distance, int k, int& radius, vector<Neighbour>& found) {
+   auto report = [&](int d, int id) {
+       Neighbour candidate = make_pair(d, id);
+       if (k == 0) {
+           if (d <= radius) found.push_back(candidate);
+           return;
+       }
+       if ((int)found.size() < k) {
+           found.push_back(candidate);
+           push_heap(found.begin(), found.end());
+       } else if (candidate < found.front()) {
+           pop_heap(found.begin(), found.end());
+           found.back() = candidate;
+           push_heap(found.begin(), found.end());
+       }
+       if ((int)found.size() == k) {
+           radius = found.front().first;
+       }
+   };
+
+   const VP_Node& current = nodes[node];
+   if (current.vantage < 0) {
+       for (const auto& entry : current.bucket) {
+           // |d(q, p) - d(x, p)| <= d(q, x) for the parent vantage p
+           if (parent_distance >= 0 && entry.second >= 0 && abs(parent_distance - entry.second) > radius) continue;
+           report(distance(query, entry.first, last_distance_calls), entry.first);
+       }
+       return;
+   }
+
+   const int d = distance(query, current.vantage, last_distance_calls);
+   if (alive[current.vantage]) {
+       report(d, current.vantage);
+   }
+   const int inside = current.inside, outside = current.outside;
+   const int inside_min = current.inside_min, inside_max = current.inside_max;
+   const int outside_min = current.outside_min, outside_max = current.outside_max;
+   auto visit_inside = [&]() {
+       if (inside_min <= inside_max && d + radius >= inside_min && d - radius <= inside_max) {
+           search(inside, query, d, k, radius, found);
+       }
+   };
+   auto visit_outside = [&]() {
+       if (outside_min <= outside_max && d + radius >= outside_min && d - radius <= outside_max) {
+           search(outside, query, d, k, radius, found);
+       }
+   };
+   if (d <= current.radius) {
+       visit_inside();
+       visit_outside();
+   } else {
+       visit_outside();
+       visit_inside();
+   }
+}
+
+/**
+* @brief Finds the k items closest to the query (ties broken by lower id).
+* @param query Query tree.
+* @param k Number of neighbours.
+* @return Up to k (distance, id) pairs in increasing order.
+*/
+vector<Metric_Index::Neighbour> Metric_Index::nearest(const Prepared_Tree& query, int k) {
+   last_distance_calls = 0;
+   vector<Neighbour> found;
+   if (root < 0 || k <= 0) {
+       return found;
+   }
+   int radius = INT_MAX / 2;
+   search(root, query, -1, k, radius, found);
+   sort(found.begin(), found.end());
+   return found;
+}
+
+/**
+* @brief Finds every item within the given distance of the query.
+* @param query Query tree.
+* @param radius Largest distance reported.
+* @return The (distance, id) pairs in increasing order.
+*/
+vector<Metric_Index::Neighbour> Metric_Index::range(const Prepared_Tree& query, int radius) {
+   last_distance_calls = 0;
+   vector<Neighbour> found;
+   if (root < 0 || radius < 0) {
+       return found;
+   }
+   search(root, query, -1, 0, radius, found);
+   sort(found.begin(), found.end());
+   return found;
+}
@@ -0,0 +1,72 @@
+#ifndef METRIC_INDEX_H
+#define METRIC_INDEX_H
+
+#include <utility>
+#include <vector>
+#include "Tree.h"
+#include "Prepared_Tree.h"
+#include "Tree_Editing.h"
+
+using namespace std;
+
+// Vantage-point tree over prepared trees for nearest-neighbour and range queries under
+// unit-cost TED, which is a metric. Each inner node keeps a vantage tree and splits the
+// others at the median distance to it. It also records the smallest and largest distance
+// on each side, so by the triangle inequality a side whose distances cannot come within
+// the query radius is never visited. Leaves hold a small bucket of trees with their
+// distance to the parent vantage, which prunes members without computing their TED.
+//
+// Inserts descend to a leaf and split it once it exceeds the bucket size. Deletes remove
+// the tree from its bucket; a deleted vantage keeps routing queries but is never
+// reported. rebuild() rebalances the tree from the live items.
+class Metric_Index {
+public:
+    // A result: (distance, item id)
+    typedef pair<int, int> Neighbour;
+
+    explicit Metric_Index(int bucket_size = 8);
+
+    // Adds a tree (after Tree::post_order and Tree::find_keyroots); returns its id
+    int insert(Tree& tree);
+    int insert(const Prepared_Tree& tree);
+    // Removes an item; returns false if it was already removed or never existed
+    bool remove(int id);
+    void rebuild();
+
+    // The k closest items, and all items within radius, sorted by distance then id
+    vector<Neighbour> nearest(const Prepared_Tree& query, int k);
+    vector<Neighbour> range(const Prepared_Tree& query, int radius);
+
+    int size() const { return live_items; }
+    const Prepared_Tree& item(int id) const { return items[id]; }
+
+    // Exact TED computations made by the last query, and by inserts and rebuilds so far
+    size_t last_distance_calls = 0;
+    size_t build_distance_calls = 0;
+
+private:
+    struct VP_Node {
+        int vantage = -1;              // Item id; -1 for a leaf
+        int radius = 0;                // Inside holds distances <= radius
+        int inside = -1;
+        int outside = -1;
+        int inside_min = 0, inside_max = -1;    // Distance range of each side (empty when min > max)
+        int outside_min = 0, outside_max = -1;
+        vector<pair<int, int>> bucket;  // Leaf: (item id, distance to the parent vantage or -1)
+    };
+
+    int bucket_size;
+    vector<Prepared_Tree> items;
+    vector<bool> alive;
+    vector<int> leaf_of;  // Leaf holding each item, -1 for vantages and removed items
+    int live_items = 0;
+    vector<VP_Node> nodes;
+    int root = -1;
+    Tree_Editing engine;
+
+    int distance(const Prepared_Tree& a, int id, size_t& calls);
+    void buildNode(int node, vector<pair<int, int>>& entries);
+    void search(int node, const Prepared_Tree& query, int parent_distance, int k, int& radius, vector<Neighbour>& found);
+};
+
+#endif // METRIC_INDEX_H
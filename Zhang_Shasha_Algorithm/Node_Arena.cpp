@@ -0,0 +1,30 @@
+#include "Node_Arena.h"
+
+#include <new>
+
+using namespace std;
+
+/**
+* @brief Creates an empty arena.
+* @param first_block_bytes Size of the first block; each further block is larger.
+*/
+Node_Arena::Node_Arena(size_t first_block_bytes) : memory(first_block_bytes) {}
+
+/**
+* @brief Creates a node whose child list also lives in the arena.
+* @param label The character label of the node.
+*/
+Node* Node_Arena::create(char label) {
+   void* place = memory.allocate(sizeof(Node), alignof(Node));
+   ++nodes;
+   return new (place) Node(label, -1, -1, &memory);
+}
+
+/**
+* @brief Frees all blocks. Node destructors are skipped: a node owns nothing but its child
+* list, which is in the arena too.
+*/
+void Node_Arena::clear() {
+   memory.release();
+   nodes = 0;
+}
@@ -0,0 +1,32 @@
+#ifndef NODE_ARENA_H
+#define NODE_ARENA_H
+
+#include <cstddef>
+#include <memory_resource>
+#include "Tree.h"
+
+using namespace std;
+
+// Bump allocator for Node trees. Nodes and their child lists are carved out of large
+// blocks in creation order, so building a tree makes one allocation per block instead of
+// two per node, and clear() or the destructor releases the whole tree at once without
+// visiting its nodes. Arena nodes must not be deleted, and their children must come from
+// the same arena.
+class Node_Arena {
+public:
+    explicit Node_Arena(size_t first_block_bytes = 1 << 16);
+    Node_Arena(const Node_Arena&) = delete;
+    Node_Arena& operator=(const Node_Arena&) = delete;
+
+    Node* create(char label);
+    // Releases every node created so far; Trees over them must not be used afterwards
+    void clear();
+
+    size_t size() const { return nodes; }
+
+private:
+    pmr::monotonic_buffer_resource memory;
+    size_t nodes = 0;
+};
+
+#endif // NODE_ARENA_H
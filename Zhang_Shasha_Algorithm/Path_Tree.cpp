@@ -0,0 +1,79 @@
+#include "Path_Tree.h"
+
+using namespace std;
+
+/**
+* @brief Derives the path decomposition arrays from the post-order arrays of a prepared tree.
+* @param tree Prepared tree (labels, leftmost leaves and parents by post-order index).
+*/
+Path_Tree::Path_Tree(const Prepared_Tree& tree)
+   : labels(tree.labels), lld(tree.lld), parent(tree.parent) {
+   const int n = tree.size();
+   subtree_size.resize(n);
+   for (int i = 0; i < n; ++i) {
+       subtree_size[i] = i - lld[i] + 1;
+   }
+
+   // Children in increasing post-order are already left to right
+   child_begin.assign(n + 1, 0);
+   for (int i = 0; i < n; ++i) {
+       if (parent[i] >= 0) child_begin[parent[i] + 1]++;
+   }
+   for (int i = 0; i < n; ++i) {
+       child_begin[i + 1] += child_begin[i];
+   }
+   children.resize(n > 0 ? n - 1 : 0);
+   vector<int> fill(child_begin.begin(), child_begin.end() - 1);
+   heavy_child.assign(n, -1);
+   for (int i = 0; i < n; ++i) {
+       int up = parent[i];
+       if (up < 0) continue;
+       children[fill[up]++] = i;
+       if (heavy_child[up] < 0 || subtree_size[i] > subtree_size[heavy_child[up]]) {
+           heavy_child[up] = i;
+       }
+   }
+
+   // Parents come after their children in post-order, so a descending sweep numbers
+   // every node before its children: each child starts where its left sibling ends
+   pre.assign(n, 0);
+   for (int i = n - 1; i >= 0; --i) {
+       int next = pre[i] + 1;
+       for (int k = child_begin[i]; k < child_begin[i + 1]; ++k) {
+           pre[children[k]] = next;
+           next += subtree_size[children[k]];
+       }
+   }
+   post_of_pre.resize(n);
+   for (int i = 0; i < n; ++i) {
+       post_of_pre[pre[i]] = i;
+   }
+
+   // The mirrored post-order is the original preorder reversed
+   mirror_labels.resize(n);
+   mirror_lld.resize(n);
+   mirror_orig.resize(n);
+   for (int m = 0; m < n; ++m) {
+       int node = post_of_pre[n - 1 - m];
+       mirror_orig[m] = node;
+       mirror_labels[m] = labels[node];
+       mirror_lld[m] = m - subtree_size[node] + 1;
+   }
+
+   // A subtree's keyroots are its root plus its nodes with a left (right) sibling
+   left_forests.assign(n, 0);
+   right_forests.assign(n, 0);
+   for (int i = 0; i < n; ++i) {
+       long long left = subtree_size[i], right = subtree_size[i];
+       for (int k = child_begin[i]; k < child_begin[i + 1]; ++k) {
+           left += left_forests[children[k]];
+           right += right_forests[children[k]];
+       }
+       if (!is_leaf(i)) {
+           left -= subtree_size[first_child(i)];
+           right -= subtree_size[last_child(i)];
+       }
+       left_forests[i] = left;
+       right_forests[i] = right;
+   }
+}
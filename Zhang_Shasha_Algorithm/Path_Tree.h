@@ -0,0 +1,46 @@
+#ifndef PATH_TREE_H
+#define PATH_TREE_H
+
+#include <vector>
+#include "Prepared_Tree.h"
+
+using namespace std;
+
+// Post-order arrays of a Prepared_Tree extended with what path decompositions need:
+// subtree sizes, preorder numbers, children and heavy children, plus the mirrored
+// (children reversed) post-order that right paths are computed on.
+class Path_Tree {
+public:
+    vector<int> labels;        // Label of each node, by post-order index
+    vector<int> lld;           // Leftmost leaf descendant of each node
+    vector<int> parent;        // Parent index of each node, -1 for the root
+    vector<int> subtree_size;  // Number of nodes in the subtree of each node
+    vector<int> pre;           // Preorder number of each node
+    vector<int> post_of_pre;   // Post-order index of the node with a given preorder number
+
+    // Children of node i are children[child_begin[i] .. child_begin[i+1]), left to right
+    vector<int> child_begin;
+    vector<int> children;
+    vector<int> heavy_child;   // Child with the largest subtree (leftmost on ties), -1 for leaves
+
+    // Mirrored view: mirrored post-order index of node i is size() - 1 - pre[i]
+    vector<int> mirror_labels;
+    vector<int> mirror_lld;
+    vector<int> mirror_orig;   // Post-order index of each mirrored index
+
+    // Relevant subforests of each subtree under left / right path decomposition
+    // (sum of its keyroot subtree sizes); read by the strategy cost model
+    vector<long long> left_forests;
+    vector<long long> right_forests;
+
+    Path_Tree() = default;
+    explicit Path_Tree(const Prepared_Tree& tree);
+
+    int size() const { return (int)labels.size(); }
+    int root() const { return (int)labels.size() - 1; }
+    bool is_leaf(int i) const { return child_begin[i] == child_begin[i+1]; }
+    int first_child(int i) const { return is_leaf(i) ? -1 : children[child_begin[i]]; }
+    int last_child(int i) const { return is_leaf(i) ? -1 : children[child_begin[i+1] - 1]; }
+};
+
+#endif // PATH_TREE_H
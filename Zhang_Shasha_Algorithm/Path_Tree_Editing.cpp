@@ -0,0 +1,425 @@
+#include "Path_Tree_Editing.h"
+#include <algorithm> // For min(), reverse() and fill()
+
+// Next node of a path of the given kind below `node`, -1 past the leaf
+static int pathChild(const Path_Tree& tree, int node, Path_Kind kind) {
+    switch (kind) {
+    case Path_Kind::Left:
+        return tree.first_child(node);
+    case Path_Kind::Right:
+        return tree.last_child(node);
+    default:
+        return tree.heavy_child[node];
+    }
+}
+
+Path_Tree_Editing::Path_Tree_Editing(Tree* tree1, Tree* tree2)
+    : t1(tree1), t2(tree2) {
+}
+
+// Primary tree edit distance calculation
+int Path_Tree_Editing::treeEditDistance(Tree T1, Tree T2) {
+    return treeEditDistance(Prepared_Tree(T1), Prepared_Tree(T2));
+}
+
+// Tree edit distance of trees already flattened to post-order arrays
+int Path_Tree_Editing::treeEditDistance(const Prepared_Tree& T1, const Prepared_Tree& T2) {
+    path1 = Path_Tree(T1);
+    path2 = Path_Tree(T2);
+
+    tree_dist.assign((size_t)path1.size() * path2.size(), 0);
+    tree_dist_cols = path2.size();
+    keyroot_mark.assign(max(path1.size(), path2.size()), 0);
+    mark_stamp = 0;
+
+    computeStrategy();
+    computeDistances();
+    return tree_dist_at(path1.root(), path2.root());
+}
+
+size_t Path_Tree_Editing::workspaceBytes() const {
+    size_t ints = tree_dist.capacity() + forest_dist.capacity() + table_cur.capacity() +
+                  table_next.capacity() + insert_table.capacity() + keyroot_mark.capacity() + keyroots.capacity();
+    return ints * sizeof(int) + strategy.capacity();
+}
+
+void Path_Tree_Editing::computeStrategy() {
+    computeOptimalStrategy();
+}
+
+// Picks, for every subtree pair (v, w), the path whose single-path function plus the
+// recursive cost of the subtrees hanging off it is cheapest. Costs count relevant
+// subproblems of the functions implemented here: a left/right path costs |F_v| times
+// the left/right relevant subforests of G_w, a heavy path |F_v| times all (|G_w|+1)^2
+// subforest cells (and symmetrically for paths in T2).
+//
+// The sums over hanging subtrees are accumulated into the parent: per T2 node within a
+// row, per T1 node across rows. T1 is walked heavy child first, so a parent row only
+// exists while one of its lighter children is open and O(log |T1|) rows are alive.
+void Path_Tree_Editing::computeOptimalStrategy() {
+    const int n1 = path1.size();
+    const int n2 = path2.size();
+    strategy.assign((size_t)n1 * n2, 0);
+
+    vector<int> order;
+    order.reserve(n1);
+    vector<int> stack(1, path1.root());
+    vector<int> next_child(n1, -1);
+    while (!stack.empty()) {
+        int v = stack.back();
+        int& k = next_child[v];
+        if (k < 0) {
+            k = path1.child_begin[v];
+            if (path1.heavy_child[v] >= 0) {
+                stack.push_back(path1.heavy_child[v]);
+                continue;
+            }
+        }
+        while (k < path1.child_begin[v+1] && path1.children[k] == path1.heavy_child[v]) ++k;
+        if (k < path1.child_begin[v+1]) {
+            stack.push_back(path1.children[k++]);
+            continue;
+        }
+        order.push_back(v);
+        stack.pop_back();
+    }
+
+    // Hanging subtree sums for paths in T1 (rows by T1 node) and in T2 (one row)
+    vector<vector<long long>> rows;
+    vector<int> free_rows;
+    vector<int> row_of(n1, -1);
+    const vector<long long> zero_row(3 * (size_t)n2, 0);
+    vector<long long> in_t2(3 * (size_t)n2, 0);
+
+    for (int v : order) {
+        const long long* sv = row_of[v] >= 0 ? rows[row_of[v]].data() : zero_row.data();
+        long long* up = nullptr;
+        int pv = path1.parent[v];
+        if (pv >= 0) {
+            if (row_of[pv] < 0) {
+                if (free_rows.empty()) {
+                    free_rows.push_back(rows.size());
+                    rows.push_back(zero_row);
+                }
+                row_of[pv] = free_rows.back();
+                free_rows.pop_back();
+            }
+            up = rows[row_of[pv]].data();
+        }
+        const bool first = pv >= 0 && path1.first_child(pv) == v;
+        const bool last = pv >= 0 && path1.last_child(pv) == v;
+        const bool heavy = pv >= 0 && path1.heavy_child[pv] == v;
+
+        const long long size_v = path1.subtree_size[v];
+        fill(in_t2.begin(), in_t2.end(), 0);
+        for (int w = 0; w < n2; ++w) {
+            const long long size_w = path2.subtree_size[w];
+            long long options[6] = {
+                size_v * path2.left_forests[w] + sv[w],
+                size_v * path2.right_forests[w] + sv[n2 + w],
+                size_v * (size_w + 1) * (size_w + 1) + sv[2 * n2 + w],
+                size_w * path1.left_forests[v] + in_t2[w],
+                size_w * path1.right_forests[v] + in_t2[n2 + w],
+                size_w * (size_v + 1) * (size_v + 1) + in_t2[2 * n2 + w]
+            };
+            int best = 0;
+            for (int o = 1; o < 6; ++o) {
+                if (options[o] < options[best]) best = o;
+            }
+            const long long cost = options[best];
+            strategy[(size_t)v * n2 + w] = (unsigned char)((best % 3) | (best >= 3 ? 4 : 0));
+
+            if (up) {
+                up[w] += first ? sv[w] : cost;
+                up[n2 + w] += last ? sv[n2 + w] : cost;
+                up[2 * n2 + w] += heavy ? sv[2 * n2 + w] : cost;
+            }
+            int pw = path2.parent[w];
+            if (pw >= 0) {
+                in_t2[pw] += path2.first_child(pw) == w ? in_t2[w] : cost;
+                in_t2[n2 + pw] += path2.last_child(pw) == w ? in_t2[n2 + w] : cost;
+                in_t2[2 * n2 + pw] += path2.heavy_child[pw] == w ? in_t2[2 * n2 + w] : cost;
+            } else if (pv < 0) {
+                strategy_cost = cost;
+            }
+        }
+
+        if (row_of[v] >= 0) {
+            fill(rows[row_of[v]].begin(), rows[row_of[v]].end(), 0);
+            free_rows.push_back(row_of[v]);
+            row_of[v] = -1;
+        }
+    }
+}
+
+// Runs the decomposition for the root pair with an explicit stack: a pair first
+// schedules the pairs of the subtrees hanging off its path, then runs its single-path
+// function once they are done. Pairs never share a hanging subtree, so their
+// tree_dist blocks are disjoint.
+void Path_Tree_Editing::computeDistances() {
+    struct Frame {
+        int v;
+        int w;
+        bool expanded;
+    };
+    vector<Frame> stack;
+    stack.push_back({path1.root(), path2.root(), false});
+    while (!stack.empty()) {
+        Frame frame = stack.back();
+        Path_Kind kind = strategy_kind(frame.v, frame.w);
+        bool in_t2 = strategy_in_t2(frame.v, frame.w);
+        if (!frame.expanded) {
+            stack.back().expanded = true;
+            const Path_Tree& side = in_t2 ? path2 : path1;
+            int node = in_t2 ? frame.w : frame.v;
+            while (node >= 0) {
+                int next = pathChild(side, node, kind);
+                for (int k = side.child_begin[node]; k < side.child_begin[node+1]; ++k) {
+                    int child = side.children[k];
+                    if (child == next) continue;
+                    if (in_t2) {
+                        stack.push_back({frame.v, child, false});
+                    } else {
+                        stack.push_back({child, frame.w, false});
+                    }
+                }
+                node = next;
+            }
+        } else {
+            stack.pop_back();
+            if (kind == Path_Kind::Heavy) {
+                spfHeavy(frame.v, frame.w, in_t2, kind);
+            } else {
+                spfLeftRight(frame.v, frame.w, in_t2, kind == Path_Kind::Right);
+            }
+        }
+    }
+}
+
+// Zhang-Shasha forest DP of the path subtree against every keyroot subtree of the other
+// side. Left paths run on the post-order arrays; right paths run the same DP on the
+// mirrored arrays and map indices back through mirror_orig.
+void Path_Tree_Editing::spfLeftRight(int v, int w, bool path_in_t2, bool right) {
+    const Path_Tree& A = path_in_t2 ? path2 : path1;
+    const Path_Tree& B = path_in_t2 ? path1 : path2;
+    int a = path_in_t2 ? w : v;
+    int b = path_in_t2 ? v : w;
+
+    const int* lld_a = right ? A.mirror_lld.data() : A.lld.data();
+    const int* labels_a = right ? A.mirror_labels.data() : A.labels.data();
+    const int* orig_a = right ? A.mirror_orig.data() : nullptr;
+    const int* lld_b = right ? B.mirror_lld.data() : B.lld.data();
+    const int* labels_b = right ? B.mirror_labels.data() : B.labels.data();
+    const int* orig_b = right ? B.mirror_orig.data() : nullptr;
+    if (right) {
+        a = A.size() - 1 - A.pre[a];
+        b = B.size() - 1 - B.pre[b];
+    }
+
+    // Deleting from A and inserting from B swap meaning when A is T2
+    const size_t stride_a = path_in_t2 ? 1 : tree_dist_cols;
+    const size_t stride_b = path_in_t2 ? tree_dist_cols : 1;
+    const int del_a = path_in_t2 ? add_cost : remove_cost;
+    const int ins_b = path_in_t2 ? remove_cost : add_cost;
+    int* td = tree_dist.data();
+
+    // Keyroots of b's subtree: the highest node of every leftmost leaf
+    ++mark_stamp;
+    keyroots.clear();
+    for (int k = b; k >= lld_b[b]; --k) {
+        if (keyroot_mark[lld_b[k]] != mark_stamp) {
+            keyroot_mark[lld_b[k]] = mark_stamp;
+            keyroots.push_back(k);
+        }
+    }
+    reverse(keyroots.begin(), keyroots.end());
+
+    const int li = lld_a[a];
+    const int rows = a - li + 1;
+    for (int k : keyroots) {
+        const int lj = lld_b[k];
+        const int cols = k - lj + 1;
+        const size_t fd_cols = cols + 1;
+        if (forest_dist.size() < (rows + 1) * fd_cols) {
+            forest_dist.resize((rows + 1) * fd_cols);
+        }
+        int* fd = forest_dist.data();
+
+        fd[0] = 0;
+        for (int di = 1; di <= rows; di++) {
+            fd[di * fd_cols] = fd[(di-1) * fd_cols] + del_a;
+        }
+        for (int dj = 1; dj <= cols; dj++) {
+            fd[dj] = fd[dj-1] + ins_b;
+        }
+
+        for (int di = 1; di <= rows; di++) {
+            int x = li + di - 1;
+            int lx = lld_a[x];
+            int label_x = labels_a[x];
+            int* row = fd + di * fd_cols;
+            const int* prev_row = row - fd_cols;
+            const int* sub_row = fd + (lx - li) * fd_cols;  // Forest left of the subtree of x
+            int* td_row = td + (orig_a ? orig_a[x] : x) * stride_a;
+
+            for (int dj = 1; dj <= cols; dj++) {
+                int y = lj + dj - 1;
+                int ly = lld_b[y];
+                int& td_cell = td_row[(orig_b ? orig_b[y] : y) * stride_b];
+
+                int del_cost = prev_row[dj] + del_a;
+                int ins_cost = row[dj-1] + ins_b;
+                if (lx == li && ly == lj) {
+                    // Both subtrees start at the forest's leftmost leaf: a subtree pair
+                    int upd_cost = prev_row[dj-1] + (label_x == labels_b[y] ? 0 : rename_cost);
+                    row[dj] = min(del_cost, min(ins_cost, upd_cost));
+                    td_cell = row[dj];
+                } else {
+                    row[dj] = min(del_cost, min(ins_cost, sub_row[ly - lj] + td_cell));
+                }
+            }
+        }
+    }
+}
+
+// Single-path function for an arbitrary path (heavy paths in practice). The subforests
+// of b's subtree that arise when deleting leftmost and rightmost roots are exactly the
+// sets {x : pre(x) >= i, post(x) <= j}, so one (m+1) x (m+1) table indexed by (i, j)
+// holds the distance of an A forest against all of them. Walking the path bottom-up,
+// each level grows the forest from the lower path subtree F_q to F_p: first the
+// subtrees hanging left of q (leftmost-root recurrence, one column j at a time), then
+// those hanging right of q (rightmost-root recurrence, one row i at a time), then p
+// itself. Both region passes only need a scratch of (hanging nodes + 2) x (m+1) cells.
+void Path_Tree_Editing::spfHeavy(int v, int w, bool path_in_t2, Path_Kind kind) {
+    const Path_Tree& A = path_in_t2 ? path2 : path1;
+    const Path_Tree& B = path_in_t2 ? path1 : path2;
+    const int a = path_in_t2 ? w : v;
+    const int b = path_in_t2 ? v : w;
+
+    const size_t stride_a = path_in_t2 ? 1 : tree_dist_cols;
+    const size_t stride_b = path_in_t2 ? tree_dist_cols : 1;
+    const int del_a = path_in_t2 ? add_cost : remove_cost;
+    const int ins_b = path_in_t2 ? remove_cost : add_cost;
+    int* td = tree_dist.data();
+
+    // Subforest (i, j) of b's subtree in local preorder / post-order numbers; column j+1
+    // stores j, so j = -1 (the empty subforest) is column 0
+    const int m = B.subtree_size[b];
+    const int pre0 = B.pre[b];
+    const int post0 = B.lld[b];
+    const size_t W = m + 1;
+    const size_t cells = (m + 1) * W;
+    if (table_cur.size() < cells) {
+        table_cur.resize(cells);
+        table_next.resize(cells);
+        insert_table.resize(cells);
+    }
+    int* cur = table_cur.data();
+    int* next = table_next.data();
+    int* E = insert_table.data();
+
+    for (int i = 0; i <= m; ++i) {
+        int* row = E + i * W;
+        row[0] = 0;
+        for (int j = 0; j < m; ++j) {
+            row[j+1] = row[j] + (B.pre[post0 + j] - pre0 >= i ? ins_b : 0);
+        }
+    }
+    copy(E, E + cells, cur);
+
+    vector<int> path;
+    for (int node = a; node >= 0; node = pathChild(A, node, kind)) {
+        path.push_back(node);
+    }
+
+    for (int level = (int)path.size() - 1; level >= 0; --level) {
+        const int p = path[level];
+        const int q = level + 1 < (int)path.size() ? path[level+1] : -1;
+        const int base = q >= 0 ? A.subtree_size[q] : 0;
+        const int left_nodes = q >= 0 ? A.pre[q] - A.pre[p] - 1 : 0;
+        const int right_nodes = q >= 0 ? p - 1 - q : 0;
+
+        if (left_nodes > 0) {
+            // Row s holds F_q plus the left hanging nodes with preorder pre(p)+s .. pre(q)-1
+            size_t need = (left_nodes + 2) * W;
+            if (forest_dist.size() < need) forest_dist.resize(need);
+            int* S = forest_dist.data();
+            for (int j = -1; j < m; ++j) {
+                int* top = S + (left_nodes + 1) * W;
+                for (int i = 0; i <= m; ++i) {
+                    top[i] = cur[i * W + j + 1];
+                }
+                for (int s = left_nodes; s >= 1; --s) {
+                    int x = A.post_of_pre[A.pre[p] + s];
+                    int* row = S + s * W;
+                    const int* below = row + W;
+                    const int* skip = S + (s + A.subtree_size[x]) * W;
+                    const int* td_row = td + x * stride_a;
+                    row[m] = (base + left_nodes - s + 1) * del_a;
+                    for (int i = m - 1; i >= 0; --i) {
+                        int g = B.post_of_pre[pre0 + i];
+                        if (g - post0 > j) {
+                            row[i] = row[i+1];  // Node i is not in the subforest
+                        } else {
+                            row[i] = min(min(below[i] + del_a, row[i+1] + ins_b),
+                                         skip[i + B.subtree_size[g]] + td_row[g * stride_b]);
+                        }
+                    }
+                }
+                for (int i = 0; i <= m; ++i) {
+                    cur[i * W + j + 1] = S[W + i];
+                }
+            }
+        }
+
+        if (right_nodes > 0) {
+            // Row t holds F_q, the left hanging nodes and post-order nodes q+1 .. q+t
+            size_t need = (right_nodes + 1) * W;
+            if (forest_dist.size() < need) forest_dist.resize(need);
+            int* S = forest_dist.data();
+            for (int i = 0; i <= m; ++i) {
+                copy(cur + i * W, cur + (i + 1) * W, S);
+                for (int t = 1; t <= right_nodes; ++t) {
+                    int y = q + t;
+                    int* row = S + t * W;
+                    const int* prev = row - W;
+                    const int* skip = S + (t - A.subtree_size[y]) * W;
+                    const int* td_row = td + y * stride_a;
+                    row[0] = (base + left_nodes + t) * del_a;
+                    for (int j = 0; j < m; ++j) {
+                        int g = post0 + j;
+                        if (B.pre[g] - pre0 < i) {
+                            row[j+1] = row[j];  // Node j is not in the subforest
+                        } else {
+                            row[j+1] = min(min(prev[j+1] + del_a, row[j] + ins_b),
+                                           skip[j + 1 - B.subtree_size[g]] + td_row[g * stride_b]);
+                        }
+                    }
+                }
+                copy(S + right_nodes * W, S + (right_nodes + 1) * W, cur + i * W);
+            }
+        }
+
+        // The whole subtree of p, matching p against the leftmost root of each subforest
+        const int label_p = A.labels[p];
+        int* td_row = td + p * stride_a;
+        fill(next + m * W, next + (m + 1) * W, A.subtree_size[p] * del_a);
+        for (int i = m - 1; i >= 0; --i) {
+            int g = B.post_of_pre[pre0 + i];
+            int local_post = g - post0;
+            int* row = next + i * W;
+            const int* below = row + W;
+            const int* cur_row = cur + i * W;
+            const int* rest = E + (i + B.subtree_size[g]) * W;
+            const int match_cost = cur[(i + 1) * W + local_post] + (label_p == B.labels[g] ? 0 : rename_cost);
+            for (int j = -1; j < local_post; ++j) {
+                row[j+1] = below[j+1];
+            }
+            for (int j = local_post; j < m; ++j) {
+                row[j+1] = min(min(cur_row[j+1] + del_a, below[j+1] + ins_b), match_cost + rest[j+1]);
+            }
+            td_row[g * stride_b] = row[local_post + 1];
+        }
+        swap(cur, next);
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef PATH_TREE_EDITING_H
+#define PATH_TREE_EDITING_H
+
+#include <iostream>
+#include <vector>
+#include "Tree.h"
+#include "Prepared_Tree.h"
+#include "Path_Tree.h"
+
+using namespace std;
+
+// Root-to-leaf path a subtree pair is decomposed along
+enum class Path_Kind : unsigned char { Left, Right, Heavy };
+
+// Tree edit distance by path decomposition (RTED/APTED style). For every subtree
+// pair a strategy picks a left, right or heavy path in one of the two trees; the
+// subtrees hanging off the path are solved first, then one single-path function
+// fills in the distances of every path node against the other subtree. The
+// strategy minimising the number of relevant subproblems is computed up front,
+// which avoids the O(n^4) behaviour Zhang-Shasha shows on unfavourable shapes.
+// Memory stays O(|T1| * |T2|).
+class Path_Tree_Editing {
+public:
+    // Distance of every subtree pair, |T1| x |T2| row-major by post-order index
+    vector<int> tree_dist;
+    int tree_dist_cols = 0;
+
+    // Chosen path per subtree pair: bits 0-1 hold the Path_Kind, bit 2 is set when
+    // the path lies in T2
+    vector<unsigned char> strategy;
+    long long strategy_cost = 0;  // Relevant subproblems predicted by the optimal strategy
+
+    // Scratch reused by the single-path functions
+    vector<int> forest_dist;   // Forest DP of left/right paths and region DP of heavy paths
+    vector<int> table_cur;     // Distances of the current path subtree against every subforest
+    vector<int> table_next;
+    vector<int> insert_table;  // Cost of inserting every subforest
+    vector<int> keyroot_mark;
+    vector<int> keyroots;
+    int mark_stamp = 0;
+
+    const int remove_cost = 1;
+    const int add_cost = 1;
+    const int rename_cost = 1;
+
+    Tree* t1;
+    Tree* t2;
+    Path_Tree path1;
+    Path_Tree path2;
+
+    Path_Tree_Editing(Tree* t1, Tree* t2);
+    virtual ~Path_Tree_Editing() = default;
+
+    // Main tree edit distance calculation
+    int treeEditDistance(Tree T1, Tree T2);
+    int treeEditDistance(const Prepared_Tree& T1, const Prepared_Tree& T2);
+
+    // Strategy selection and the decomposition driver; computeStrategy fills
+    // `strategy` for every subtree pair and defaults to the optimal strategy
+    virtual void computeStrategy();
+    void computeOptimalStrategy();
+    void computeDistances();
+    Path_Kind strategy_kind(int v, int w) const { return (Path_Kind)(strategy[(size_t)v * tree_dist_cols + w] & 3); }
+    bool strategy_in_t2(int v, int w) const { return (strategy[(size_t)v * tree_dist_cols + w] & 4) != 0; }
+
+    // Single-path functions: distances of the path nodes of subtree v (or w when the
+    // path is in T2) against every subtree of the other side
+    void spfLeftRight(int v, int w, bool path_in_t2, bool right);
+    void spfHeavy(int v, int w, bool path_in_t2, Path_Kind kind);
+
+    int& tree_dist_at(int i, int j) { return tree_dist[(size_t)i * tree_dist_cols + j]; }
+
+    // Bytes held by the distance, strategy and scratch tables
+    size_t workspaceBytes() const;
+};
+
+#endif // PATH_TREE_EDITING_H
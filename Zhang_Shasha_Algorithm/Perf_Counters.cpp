@@ -0,0 +1,186 @@
+#include "Perf_Counters.h"
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char* const EVENT_NAMES[PERF_EVENT_COUNT] = {
+    "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"
+};
+
+/**
+* @brief Short snake-case name of a Perf_Event, as used in the benchmark output.
+*/
+const char* perfEventName(int event) {
+   return event >= 0 && event < PERF_EVENT_COUNT ? EVENT_NAMES[event] : "unknown";
+}
+
+Perf_Sample& Perf_Sample::operator+=(const Perf_Sample& other) {
+   for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+       value[e] += other.value[e];
+   }
+   return *this;
+}
+
+Perf_Sample Perf_Sample::operator-(const Perf_Sample& start) const {
+   Perf_Sample delta;
+   for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+       delta.value[e] = value[e] - start.value[e];
+   }
+   return delta;
+}
+
+#ifdef __linux__
+/**
+* @brief Opens one counter of the calling thread on any CPU, disabled, in the group of `leader`.
+* @return The file descriptor, or -1 if the kernel or the CPU refuses the event.
+*/
+static int openEvent(uint32_t type, uint64_t config, int leader) {
+   struct perf_event_attr attr;
+   memset(&attr, 0, sizeof(attr));
+   attr.size = sizeof(attr);
+   attr.type = type;
+   attr.config = config;
+   attr.disabled = leader < 0 ? 1 : 0;  // Members follow the leader
+   attr.exclude_kernel = 1;
+   attr.exclude_hv = 1;
+   attr.read_format = PERF_FORMAT_GROUP;
+   return (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+}
+#endif
+
+/**
+* @brief Opens the events as one group, so they are scheduled together and read in a single
+* call. The first event that opens leads the group; the others are added when the CPU has them.
+*/
+Perf_Counters::Perf_Counters() : group_fd(-1), opened(0) {
+   for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+       fds[e] = -1;
+       slot[e] = -1;
+   }
+#ifdef __linux__
+   const uint32_t types[PERF_EVENT_COUNT] = {
+       PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE
+   };
+   const uint64_t configs[PERF_EVENT_COUNT] = {
+       PERF_COUNT_HW_CPU_CYCLES,
+       PERF_COUNT_HW_INSTRUCTIONS,
+       PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+       PERF_COUNT_HW_CACHE_MISSES,
+       PERF_COUNT_HW_BRANCH_MISSES
+   };
+   for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+       fds[e] = openEvent(types[e], configs[e], group_fd);
+       if (fds[e] < 0) {
+           continue;
+       }
+       if (group_fd < 0) {
+           group_fd = fds[e];
+       }
+       slot[e] = opened++;
+   }
+   if (group_fd >= 0) {
+       ioctl(group_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+       ioctl(group_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+   }
+#endif
+}
+
+Perf_Counters::~Perf_Counters() {
+#ifdef __linux__
+   for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+       if (fds[e] >= 0) {
+           close(fds[e]);
+       }
+   }
+#endif
+}
+
+/**
+* @brief Reads the whole group at once: the kernel writes the number of events followed by
+* their values in the order they joined the group.
+*/
+Perf_Sample Perf_Counters::read() const {
+   Perf_Sample sample;
+#ifdef __linux__
+   if (group_fd < 0) {
+       return sample;
+   }
+   uint64_t buffer[1 + PERF_EVENT_COUNT];
+   ssize_t bytes = ::read(group_fd, buffer, sizeof(buffer));
+   if (bytes < (ssize_t)sizeof(uint64_t) || buffer[0] != (uint64_t)opened) {
+       return sample;
+   }
+   for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+       if (slot[e] >= 0) {
+           sample.value[e] = buffer[1 + slot[e]];
+       }
+   }
+#endif
+   return sample;
+}
+
+/**
+* @brief Counters of the calling thread. perf_event_open counts one thread, so each thread
+* needs its own group; it stays open until the thread exits.
+*/
+Perf_Counters& threadPerfCounters() {
+   thread_local Perf_Counters counters;
+   return counters;
+}
+
+Perf_Bucket& Perf_Profile::bucket(const string& name) {
+   for (Perf_Bucket& existing : buckets) {
+       if (existing.name == name) {
+           return existing;
+       }
+   }
+   buckets.push_back(Perf_Bucket());
+   buckets.back().name = name;
+   return buckets.back();
+}
+
+/**
+* @brief Bucket of a DP of `cells` cells. Powers of 4 keep the number of buckets small while
+* still separating the pairs that fit in L1, L2 and the last level cache.
+*/
+Perf_Bucket& Perf_Profile::sizeBucket(unsigned long long cells) {
+   int exponent = 0;
+   unsigned long long bound = 1;
+   while (bound < cells) {
+       bound <<= 2;
+       ++exponent;
+   }
+   return bucket("<=4^" + to_string(exponent));
+}
+
+static thread_local Perf_Profile* active_profile = nullptr;
+
+Perf_Profile* activePerfProfile() {
+   return active_profile;
+}
+
+Perf_Profile_Scope::Perf_Profile_Scope(Perf_Profile& profile) : previous(active_profile) {
+   active_profile = &profile;
+}
+
+Perf_Profile_Scope::~Perf_Profile_Scope() {
+   active_profile = previous;
+}
+
+Perf_Region::Perf_Region(Perf_Bucket& bucket, unsigned long long cells)
+   : target(bucket), region_cells(cells), start(threadPerfCounters().read()) {
+}
+
+Perf_Region::~Perf_Region() {
+   Perf_Sample end = threadPerfCounters().read();
+   target.counts += end - start;
+   target.cells += region_cells;
+   ++target.calls;
+}
@@ -0,0 +1,102 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Hardware events read around the distance hot loops
+enum Perf_Event {
+    Perf_Cycles,
+    Perf_Instructions,
+    Perf_L1D_Misses,     // L1 data cache read misses
+    Perf_LLC_Misses,     // Last level cache misses
+    Perf_Branch_Misses,
+    PERF_EVENT_COUNT
+};
+
+const char* perfEventName(int event);  // "cycles", "instructions", "l1d_misses", ...
+
+// Counter values of one region, or their sum over many
+struct Perf_Sample {
+    unsigned long long value[PERF_EVENT_COUNT] = {};
+
+    Perf_Sample& operator+=(const Perf_Sample& other);
+    Perf_Sample operator-(const Perf_Sample& start) const;
+};
+
+// One group of hardware counters for the calling thread, opened with perf_event_open on
+// Linux (user space only). Events the CPU or the kernel refuse are left out, e.g. in VMs or
+// with kernel.perf_event_paranoid > 2; with none open available() is false and read()
+// returns zeros, so callers fall back to timing only
+class Perf_Counters {
+public:
+    Perf_Counters();
+    ~Perf_Counters();
+    Perf_Counters(const Perf_Counters&) = delete;
+    Perf_Counters& operator=(const Perf_Counters&) = delete;
+
+    bool available() const { return group_fd >= 0; }
+    bool has(int event) const { return slot[event] >= 0; }
+    Perf_Sample read() const;  // Running totals; subtract two reads to count a region
+
+private:
+    int group_fd;                  // Group leader, -1 when nothing could be opened
+    int fds[PERF_EVENT_COUNT];
+    int slot[PERF_EVENT_COUNT];    // Position of each event in a group read, -1 if missing
+    int opened;
+};
+
+// The calling thread's counters, opened on first use
+Perf_Counters& threadPerfCounters();
+
+// Counters summed over the calls that fell into one bucket
+struct Perf_Bucket {
+    string name;
+    size_t calls = 0;
+    unsigned long long cells = 0;  // DP cells of those calls, so counts can be read per cell
+    Perf_Sample counts;
+};
+
+// Named buckets filled by Perf_Regions while the profile is active on a thread
+class Perf_Profile {
+public:
+    vector<Perf_Bucket> buckets;  // In order of first use
+
+    Perf_Bucket& bucket(const string& name);
+    Perf_Bucket& sizeBucket(unsigned long long cells);  // "<=4^k": cells rounded up to a power of 4
+    void clear() { buckets.clear(); }
+};
+
+// Profile the engines of this thread report into, nullptr when no one is profiling
+Perf_Profile* activePerfProfile();
+
+// Activates a profile on this thread while in scope; the previous one is restored after
+class Perf_Profile_Scope {
+public:
+    explicit Perf_Profile_Scope(Perf_Profile& profile);
+    ~Perf_Profile_Scope();
+    Perf_Profile_Scope(const Perf_Profile_Scope&) = delete;
+    Perf_Profile_Scope& operator=(const Perf_Profile_Scope&) = delete;
+
+private:
+    Perf_Profile* previous;
+};
+
+// Adds the counts between its construction and destruction to a bucket
+class Perf_Region {
+public:
+    Perf_Region(Perf_Bucket& bucket, unsigned long long cells);
+    ~Perf_Region();
+    Perf_Region(const Perf_Region&) = delete;
+    Perf_Region& operator=(const Perf_Region&) = delete;
+
+private:
+    Perf_Bucket& target;
+    unsigned long long region_cells;
+    Perf_Sample start;
+};
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,91 @@
+#include "Prepared_Tree.h"
+
+#include <algorithm>
+
+using namespace std;
+
+/**
+* @brief Builds the flat arrays from a tree whose post-order indices and keyroots are already computed.
+* @param tree Tree after Tree::post_order and Tree::find_keyroots have been run.
+*/
+Prepared_Tree::Prepared_Tree(const Tree& tree) {
+   assign(tree);
+}
+
+/**
+* @brief Flattens a Tree into the existing arrays, reusing their capacity.
+* @param tree Tree after post_order and find_keyroots.
+*/
+void Prepared_Tree::assign(const Tree& tree) {
+   const vector<Node*>& indices = tree.get_indices();
+   labels.resize(indices.size());
+   lld.resize(indices.size());
+   parent.assign(indices.size(), -1);
+   hashes.resize(indices.size());
+   for (size_t k = 0; k < indices.size(); ++k) {
+       labels[k] = indices[k]->label;
+       lld[k] = indices[k]->li;
+       hashes[k] = indices[k]->hash;
+       for (Node* child : indices[k]->children) {
+           parent[child->walking_index] = (int)k;
+       }
+   }
+
+   keyroots.clear();
+   for (Node* keyroot : tree.get_LR_keyroots()) {
+       keyroots.push_back(keyroot->walking_index);
+   }
+   // Descendant keyroots must be processed first; ascending post-order guarantees it
+   sort(keyroots.begin(), keyroots.end());
+   linkKeyroots();
+}
+
+/**
+* @brief Builds the flat arrays from post-order labels and parents, deriving leftmost leaves, hashes and keyroots.
+* @param node_labels Label of each node by post-order index.
+* @param node_parent Parent post-order index of each node, -1 for the root.
+*/
+Prepared_Tree::Prepared_Tree(const vector<int>& node_labels, const vector<int>& node_parent)
+   : labels(node_labels), parent(node_parent) {
+   const int n = (int)labels.size();
+   lld.resize(n);
+   hashes.resize(n);
+   for (int k = 0; k < n; ++k) {
+       lld[k] = k;
+       hashes[k] = labelHash(labels[k]);
+   }
+   // Children precede their parent, in order, and the leftmost child has the smallest
+   // leftmost leaf; a node's hash is complete once all of its children are folded in
+   for (int k = 0; k < n; ++k) {
+       if (parent[k] >= 0) {
+           lld[parent[k]] = min(lld[parent[k]], lld[k]);
+           hashes[parent[k]] = combineSubtreeHash(hashes[parent[k]], hashes[k]);
+       }
+   }
+   // Keyroots are the root and every node with a left sibling
+   for (int k = 0; k < n; ++k) {
+       if (parent[k] < 0 || lld[parent[k]] != lld[k]) {
+           keyroots.push_back(k);
+       }
+   }
+   linkKeyroots();
+}
+
+/**
+* @brief Links every keyroot to its nearest keyroot ancestor.
+*/
+void Prepared_Tree::linkKeyroots() {
+   // Every node shares its leftmost leaf with exactly one keyroot (the top of its left path),
+   // so the nearest keyroot ancestor of a keyroot is the one owning its parent's leftmost leaf
+   vector<int> keyroot_by_lld(labels.size(), -1);
+   for (size_t k = 0; k < keyroots.size(); ++k) {
+       keyroot_by_lld[lld[keyroots[k]]] = (int)k;
+   }
+   keyroot_parent.assign(keyroots.size(), -1);
+   for (size_t k = 0; k < keyroots.size(); ++k) {
+       int up = parent[keyroots[k]];
+       if (up >= 0) {
+           keyroot_parent[k] = keyroot_by_lld[lld[up]];
+       }
+   }
+}
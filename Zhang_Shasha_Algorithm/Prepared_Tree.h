@@ -0,0 +1,35 @@
+#ifndef PREPARED_TREE_H
+#define PREPARED_TREE_H
+
+#include <vector>
+#include "Tree.h"
+
+using namespace std;
+
+// Immutable structure-of-arrays view of a tree, indexed by post-order position.
+// Built once from a Tree after post_order/find_keyroots so the edit distance
+// inner loops read contiguous arrays instead of chasing Node pointers.
+class Prepared_Tree {
+public:
+    vector<int> labels;    // Label of each node
+    vector<int> lld;       // Leftmost leaf descendant (Node::li) of each node
+    vector<int> parent;    // Parent index of each node, -1 for the root
+    vector<unsigned long long> hashes;  // Merkle hash of each node's subtree (see labelHash)
+    vector<int> keyroots;  // Keyroot indices in increasing post-order (processing order)
+    vector<int> keyroot_parent;  // Position in keyroots of the nearest keyroot ancestor, -1 for the root
+
+    Prepared_Tree() = default;
+    explicit Prepared_Tree(const Tree& tree);
+    // From post-order arrays of any tree representation (parent -1 for the root)
+    Prepared_Tree(const vector<int>& node_labels, const vector<int>& node_parent);
+
+    int size() const { return (int)labels.size(); }
+
+    // Rebuilds the arrays from a Tree in place, reusing their capacity
+    void assign(const Tree& tree);
+
+    // Fills keyroot_parent from the other arrays, for code that builds them directly
+    void linkKeyroots();
+};
+
+#endif // PREPARED_TREE_H
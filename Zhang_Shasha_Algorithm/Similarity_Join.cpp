@@ -0,0 +1,217 @@
+#include "Similarity_Join.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+using namespace std;
+
+enum { STAGE_SIZE, STAGE_LABELS, STAGE_DEGREES, STAGE_STRINGS, STAGE_EXACT };
+
+/**
+* @brief Creates an empty join for the given distance threshold.
+* @param threshold Largest unit-cost TED a reported pair may have.
+*/
+Similarity_Join::Similarity_Join(int threshold) : threshold(threshold) {
+   for (const char* name : {"size", "label histogram", "degree histogram", "traversal strings", "exact TED"}) {
+       Join_Stage stage;
+       stage.name = name;
+       stage_stats.push_back(stage);
+   }
+}
+
+/**
+* @brief Adds a tree to the corpus and computes its signature.
+* @param tree Tree whose post-order indices and keyroots are already computed.
+* @return Index of the tree in the corpus.
+*/
+int Similarity_Join::add(Tree* tree) {
+   trees.push_back(tree);
+   signatures.push_back(signature(*tree));
+   return (int)trees.size() - 1;
+}
+
+/**
+* @brief Computes the sizes, histograms and traversal strings the filters compare.
+* @param tree Tree whose post-order indices are already computed.
+*/
+Join_Signature Similarity_Join::signature(Tree& tree) {
+   Join_Signature result;
+   vector<Node*> nodes = tree.get_indices();
+   result.size = (int)nodes.size();
+
+   map<int, int> labels;
+   map<int, int> degrees;
+   result.postorder.reserve(nodes.size());
+   for (Node* node : nodes) {
+       result.postorder.push_back(node->label);
+       ++labels[node->label];
+       ++degrees[(int)node->children.size()];
+   }
+   result.label_histogram.assign(labels.begin(), labels.end());
+   result.degree_histogram.assign(degrees.begin(), degrees.end());
+
+   // Pre-order with an explicit stack; children are pushed right to left
+   result.preorder.reserve(nodes.size());
+   vector<Node*> stack;
+   if (tree.get_root()) {
+       stack.push_back(tree.get_root());
+   }
+   while (!stack.empty()) {
+       Node* node = stack.back();
+       stack.pop_back();
+       result.preorder.push_back(node->label);
+       for (auto child = node->children.rbegin(); child != node->children.rend(); ++child) {
+           stack.push_back(*child);
+       }
+   }
+   return result;
+}
+
+/**
+* @brief Label multiset lower bound: the larger of the two one-sided multiset differences.
+* @param a Signature of the first tree.
+* @param b Signature of the second tree.
+*/
+int Similarity_Join::labelBound(const Join_Signature& a, const Join_Signature& b) {
+   int only_a = 0, only_b = 0;
+   size_t i = 0, j = 0;
+   while (i < a.label_histogram.size() || j < b.label_histogram.size()) {
+       if (j == b.label_histogram.size() || (i < a.label_histogram.size() && a.label_histogram[i].first < b.label_histogram[j].first)) {
+           only_a += a.label_histogram[i++].second;
+       } else if (i == a.label_histogram.size() || b.label_histogram[j].first < a.label_histogram[i].first) {
+           only_b += b.label_histogram[j++].second;
+       } else {
+           int difference = a.label_histogram[i++].second - b.label_histogram[j++].second;
+           (difference > 0 ? only_a : only_b) += abs(difference);
+       }
+   }
+   return max(only_a, only_b);
+}
+
+/**
+* @brief Degree histogram lower bound: L1 distance of the child-count histograms over 3, rounded up.
+* @param a Signature of the first tree.
+* @param b Signature of the second tree.
+*/
+int Similarity_Join::degreeBound(const Join_Signature& a, const Join_Signature& b) {
+   int l1 = 0;
+   size_t i = 0, j = 0;
+   while (i < a.degree_histogram.size() || j < b.degree_histogram.size()) {
+       if (j == b.degree_histogram.size() || (i < a.degree_histogram.size() && a.degree_histogram[i].first < b.degree_histogram[j].first)) {
+           l1 += a.degree_histogram[i++].second;
+       } else if (i == a.degree_histogram.size() || b.degree_histogram[j].first < a.degree_histogram[i].first) {
+           l1 += b.degree_histogram[j++].second;
+       } else {
+           l1 += abs(a.degree_histogram[i++].second - b.degree_histogram[j++].second);
+       }
+   }
+   return (l1 + 2) / 3;
+}
+
+/**
+* @brief Unit-cost string edit distance restricted to the diagonal band of the threshold.
+* @param a First label string.
+* @param b Second label string.
+* @return The distance if it is at most the threshold, otherwise threshold + 1.
+*/
+int Similarity_Join::stringBound(const vector<int>& a, const vector<int>& b) {
+   const int n = (int)a.size();
+   const int m = (int)b.size();
+   const int cap = threshold + 1;
+   if (abs(n - m) > threshold) {
+       return cap;
+   }
+   previous_row.resize(m + 2);
+   current_row.resize(m + 2);
+   for (int j = 0; j <= m + 1; ++j) {
+       previous_row[j] = min(j, cap);
+   }
+
+   for (int i = 1; i <= n; ++i) {
+       // Cells outside [i - threshold, i + threshold] exceed the threshold and read as cap
+       const int lo = max(1, i - threshold);
+       const int hi = min(m, i + threshold);
+       current_row[lo - 1] = lo == 1 ? min(i, cap) : cap;
+       int row_min = current_row[lo - 1];
+       for (int j = lo; j <= hi; ++j) {
+           int value = min(previous_row[j] + 1, current_row[j - 1] + 1);
+           value = min(value, previous_row[j - 1] + (a[i - 1] != b[j - 1]));
+           current_row[j] = min(value, cap);
+           row_min = min(row_min, current_row[j]);
+       }
+       current_row[hi + 1] = cap;
+       if (row_min >= cap) {
+           return cap;  // Every later row is at least this row's minimum
+       }
+       swap(previous_row, current_row);
+   }
+   return previous_row[m];
+}
+
+/**
+* @brief Finds every pair of corpus trees within the threshold.
+* @return The matching pairs (first < second), in size order of the smaller tree.
+*/
+vector<Join_Match> Similarity_Join::selfJoin() {
+   for (Join_Stage& stage : stage_stats) {
+       stage.entered = stage.passed = 0;
+   }
+   vector<Join_Match> matches;
+   const unsigned long long n = trees.size();
+   if (n < 2) {
+       return matches;
+   }
+   stage_stats[STAGE_SIZE].entered = n * (n - 1) / 2;
+
+   // Size filter as a sweep: in size order, only the window of trees at most threshold
+   // nodes larger is ever paired
+   vector<int> order(trees.size());
+   for (size_t k = 0; k < order.size(); ++k) {
+       order[k] = (int)k;
+   }
+   stable_sort(order.begin(), order.end(), [&](int x, int y) { return signatures[x].size < signatures[y].size; });
+
+   Tree_Editing engine(trees[0], trees[0]);
+   for (size_t p = 0; p < order.size(); ++p) {
+       const Join_Signature& a = signatures[order[p]];
+       for (size_t q = p + 1; q < order.size() && signatures[order[q]].size - a.size <= threshold; ++q) {
+           const Join_Signature& b = signatures[order[q]];
+           ++stage_stats[STAGE_SIZE].passed;
+
+           ++stage_stats[STAGE_LABELS].entered;
+           if (labelBound(a, b) > threshold) continue;
+           ++stage_stats[STAGE_LABELS].passed;
+
+           ++stage_stats[STAGE_DEGREES].entered;
+           if (degreeBound(a, b) > threshold) continue;
+           ++stage_stats[STAGE_DEGREES].passed;
+
+           ++stage_stats[STAGE_STRINGS].entered;
+           if (stringBound(a.preorder, b.preorder) > threshold || stringBound(a.postorder, b.postorder) > threshold) continue;
+           ++stage_stats[STAGE_STRINGS].passed;
+
+           ++stage_stats[STAGE_EXACT].entered;
+           int first = min(order[p], order[q]);
+           int second = max(order[p], order[q]);
+           int distance = engine.boundedDistance(*trees[first], *trees[second], threshold);
+           if (distance > threshold) continue;
+           ++stage_stats[STAGE_EXACT].passed;
+           matches.push_back({first, second, distance});
+       }
+   }
+   return matches;
+}
+
+/**
+* @brief Prints how many pairs entered and passed each stage of the last join.
+*/
+void Similarity_Join::printStages() const {
+   cout << left << setw(20) << "Stage" << right << setw(16) << "Entered" << setw(16) << "Passed" << setw(12) << "Pass rate" << endl;
+   for (const Join_Stage& stage : stage_stats) {
+       cout << left << setw(20) << stage.name << right << setw(16) << stage.entered << setw(16) << stage.passed
+            << setw(11) << fixed << setprecision(2) << 100.0 * stage.pass_rate() << "%" << endl;
+   }
+}
@@ -0,0 +1,80 @@
+#ifndef SIMILARITY_JOIN_H
+#define SIMILARITY_JOIN_H
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "Tree.h"
+#include "Tree_Editing.h"
+
+using namespace std;
+
+// A pair of corpus trees within the join threshold
+struct Join_Match {
+    int first;
+    int second;
+    int distance;
+};
+
+// Pairs that reached and survived one stage of the filter cascade
+struct Join_Stage {
+    string name;
+    unsigned long long entered = 0;
+    unsigned long long passed = 0;
+
+    double pass_rate() const { return entered ? (double)passed / entered : 0.0; }
+};
+
+// Per-tree summary the lower bounds compare, computed once when the tree is added
+struct Join_Signature {
+    int size = 0;
+    vector<pair<int, int>> label_histogram;   // (label, count), sorted by label
+    vector<pair<int, int>> degree_histogram;  // (children, count), sorted by children
+    vector<int> preorder;                     // Labels in pre-order
+    vector<int> postorder;                    // Labels in post-order
+};
+
+// Self-join of a tree corpus under unit-cost TED: every pair at distance <= threshold.
+// Pairs go through cheap lower bounds before the exact engine, cheapest first:
+//   size              | |T1| - |T2| |, checked by a sweep over the trees sorted by size
+//   label histogram   larger side of the label multiset difference (a rename fixes one
+//                     label on each side, an insert/delete one label on one side)
+//   degree histogram  L1 distance of the child-count histograms / 3 (an insert/delete
+//                     changes its own and its parent's count, a rename none)
+//   traversal strings string edit distance of the pre-order and of the post-order label
+//                     sequences, banded to the threshold (each is a TED lower bound)
+// Survivors are verified with Tree_Editing::boundedDistance.
+class Similarity_Join {
+public:
+    explicit Similarity_Join(int threshold);
+
+    // Adds a tree (after Tree::post_order and Tree::find_keyroots); returns its index.
+    // The tree must outlive the join
+    int add(Tree* tree);
+    int size() const { return (int)trees.size(); }
+
+    // All pairs (first < second) within the threshold; refreshes the stage counters
+    vector<Join_Match> selfJoin();
+    const vector<Join_Stage>& stages() const { return stage_stats; }
+    void printStages() const;
+
+    static Join_Signature signature(Tree& tree);
+
+    // Lower bounds on unit-cost TED
+    static int labelBound(const Join_Signature& a, const Join_Signature& b);
+    static int degreeBound(const Join_Signature& a, const Join_Signature& b);
+    // Edit distance of two label strings, or threshold + 1 once it exceeds threshold
+    int stringBound(const vector<int>& a, const vector<int>& b);
+
+private:
+    int threshold;
+    vector<Tree*> trees;
+    vector<Join_Signature> signatures;
+    vector<Join_Stage> stage_stats;
+
+    // Banded string DP rows, reused by every stringBound call
+    vector<int> previous_row;
+    vector<int> current_row;
+};
+
+#endif // SIMILARITY_JOIN_H
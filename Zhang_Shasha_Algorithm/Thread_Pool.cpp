@@ -0,0 +1,144 @@
+#include "Thread_Pool.h"
+
+using namespace std;
+
+/**
+* @brief Starts the worker threads, which sleep until run() hands them tasks.
+* @param num_threads Number of worker threads (at least one is created).
+*/
+Thread_Pool::Thread_Pool(int num_threads) {
+   if (num_threads < 1) num_threads = 1;
+   for (int i = 0; i < num_threads; ++i) {
+       queues.push_back(make_unique<Worker_Queue>());
+   }
+   for (int i = 0; i < num_threads; ++i) {
+       workers.emplace_back(&Thread_Pool::workerLoop, this, i);
+   }
+}
+
+/**
+* @brief Stops and joins all worker threads.
+*/
+Thread_Pool::~Thread_Pool() {
+   {
+       lock_guard<mutex> guard(state_lock);
+       stopping = true;
+   }
+   work_available.notify_all();
+   for (thread& worker : workers) {
+       worker.join();
+   }
+}
+
+/**
+* @brief Distributes the initial tasks round-robin and waits until the pool drains.
+* @param initial_tasks Tasks that are ready to run immediately.
+* @param task_handler Function executed for every task, receiving the worker id.
+*/
+void Thread_Pool::run(const vector<Task>& initial_tasks, const Handler& task_handler) {
+   if (initial_tasks.empty()) return;
+
+   handler = &task_handler;
+   outstanding += (long long)initial_tasks.size();
+   for (size_t i = 0; i < initial_tasks.size(); ++i) {
+       Worker_Queue& queue = *queues[i % queues.size()];
+       lock_guard<mutex> guard(queue.lock);
+       queue.tasks.push_back(initial_tasks[i]);
+   }
+   queued += (long long)initial_tasks.size();
+   wakeWorkers(true);
+
+   unique_lock<mutex> guard(state_lock);
+   all_done.wait(guard, [this] { return outstanding.load() == 0; });
+   handler = nullptr;
+}
+
+/**
+* @brief Queues a task on the calling worker's own deque.
+* @param worker Id of the worker running the current handler.
+* @param task Task to queue.
+*/
+void Thread_Pool::push(int worker, Task task) {
+   ++outstanding;
+   {
+       Worker_Queue& queue = *queues[worker];
+       lock_guard<mutex> guard(queue.lock);
+       queue.tasks.push_back(task);
+   }
+   ++queued;
+   if (sleeping.load() > 0) {
+       wakeWorkers(false);
+   }
+}
+
+/**
+* @brief Wakes sleeping workers after new tasks were queued.
+* @param all Wake every worker instead of a single one.
+*/
+void Thread_Pool::wakeWorkers(bool all) {
+   {
+       // Taking the lock orders this wake-up after any in-progress sleep decision
+       lock_guard<mutex> guard(state_lock);
+   }
+   if (all) {
+       work_available.notify_all();
+   } else {
+       work_available.notify_one();
+   }
+}
+
+/**
+* @brief Takes the newest task from the worker's own deque, or steals the oldest one from another worker.
+* @param id Id of the calling worker.
+* @param task Receives the task when one was found.
+* @return True if a task was found.
+*/
+bool Thread_Pool::popOrSteal(int id, Task& task) {
+   if (queued.load() == 0) return false;
+
+   {
+       Worker_Queue& own = *queues[id];
+       lock_guard<mutex> guard(own.lock);
+       if (!own.tasks.empty()) {
+           task = own.tasks.back();
+           own.tasks.pop_back();
+           --queued;
+           return true;
+       }
+   }
+   for (size_t k = 1; k < queues.size(); ++k) {
+       Worker_Queue& victim = *queues[(id + k) % queues.size()];
+       lock_guard<mutex> guard(victim.lock);
+       if (!victim.tasks.empty()) {
+           task = victim.tasks.front();
+           victim.tasks.pop_front();
+           --queued;
+           return true;
+       }
+   }
+   return false;
+}
+
+/**
+* @brief Main loop of a worker thread: run tasks while any exist, otherwise sleep.
+* @param id Id of this worker.
+*/
+void Thread_Pool::workerLoop(int id) {
+   while (true) {
+       Task task;
+       if (popOrSteal(id, task)) {
+           (*handler)(id, task);
+           if (--outstanding == 0) {
+               lock_guard<mutex> guard(state_lock);
+               all_done.notify_all();
+           }
+           continue;
+       }
+
+       unique_lock<mutex> guard(state_lock);
+       ++sleeping;
+       work_available.wait(guard, [this] { return stopping || queued.load() > 0; });
+       --sleeping;
+       if (stopping) return;
+   }
+}
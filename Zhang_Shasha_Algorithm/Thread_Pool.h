@@ -0,0 +1,58 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Work-stealing pool of persistent threads. Tasks are plain integers interpreted by
+// the handler passed to run(); a running task may push follow-up tasks onto its own
+// worker queue, and idle workers steal from the front of the other queues.
+class Thread_Pool {
+public:
+    typedef long long Task;
+    typedef function<void(int worker, Task task)> Handler;
+
+    explicit Thread_Pool(int num_threads);
+    ~Thread_Pool();
+
+    int size() const { return (int)workers.size(); }
+
+    // Seeds the queues with initial_tasks and blocks until every task (including the
+    // ones pushed while running) has finished
+    void run(const vector<Task>& initial_tasks, const Handler& task_handler);
+
+    // Queues a follow-up task on the given worker; only valid from inside a handler
+    void push(int worker, Task task);
+
+private:
+    struct Worker_Queue {
+        mutex lock;
+        deque<Task> tasks;
+    };
+
+    vector<thread> workers;
+    vector<unique_ptr<Worker_Queue>> queues;
+
+    mutex state_lock;
+    condition_variable work_available;
+    condition_variable all_done;
+    atomic<long long> queued{0};       // Tasks sitting in some queue
+    atomic<long long> outstanding{0};  // Tasks queued or running
+    atomic<int> sleeping{0};
+    bool stopping = false;
+    const Handler* handler = nullptr;
+
+    void workerLoop(int id);
+    bool popOrSteal(int id, Task& task);
+    void wakeWorkers(bool all);
+};
+
+#endif // THREAD_POOL_H
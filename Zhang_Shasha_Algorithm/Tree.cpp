@@ -26,6 +26,25 @@ void printTreeKeyroots(const vector<Node*>& keyroots, const string& title) {
     }
 }
 
+// splitmix64 finalizer: spreads every input bit over the whole word
+static unsigned long long mixHash(unsigned long long x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Hash of a node on its own (a leaf subtree)
+unsigned long long labelHash(int label) {
+    return mixHash((unsigned long long)(long long)label + 0x9e3779b97f4a7c15ULL);
+}
+
+// Folds the next child's subtree hash into its parent's; order sensitive
+unsigned long long combineSubtreeHash(unsigned long long hash, unsigned long long child_hash) {
+    return mixHash(hash * 0x100000001b3ULL ^ child_hash);
+}
+
 // =================== Node class implementation ===================
 
 /**
@@ -33,8 +52,10 @@ void printTreeKeyroots(const vector<Node*>& keyroots, const string& title) {
 * @param label The character label of the node.
 * @param li The Li index of the node.
 * @param walking_index The post-order traversal index of the node.
+* @param memory Where the child list is allocated (the heap unless the node is in a Node_Arena).
 */
-Node::Node(char label, int li, int walking_index) : label(label), li(li), walking_index(walking_index) {};
+Node::Node(char label, int li, int walking_index, pmr::memory_resource* memory)
+    : label(label), li(li), walking_index(walking_index), children(memory) {};
 
 /**
 * @brief Adds a child node to this node.
@@ -62,9 +83,9 @@ Node *Tree::get_root() {
 
 /**
 * @brief Returns the vector of nodes indexed in post-order.
-* @return Vector of pointers to the nodes.
+* @return Vector of pointers to the nodes, valid until the next post_order.
 */
-vector<Node *> Tree::get_indices() {
+const vector<Node*>& Tree::get_indices() const {
    return indices;
 }
 
@@ -83,57 +104,75 @@ Node* Tree::get_node(int index) {
 
 /**
 * @brief Returns the vector of keyroots in the tree.
-* @return Vector of pointers to the keyroot nodes.
+* @return Vector of pointers to the keyroot nodes, valid until the next find_keyroots.
 */
-vector<Node*> Tree::get_LR_keyroots() { 
+const vector<Node*>& Tree::get_LR_keyroots() const {
    return LR_keyroots;
 }
 
 /**
-* @brief Performs post-order traversal, assigning indices and Li values to nodes.
-* @param current_node Pointer to the current node being visited.
+* @brief Performs post-order traversal, assigning indices, Li values and subtree hashes to nodes.
+* Uses an explicit stack, so the depth of the tree is not limited by the call stack.
+* @param current_node Pointer to the root of the subtree to traverse.
 * @param counter Reference to the counter used for assigning traversal indices.
 */
 void Tree::post_order(Node *current_node, int &counter) {
    if (current_node == nullptr)
        return;
 
-   int li = -1;
-
-   for (size_t i = 0; i < current_node->children.size(); ++i)
-   {
-       Node *child = current_node->children[i];
-       post_order(child, counter);
-       if (i == 0 && child != nullptr)
-       {
-           li = child->li;
+   // Pre-order with the children pushed left to right visits every subtree right to left;
+   // reversed, that is exactly the post-order
+   size_t first = indices.size();
+   vector<Node*> stack;
+   stack.push_back(current_node);
+   while (!stack.empty()) {
+       Node* node = stack.back();
+       stack.pop_back();
+       indices.push_back(node);
+       for (Node* child : node->children) {
+           if (child != nullptr) stack.push_back(child);
        }
    }
-
-   current_node->walking_index = counter++;
-
-   current_node->li = (current_node->children.empty()) ? current_node->li = current_node->walking_index : current_node->li = li;
-
-   indices.push_back(current_node);
+   reverse(indices.begin() + first, indices.end());
+
+   // Children come before their parent, so their Li values and hashes are ready
+   for (size_t k = first; k < indices.size(); ++k) {
+       Node* node = indices[k];
+       int li = -1;
+       unsigned long long hash = labelHash(node->label);
+       for (size_t i = 0; i < node->children.size(); ++i) {
+           Node* child = node->children[i];
+           if (child == nullptr) continue;
+           if (i == 0) li = child->li;
+           hash = combineSubtreeHash(hash, child->hash);
+       }
+       node->hash = hash;
+       node->walking_index = counter++;
+       node->li = node->children.empty() ? node->walking_index : li;
+   }
 }
 
 /**
 * @brief Finds the keyroots in the tree and stores them in LR_keyroots.
-* @param current_node Pointer to the current node being visited.
+* Visits nodes in pre-order with an explicit stack.
+* @param current_node Pointer to the root of the subtree to search.
 * @param last_li Reference to the last Li value found.
 */
 void Tree::find_keyroots(Node *current_node, int &last_li) {
    if (current_node == nullptr) return;
 
-   if (current_node->li != last_li) {
-       LR_keyroots.push_back(current_node);
-       last_li = current_node->li;
-   }
-
-   for ( Node* child : current_node->children) {
-       find_keyroots(child, last_li);
+   vector<Node*> stack;
+   stack.push_back(current_node);
+   while (!stack.empty()) {
+       Node* node = stack.back();
+       stack.pop_back();
+       if (node->li != last_li) {
+           LR_keyroots.push_back(node);
+           last_li = node->li;
+       }
+       // Right to left, so the leftmost child is visited first
+       for (auto child = node->children.rbegin(); child != node->children.rend(); ++child) {
+           if (*child != nullptr) stack.push_back(*child);
+       }
    }
-   
-   // Reversal should not be done here within recursion
-   // It should be done once after all recursive calls
-}
\ No newline at end of file
+}
@@ -2,6 +2,7 @@
 #define TREE_H
 
 #include <iostream>
+#include <memory_resource>
 #include <vector>
 
 using namespace std;
@@ -10,12 +11,18 @@ class Node {
 public:
     char label;
     int li, walking_index;
-    vector<Node*> children;
+    unsigned long long hash = 0;  // Merkle hash of the subtree, set by Tree::post_order
+    pmr::vector<Node*> children;  // Drawn from the node's Node_Arena, if it has one
 
-    Node(char label, int li, int walk_index);
+    Node(char label, int li, int walk_index, pmr::memory_resource* memory = pmr::get_default_resource());
     void add_child(Node* childPointer);
 };
 
+// Merkle subtree hash: a leaf hashes its label and each child's hash is folded in left to
+// right, so equal hashes flag (almost surely) identical labelled subtrees
+unsigned long long labelHash(int label);
+unsigned long long combineSubtreeHash(unsigned long long hash, unsigned long long child_hash);
+
 // Utility functions for printing (after Node definition)
 void printTreeNodes(const vector<Node*>& nodes, const string& title);
 void printTreeKeyroots(const vector<Node*>& keyroots, const string& title);
@@ -29,8 +36,8 @@ private:
 public:
     explicit Tree(Node* root);
     Node* get_root();
-    vector<Node*> get_LR_keyroots();
-    vector<Node*> get_indices();
+    const vector<Node*>& get_LR_keyroots() const;
+    const vector<Node*>& get_indices() const;
     Node* get_node(int index);
     void post_order(Node* current_node, int& counter);
     void find_keyroots(Node* current_node, int& last_li);
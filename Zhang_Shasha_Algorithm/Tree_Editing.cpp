@@ -1,9 +1,12 @@
 #include "Tree_Editing.h"
 #include <algorithm> // For reverse() and min()
+#include <cstdlib> // For abs()
 #include <iomanip> // For setw()
+#include "Perf_Counters.h"
 
-// Utility function to print distance matrices
-void printTreeEditingMatrix(const vector<vector<int>>& matrix, const vector<Node*>& nodes1, const vector<Node*>& nodes2, const string& title) {
+// Utility function to print distance matrices; `stride` is the row stride when it exceeds |T2| + 1
+void printTreeEditingMatrix(const vector<int>& matrix, const vector<Node*>& nodes1, const vector<Node*>& nodes2, const string& title, size_t stride) {
+    const size_t cols = stride ? stride : nodes2.size() + 1; // Row stride of the flat matrix
     cout << "\n" << title << ":\n";
     cout << setw(8) << " ";
     cout << setw(10) << "∅";
@@ -14,136 +17,816 @@ void printTreeEditingMatrix(const vector<vector<int>>& matrix, const vector<Node
     cout << string(8 * (nodes2.size() + 2), '-') << endl;
     cout << setw(10) << "∅";
     for (size_t j = 0; j <= nodes2.size(); ++j) {
-        cout << setw(8) << matrix[0][j];
+        cout << setw(8) << matrix[j];
     }
     cout << endl;
     for (size_t i = 0; i < nodes1.size(); ++i) {
         cout << setw(8) << nodes1[i]->label;
         for (size_t j = 0; j <= nodes2.size(); ++j) {
-            cout << setw(8) << matrix[i+1][j];
+            cout << setw(8) << matrix[(i+1) * cols + j];
         }
         cout << endl;
     }
     cout << endl;
 }
 
-Tree_Editing::Tree_Editing(Tree* tree1, Tree* tree2)
-    : t1(tree1), t2(tree2) {
+template <class Cost_Policy>
+Basic_Tree_Editing<Cost_Policy>::Basic_Tree_Editing(Tree* tree1, Tree* tree2, const Cost_Policy& cost_policy)
+    : costs(cost_policy), t1(tree1), t2(tree2) {
     // Initialize node vectors
     nodes1 = t1->get_indices();
     nodes2 = t2->get_indices();
     
-    // Prepare matrices for distance calculation
-    tree_dist.resize(nodes1.size() + 1, vector<int>(nodes2.size() + 1, 0));
-    forest_dist.resize(nodes1.size() + 1, vector<int>(nodes2.size() + 1, 0));
+    // tree_dist and the forest scratch are sized on first use, so out-of-core mode
+    // can still be selected before a matrix that does not fit in RAM is allocated
 }
 
-int Tree_Editing::interval_calc(int li, int i) {
+template <class Cost_Policy>
+Basic_Tree_Editing<Cost_Policy>::Basic_Tree_Editing(const Cost_Policy& cost_policy) : costs(cost_policy) {
+}
+
+// Sizes tree_dist for the current node vectors, reallocating only when it has to grow
+template <class Cost_Policy>
+void Basic_Tree_Editing<Cost_Policy>::prepareTreeDist() {
+    int rows = prepared1->size() + 1;
+    int cols = prepared2->size() + 1;
+    tree_dist_cols = cols;
+    if (!tree_dist_directory.empty()) {
+        // A fresh zero-filled file per run; the previous one is closed and deleted
+        mapped_tree_dist.reset();
+        mapped_tree_dist = Mapped_Tree_Dist::create(tree_dist_directory, rows, cols, sizeof(cost_type), tree_dist_budget);
+        if (mapped_tree_dist) {
+            ++allocation_count;
+            tree_dist_data = (cost_type*)mapped_tree_dist->data();
+            return;
+        }
+        cerr << "Keeping tree_dist in memory" << endl;
+        tree_dist_directory.clear();
+    }
+    tree_dist_column.clear();
+    free_columns.clear();
+    size_t cells = (size_t)rows * cols;
+    if (tree_dist.capacity() < cells) {
+        ++allocation_count;
+    }
+    tree_dist.assign(cells, 0);
+    tree_dist_data = tree_dist.data();
+}
+
+// Selects out-of-core mode for the next treeEditDistance call
+template <class Cost_Policy>
+void Basic_Tree_Editing<Cost_Policy>::set_tree_dist_file(const string& directory, size_t resident_budget_bytes) {
+    tree_dist_directory = directory;
+    tree_dist_budget = resident_budget_bytes;
+    // Drop the in-memory matrix instead of keeping both around
+    vector<cost_type>().swap(tree_dist);
+}
+
+// Grows the forest scratch to at least `cells` entries (high-water mark, never shrinks)
+template <class Cost_Policy>
+void Basic_Tree_Editing<Cost_Policy>::reserveForestDist(size_t cells) {
+    if (forest_dist.size() < cells) {
+        forest_dist.resize(cells);
+        ++allocation_count;
+    }
+}
+
+// Grows the auxiliary arrays of the diagonal kernels (high-water mark, never shrinks)
+template <class Cost_Policy>
+void Basic_Tree_Editing<Cost_Policy>::reserveForestAux(size_t cells) {
+    if (forest_aux.size() < cells) {
+        forest_aux.resize(cells);
+        ++allocation_count;
+    }
+}
+
+// Lays out a (rows+1) x (cols+1) forest distance matrix at the start of the scratch buffer
+template <class Cost_Policy>
+void Basic_Tree_Editing<Cost_Policy>::prepareForestDist(int rows, int cols) {
+    reserveForestDist((size_t)(rows + 1) * (cols + 1));
+    forest_dist_cols = cols + 1;
+    if (kernel != Forest_Kernel::Scalar) {
+        reserveForestAux(diagonalAuxSize(rows, cols));
+    }
+}
+
+template <class Cost_Policy>
+int Basic_Tree_Editing<Cost_Policy>::interval_calc(int li, int i) {
     return i >= li ? i - li + 1 : 0; // Ensure interval has correct size, with correct instances counted. If i < li, interval is empty.
 }
 
 // Primary implementation for tree distance computation
-int Tree_Editing::computeTreeDistance(int index1, int index2) {
-    Node* n1 = get_node1(index1);
-    Node* n2 = get_node2(index2);
-    int li = n1->li;
-    int lj = n2->li;
+template <class Cost_Policy>
+typename Basic_Tree_Editing<Cost_Policy>::cost_type Basic_Tree_Editing<Cost_Policy>::computeTreeDistance(int index1, int index2) {
+    if (identicalSubtrees(index1, index2)) {
+        fillIdenticalPair(index1, index2);
+        ++skipped_keyroot_pairs;
+        return 0;
+    }
+    int rows = interval_calc(prepared1->lld[index1], index1);
+    int cols = interval_calc(prepared2->lld[index2], index2);
+    
+    // Reuse the scratch buffer with this pair's row stride
+    prepareForestDist(rows, cols);
+    Perf_Profile* profile = activePerfProfile();
+    if (profile != nullptr) {
+        // Counters per keyroot pair size, only when someone is profiling this thread
+        unsigned long long cells = (unsigned long long)rows * cols;
+        Perf_Region region(profile->sizeBucket(cells), cells);
+        return forestDistance(index1, index2, forest_dist.data(), forest_aux.data());
+    }
+    return forestDistance(index1, index2, forest_dist.data(), forest_aux.data());
+}
+
+// True when the keyroot pair may skip its DP: unit costs and equal labelled subtrees. The
+// hash rejects almost every other pair at once; a match is confirmed on the labels and the
+// leftmost leaf offsets, which fix a post-order subtree's shape, so a collision is harmless
+template <class Cost_Policy>
+bool Basic_Tree_Editing<Cost_Policy>::identicalSubtrees(int index1, int index2) const {
+    if (!Is_Unit_Cost<Cost_Policy>::value || !skip_identical_subtrees ||
+        prepared1->hashes.size() != (size_t)prepared1->size() || prepared2->hashes.size() != (size_t)prepared2->size() ||
+        prepared1->hashes[index1] != prepared2->hashes[index2]) {
+        return false;
+    }
+    const int li = prepared1->lld[index1];
+    const int lj = prepared2->lld[index2];
+    if (index1 - li != index2 - lj) {
+        return false;
+    }
+    for (int offset = 0; offset <= index1 - li; ++offset) {
+        if (prepared1->labels[li + offset] != prepared2->labels[lj + offset] ||
+            prepared1->lld[li + offset] - li != prepared2->lld[lj + offset] - lj) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Writes the tree_dist block of a pair of identical subtrees. The pair's DP would set the
+// entries of the two leftmost paths; node x on one path and y on the other root subtrees of
+// sizes x - li + 1 and y - lj + 1, the smaller one a copy of a subtree on the larger one's
+// leftmost path. Deleting the nodes outside that copy turns one into the other, and at unit
+// cost no script is shorter than the size difference
+template <class Cost_Policy>
+void Basic_Tree_Editing<Cost_Policy>::fillIdenticalPair(int index1, int index2) {
+    const int li = prepared1->lld[index1];
+    const int lj = prepared2->lld[index2];
+    touchTreeDist(li + 1, index1 + 1, lj + 1, index2 + 1);
+    for (int x = li; x <= index1; ++x) {
+        if (prepared1->lld[x] != li) continue;
+        for (int y = lj; y <= index2; ++y) {
+            if (prepared2->lld[y] != lj) continue;
+            tree_dist_at(x + 1, y + 1) = (cost_type)std::abs((x - li) - (y - lj));
+        }
+    }
+}
+
+// Forest distance DP for one keyroot pair with the selected kernel
+template <class Cost_Policy>
+typename Basic_Tree_Editing<Cost_Policy>::cost_type Basic_Tree_Editing<Cost_Policy>::forestDistance(int index1, int index2, cost_type* forest, int* aux) {
+    if (kernel != Forest_Kernel::Scalar) {
+        return forestDistanceDiagonal(index1, index2, forest, aux);
+    }
+    return forestDistanceScalar(index1, index2, forest);
+}
+
+// Scalar forest distance DP for one keyroot pair into the given scratch (row stride cols + 1)
+template <class Cost_Policy>
+typename Basic_Tree_Editing<Cost_Policy>::cost_type Basic_Tree_Editing<Cost_Policy>::forestDistanceScalar(int index1, int index2, cost_type* fd) {
+    if (mapped_tree_dist) {
+        return forestDistanceScalarIn<Tree_Dist_Layout::Tiled>(index1, index2, fd);
+    }
+    if (!tree_dist_column.empty()) {
+        return forestDistanceScalarIn<Tree_Dist_Layout::Indirect>(index1, index2, fd);
+    }
+    return forestDistanceScalarIn<Tree_Dist_Layout::Row_Major>(index1, index2, fd);
+}
+
+// Scalar DP over a row-major, tiled or column-mapped tree_dist. Reads only the prepared
+// post-order arrays; no Node pointers are touched in the loop
+template <class Cost_Policy>
+template <Tree_Dist_Layout Layout>
+typename Basic_Tree_Editing<Cost_Policy>::cost_type Basic_Tree_Editing<Cost_Policy>::forestDistanceScalarIn(int index1, int index2, cost_type* fd) {
+    const int* lld1 = prepared1->lld.data();
+    const int* lld2 = prepared2->lld.data();
+    const int* labels1 = prepared1->labels.data();
+    const int* labels2 = prepared2->labels.data();
+    int li = lld1[index1];
+    int lj = lld2[index2];
     int rows = interval_calc(li, index1);
     int cols = interval_calc(lj, index2);
     
-    // Clear and resize forest distance matrix
-    forest_dist.clear();
-    forest_dist.resize(rows + 1, vector<int>(cols + 1, 0));
+    const size_t fd_cols = cols + 1;
+    cost_type* td = tree_dist_data;
+    const size_t td_cols = tree_dist_cols;
+    const bool Tiled = Layout == Tree_Dist_Layout::Tiled;
+    const int* column = tree_dist_column.data();
+    // Tiled columns: tile index times tile size plus the column inside the tile
+    auto td_col = [column](int j) -> size_t {
+        return Layout == Tree_Dist_Layout::Tiled ? Mapped_Tree_Dist::colOffset(j)
+             : Layout == Tree_Dist_Layout::Indirect ? (size_t)column[j] : (size_t)j;
+    };
     
     // Initialize forest distance matrix
-    forest_dist[0][0] = 0;
+    fd[0] = 0;
     for (int di = 1; di <= rows; di++) {
-        forest_dist[di][0] = forest_dist[di-1][0] + remove_cost;
+        fd[di * fd_cols] = fd[(di-1) * fd_cols] + costs.remove(li + di - 1);
     }
     for (int dj = 1; dj <= cols; dj++) {
-        forest_dist[0][dj] = forest_dist[0][dj-1] + add_cost;
+        fd[dj] = fd[dj-1] + costs.insert(lj + dj - 1);
     }
     
     // Main dynamic programming computation
     for (int di = 1; di <= rows; di++) {
+        int node_i_idx = li + di - 1;
+        int li_i = lld1[node_i_idx];
+        int label_i = labels1[node_i_idx];
+        cost_type remove_i = costs.remove(node_i_idx);
+        
+        cost_type* row = fd + di * fd_cols;
+        const cost_type* prev_row = row - fd_cols;
+        const cost_type* sub_row = fd + (li_i - li) * fd_cols;  // Forest left of the subtree of node i
+        cost_type* td_row;
+        if (Tiled) {
+            // Rows are read once each, in order; account for each band as it is entered
+            int td_i = node_i_idx + 1;
+            if (di == 1 || (td_i & (Mapped_Tree_Dist::TILE - 1)) == 0) {
+                touchTreeDist(td_i, std::min(index1 + 1, td_i | (Mapped_Tree_Dist::TILE - 1)), lj + 1, index2 + 1);
+            }
+            td_row = td + mapped_tree_dist->rowOffset(td_i);
+        } else {
+            td_row = td + (node_i_idx + 1) * td_cols;
+        }
+        
         for (int dj = 1; dj <= cols; dj++) {
-            int node_i_idx = li + di - 1;
             int node_j_idx = lj + dj - 1;
+            int li_j = lld2[node_j_idx];
             
-            Node* ni = get_node1(node_i_idx);
-            Node* nj = get_node2(node_j_idx);
+            cost_type del_cost = prev_row[dj] + remove_i;
+            cost_type ins_cost = row[dj-1] + costs.insert(node_j_idx);
             
-            if (ni->li == li && nj->li == lj) {
+            if (li_i == li && li_j == lj) {
                 // Both nodes are leftmost leaves in their respective forests
-                int update_cost = (ni->label == nj->label) ? 0 : rename_cost;
-                int del_cost = forest_dist[di-1][dj] + remove_cost;
-                int ins_cost = forest_dist[di][dj-1] + add_cost;
-                int upd_cost = forest_dist[di-1][dj-1] + update_cost;
-                
-                forest_dist[di][dj] = std::min(del_cost, std::min(ins_cost, upd_cost));
+                cost_type upd_cost = prev_row[dj-1] + costs.rename(label_i, labels2[node_j_idx]);
                 
-                int ti = ni->walking_index+1;
-                int tj = nj->walking_index+1;
-                tree_dist[ti][tj] = forest_dist[di][dj];
+                row[dj] = std::min(del_cost, std::min(ins_cost, upd_cost));
+                td_row[td_col(node_j_idx + 1)] = row[dj];
             } else {
                 // At least one node is not a leftmost leaf
-                int del_cost = forest_dist[di-1][dj] + remove_cost;
-                int ins_cost = forest_dist[di][dj-1] + add_cost;
-                int sub_di = ni->li - li;
-                int sub_dj = nj->li - lj;
+                cost_type sub_cost = sub_row[li_j - lj] + td_row[td_col(node_j_idx + 1)];
                 
-                int ti = ni->walking_index+1;
-                int tj = nj->walking_index+1;
-                int sub_cost = forest_dist[sub_di][sub_dj] + tree_dist[ti][tj];
-                
-                forest_dist[di][dj] = std::min(del_cost, std::min(ins_cost, sub_cost));
+                row[dj] = std::min(del_cost, std::min(ins_cost, sub_cost));
             }
         }
     }
-    return forest_dist[rows][cols];
+    return fd[rows * fd_cols + cols];
 }
 
 // Legacy method name for backward compatibility
-int Tree_Editing::comput_tree_dist(int index1, int index2) {
+template <class Cost_Policy>
+typename Basic_Tree_Editing<Cost_Policy>::cost_type Basic_Tree_Editing<Cost_Policy>::comput_tree_dist(int index1, int index2) {
     return computeTreeDistance(index1, index2);
 }
 
 // Primary tree edit distance calculation
-int Tree_Editing::treeEditDistance(Tree T1, Tree T2) {
+template <class Cost_Policy>
+typename Basic_Tree_Editing<Cost_Policy>::cost_type Basic_Tree_Editing<Cost_Policy>::treeEditDistance(Tree T1, Tree T2) {
     nodes1 = T1.get_indices();
     nodes2 = T2.get_indices();
     
-    vector<Node*> keyroots1 = T1.get_LR_keyroots();
-    vector<Node*> keyroots2 = T2.get_LR_keyroots();
+    // Flatten both trees once; keyroots come out in processing order
+    owned1.assign(T1);
+    owned2.assign(T2);
+    prepared1 = &owned1;
+    prepared2 = &owned2;
+    return computePreparedDistance();
+}
+
+// Runs the DP on the caller's arrays, without copying them
+template <class Cost_Policy>
+typename Basic_Tree_Editing<Cost_Policy>::cost_type Basic_Tree_Editing<Cost_Policy>::treeEditDistance(const Prepared_Tree& T1, const Prepared_Tree& T2) {
+    nodes1.clear();
+    nodes2.clear();
+    prepared1 = &T1;
+    prepared2 = &T2;
+    return computePreparedDistance();
+}
+
+// Incremental update after edits to T2. tree_dist[x][y] depends only on the subtrees of x
+// and y, so the column of every node whose subtree holds no changed node is still valid,
+// wherever the node now sits in post-order. Columns therefore stay in place and are found
+// through tree_dist_column: a surviving node keeps its column, a deleted node's column goes
+// to the free list and an inserted node takes one from it. A keyroot pair recomputes the
+// columns of its keyroot's leftmost path, all of which lie in the keyroot's subtree, so
+// running the pairs of the keyroots on the paths from the changed nodes to the root, in the
+// usual order, refreshes every stale column. Apart from those pairs the update makes linear
+// passes over T2 (flattening it and mapping the columns), with no hashing and no copy of
+// tree_dist unless it has to grow.
+template <class Cost_Policy>
+typename Basic_Tree_Editing<Cost_Policy>::cost_type Basic_Tree_Editing<Cost_Policy>::updateTreeEditDistance(const Tree& edited, const vector<Node*>& changed) {
+    if (nodes2.empty() || mapped_tree_dist || tree_dist_data != tree_dist.data() ||
+        tree_dist.size() != (size_t)(prepared1->size() + 1) * tree_dist_cols) {
+        if (prepared1->size() == 0 && t1) {
+            nodes1 = t1->get_indices();
+            owned1.assign(*t1);
+            prepared1 = &owned1;
+        }
+        nodes2 = edited.get_indices();
+        owned2.assign(edited);
+        prepared2 = &owned2;
+        updated_keyroot_pairs = prepared1->keyroots.size() * prepared2->keyroots.size();
+        return computePreparedDistance();
+    }
+    
+    // Columns are still in post-order after a full run
+    const int old_n2 = (int)nodes2.size();
+    if (tree_dist_column.empty()) {
+        tree_dist_column.resize(old_n2 + 1);
+        for (int y = 0; y <= old_n2; ++y) {
+            tree_dist_column[y] = y;
+        }
+    }
+    
+    // A node of the previous T2 survived when the new post-order put it back at its index
+    const vector<Node*>& new_nodes = edited.get_indices();
+    const int n1 = prepared1->size();
+    const int n2 = (int)new_nodes.size();
+    auto alive = [&](const Node* node) {
+        return node && node->walking_index >= 0 && node->walking_index < n2 && new_nodes[node->walking_index] == node;
+    };
+    vector<int> column(n2 + 1, -1);
+    column[0] = tree_dist_column[0];  // T1 against the empty forest never changes
+    for (int y = 0; y < old_n2; ++y) {
+        if (alive(nodes2[y])) {
+            column[nodes2[y]->walking_index + 1] = tree_dist_column[y + 1];
+        } else {
+            free_columns.push_back(tree_dist_column[y + 1]);
+        }
+    }
+    nodes2 = new_nodes;
+    owned2.assign(edited);
+    prepared2 = &owned2;
     
-    // Reverse keyroots for Zhang-Shasha algorithm
-    reverse(keyroots1.begin(), keyroots1.end());
-    reverse(keyroots2.begin(), keyroots2.end());
+    // Inserted nodes take free columns; any not listed as changed is treated as changed
+    vector<int> changed_index;
+    for (Node* node : changed) {
+        if (alive(node)) changed_index.push_back(node->walking_index);
+    }
+    for (int y = 0; y < n2; ++y) {
+        if (column[y + 1] >= 0) continue;
+        if (free_columns.empty()) {
+            growTreeDistColumns(n2 + 1);
+        }
+        column[y + 1] = free_columns.back();
+        free_columns.pop_back();
+        changed_index.push_back(y);
+    }
+    tree_dist_column.swap(column);
+    // Relabels alone leave every column in post-order; the kernels then skip the column map
+    bool in_post_order = true;
+    for (int y = 0; y <= n2 && in_post_order; ++y) {
+        in_post_order = tree_dist_column[y] == y;
+    }
+    if (in_post_order) {
+        tree_dist_column.clear();
+    }
+    
+    // Keyroots on the paths from the changed nodes to the root; each walk stops at the
+    // first node an earlier one already marked
+    const int* parent2 = prepared2->parent.data();
+    const int* lld2 = prepared2->lld.data();
+    vector<char> affected(n2, 0);
+    vector<int> keyroots;
+    for (int y : changed_index) {
+        for (; y >= 0 && !affected[y]; y = parent2[y]) {
+            affected[y] = 1;
+            if (parent2[y] < 0 || lld2[parent2[y]] != lld2[y]) {
+                keyroots.push_back(y);
+            }
+        }
+    }
+    sort(keyroots.begin(), keyroots.end());
+    
+    for (int j = 1; j <= n2; ++j) {
+        tree_dist_at(0, j) = tree_dist_at(0, j-1) + costs.insert(j - 1);
+    }
+    int max_rows = 0, max_cols = 0;
+    for (int i : prepared1->keyroots) {
+        max_rows = std::max(max_rows, interval_calc(prepared1->lld[i], i));
+    }
+    for (int j : keyroots) {
+        max_cols = std::max(max_cols, interval_calc(lld2[j], j));
+    }
+    reserveForestDist((size_t)(max_rows + 1) * (max_cols + 1));
+    if (kernel != Forest_Kernel::Scalar) {
+        reserveForestAux(diagonalAuxSize(max_rows, max_cols));
+    }
+    
+    updated_keyroot_pairs = 0;
+    skipped_keyroot_pairs = 0;
+    for (int i : prepared1->keyroots) {
+        for (int j : keyroots) {
+            computeTreeDistance(i, j);
+            ++updated_keyroot_pairs;
+        }
+    }
+    return tree_dist_at(n1, n2);
+}
+
+// Widens the rows of tree_dist to at least `columns` storage columns, with a quarter of
+// slack so a run of inserts reallocates only now and then; the new columns go to the free list
+template <class Cost_Policy>
+void Basic_Tree_Editing<Cost_Policy>::growTreeDistColumns(int columns) {
+    const int old_cols = tree_dist_cols;
+    const int new_cols = std::max(columns, old_cols + old_cols / 4 + 16);
+    const int rows = prepared1->size() + 1;
+    vector<cost_type> wider((size_t)rows * new_cols, 0);
+    for (int i = 0; i < rows; ++i) {
+        std::copy(tree_dist.begin() + (size_t)i * old_cols, tree_dist.begin() + (size_t)(i + 1) * old_cols,
+                  wider.begin() + (size_t)i * new_cols);
+    }
+    tree_dist.swap(wider);
+    tree_dist_data = tree_dist.data();
+    tree_dist_cols = new_cols;
+    ++allocation_count;
+    for (int c = new_cols - 1; c >= old_cols; --c) {
+        free_columns.push_back(c);
+    }
+}
+
+// Zhang-Shasha over prepared1 and prepared2
+template <class Cost_Policy>
+typename Basic_Tree_Editing<Cost_Policy>::cost_type Basic_Tree_Editing<Cost_Policy>::computePreparedDistance() {
+    const vector<int>& keyroots1 = prepared1->keyroots;
+    const vector<int>& keyroots2 = prepared2->keyroots;
     
     // Initialize tree distance matrix
-    tree_dist.resize(nodes1.size() + 1, vector<int>(nodes2.size() + 1, 0));
+    prepareTreeDist();
     
     // Initialize first row and column
-    for (int i = 1; i <= nodes1.size(); ++i) {
-        tree_dist[i][0] = tree_dist[i-1][0] + remove_cost;
+    touchTreeDist(0, 0, 0, prepared2->size());
+    for (int i = 1; i <= prepared1->size(); ++i) {
+        if ((i & (Mapped_Tree_Dist::TILE - 1)) == 0) {
+            touchTreeDist(i, i, 0, 0);
+        }
+        tree_dist_at(i, 0) = tree_dist_at(i-1, 0) + costs.remove(i - 1);
+    }
+    for (int j = 1; j <= prepared2->size(); ++j) {
+        tree_dist_at(0, j) = tree_dist_at(0, j-1) + costs.insert(j - 1);
+    }
+    
+    // Size the forest scratch once for the largest keyroot pair, so the loop below never allocates
+    int max_rows = 0, max_cols = 0;
+    for (int i : keyroots1) {
+        max_rows = std::max(max_rows, interval_calc(prepared1->lld[i], i));
     }
-    for (int j = 1; j <= nodes2.size(); ++j) {
-        tree_dist[0][j] = tree_dist[0][j-1] + add_cost;
+    for (int j : keyroots2) {
+        max_cols = std::max(max_cols, interval_calc(prepared2->lld[j], j));
+    }
+    reserveForestDist((size_t)(max_rows + 1) * (max_cols + 1));
+    if (kernel != Forest_Kernel::Scalar) {
+        reserveForestAux(diagonalAuxSize(max_rows, max_cols));
     }
     
     // Compute distance for each pair of keyroots
-    for (Node* n1 : keyroots1) {
-        for (Node* n2 : keyroots2) {
-            int i = n1->walking_index;
-            int j = n2->walking_index;
-            computeTreeDistance(i, j);
+    size_t allocations_before = allocation_count;
+    skipped_keyroot_pairs = 0;
+    if (num_threads > 1) {
+        computeKeyrootPairsParallel();
+    } else {
+        for (int i : keyroots1) {
+            for (int j : keyroots2) {
+                computeTreeDistance(i, j);
+            }
         }
     }
+    keyroot_loop_allocations = allocation_count - allocations_before;
     
-    return tree_dist[nodes1.back()->walking_index+1][nodes2.back()->walking_index+1];
+    touchTreeDist(prepared1->size(), prepared1->size(), prepared2->size(), prepared2->size());
+    return tree_dist_at(prepared1->size(), prepared2->size());
 }
 
 // Legacy method name for backward compatibility
-int Tree_Editing::tree_dist_calc(Tree T1, Tree T2) {
+template <class Cost_Policy>
+typename Basic_Tree_Editing<Cost_Policy>::cost_type Basic_Tree_Editing<Cost_Policy>::tree_dist_calc(Tree T1, Tree T2) {
     return treeEditDistance(T1, T2);
 }
+
+// Distance and optimal edit script of two trees
+template <class Cost_Policy>
+typename Basic_Tree_Editing<Cost_Policy>::cost_type Basic_Tree_Editing<Cost_Policy>::editScript(Tree T1, Tree T2, const Edit_Sink& sink) {
+    cost_type distance = treeEditDistance(T1, T2);
+    editScript(sink);
+    return distance;
+}
+
+// Zhang-Shasha backtrace over the stored tree_dist. Walking a forest table back from its
+// last cell, a step that is not a delete or an insert either maps two forest roots (both
+// subtrees start at the forest's leftmost leaves) or matches two whole subtrees whose
+// distance was read from tree_dist: the walk jumps past them, and the pair is queued to
+// be expanded later with its own forest table.
+template <class Cost_Policy>
+void Basic_Tree_Editing<Cost_Policy>::editScript(const Edit_Sink& sink) {
+    const int* lld1 = prepared1->lld.data();
+    const int* lld2 = prepared2->lld.data();
+    const int n1 = prepared1->size();
+    const int n2 = prepared2->size();
+    if (n1 == 0 || n2 == 0) {
+        for (int i = n1 - 1; i >= 0; --i) sink({Edit_Operation<cost_type>::Delete, i, -1, costs.remove(i)});
+        for (int j = n2 - 1; j >= 0; --j) sink({Edit_Operation<cost_type>::Insert, -1, j, costs.insert(j)});
+        return;
+    }
+    
+    vector<pair<int, int>> pending = {make_pair(n1 - 1, n2 - 1)};
+    while (!pending.empty()) {
+        const int index1 = pending.back().first;
+        const int index2 = pending.back().second;
+        pending.pop_back();
+        
+        // Recompute this pair's forest table with the scalar kernel (row-major, row stride cols + 1)
+        const int li = lld1[index1];
+        const int lj = lld2[index2];
+        const int rows = interval_calc(li, index1);
+        const int cols = interval_calc(lj, index2);
+        reserveForestDist((size_t)(rows + 1) * (cols + 1));
+        forest_dist_cols = cols + 1;
+        forestDistanceScalar(index1, index2, forest_dist.data());
+        
+        int di = rows, dj = cols;
+        while (di > 0 || dj > 0) {
+            int node1 = li + di - 1;
+            int node2 = lj + dj - 1;
+            if (dj == 0 || (di > 0 && forest_dist_at(di, dj) == forest_dist_at(di-1, dj) + costs.remove(node1))) {
+                sink({Edit_Operation<cost_type>::Delete, node1, -1, costs.remove(node1)});
+                --di;
+            } else if (di == 0 || forest_dist_at(di, dj) == forest_dist_at(di, dj-1) + costs.insert(node2)) {
+                sink({Edit_Operation<cost_type>::Insert, -1, node2, costs.insert(node2)});
+                --dj;
+            } else if (lld1[node1] == li && lld2[node2] == lj) {
+                cost_type rename = costs.rename(prepared1->labels[node1], prepared2->labels[node2]);
+                sink({prepared1->labels[node1] == prepared2->labels[node2] ? Edit_Operation<cost_type>::Match : Edit_Operation<cost_type>::Rename,
+                      node1, node2, rename});
+                --di;
+                --dj;
+            } else {
+                pending.push_back(make_pair(node1, node2));
+                di = lld1[node1] - li;
+                dj = lld2[node2] - lj;
+            }
+        }
+    }
+}
+
+// Bounded tree edit distance with Touzet's k-strip. Every insert and delete costs at least
+// min_indel, so a mapping that matches node x with node y costs at least |x - y| * min_indel
+// (the nodes left of and below them differ by that much), and a forest cell whose forests
+// differ by d nodes costs at least d * min_indel. Pairs and cells further than
+// strip_width = k / min_indel from the diagonal therefore cannot lead to a distance <= k:
+// they are never evaluated and read as k + 1, and every value is capped at k + 1.
+template <class Cost_Policy>
+typename Basic_Tree_Editing<Cost_Policy>::cost_type Basic_Tree_Editing<Cost_Policy>::boundedDistance(Tree T1, Tree T2, cost_type k) {
+    nodes1 = T1.get_indices();
+    nodes2 = T2.get_indices();
+    owned1.assign(T1);
+    owned2.assign(T2);
+    prepared1 = &owned1;
+    prepared2 = &owned2;
+    const int n1 = prepared1->size();
+    const int n2 = prepared2->size();
+    const cost_type cap = k + 1;
+    if (k < 0) {
+        return cap;
+    }
+    
+    // Widest strip the cheapest insert/delete allows
+    cost_type min_indel = cap;
+    for (int x = 0; x < n1; ++x) {
+        min_indel = std::min(min_indel, costs.remove(x));
+    }
+    for (int y = 0; y < n2; ++y) {
+        min_indel = std::min(min_indel, costs.insert(y));
+    }
+    const int largest = std::max(n1, n2);
+    long long width = min_indel > 0 ? (long long)(k / min_indel) : largest;
+    if (std::abs(n1 - n2) > width) {
+        return cap;  // The size difference alone costs more than k
+    }
+    if (width >= largest) {
+        // No pruning possible; the full DP is cheaper than a strip as wide as the trees
+        cost_type distance = treeEditDistance(T1, T2);
+        return distance <= k ? distance : cap;
+    }
+    strip_width = (int)width;
+    const size_t stride = 2 * (size_t)strip_width + 1;
+    
+    if (strip_tree_dist.capacity() < (size_t)n1 * stride) {
+        ++allocation_count;
+    }
+    strip_tree_dist.assign((size_t)n1 * stride, cap);
+    int max_rows = 0;
+    for (int i : prepared1->keyroots) {
+        max_rows = std::max(max_rows, interval_calc(prepared1->lld[i], i));
+    }
+    if (strip_forest_dist.size() < (size_t)(max_rows + 1) * stride) {
+        strip_forest_dist.resize((size_t)(max_rows + 1) * stride);
+        ++allocation_count;
+    }
+    
+    // Keyroots have distinct leftmost leaves, so the keyroots of T2 that can pair with
+    // keyroot i are those of the leaves within the strip around lld(i)
+    vector<int> keyroot_of_leaf2(n2, -1);
+    for (int j : prepared2->keyroots) {
+        keyroot_of_leaf2[prepared2->lld[j]] = j;
+    }
+    vector<int> partners;
+    for (int i : prepared1->keyroots) {
+        int li = prepared1->lld[i];
+        partners.clear();
+        for (int leaf = std::max(0, li - strip_width); leaf <= std::min(n2 - 1, li + strip_width); ++leaf) {
+            if (keyroot_of_leaf2[leaf] >= 0) {
+                partners.push_back(keyroot_of_leaf2[leaf]);
+            }
+        }
+        // Same order as the full keyroot loop: pairs of smaller keyroots of T2 first
+        std::sort(partners.begin(), partners.end());
+        for (int j : partners) {
+            forestDistanceStrip(i, j, cap);
+        }
+    }
+    
+    cost_type distance = strip_tree_dist[(size_t)(n1 - 1) * stride + (n2 - n1 + strip_width)];
+    return distance <= k ? distance : cap;
+}
+
+// Forest distance DP of one keyroot pair restricted to the cells within strip_width of the
+// diagonal. Cells outside the strip, and tree distances of node pairs outside it, read as cap
+template <class Cost_Policy>
+typename Basic_Tree_Editing<Cost_Policy>::cost_type Basic_Tree_Editing<Cost_Policy>::forestDistanceStrip(int index1, int index2, cost_type cap) {
+    const int* lld1 = prepared1->lld.data();
+    const int* lld2 = prepared2->lld.data();
+    const int* labels1 = prepared1->labels.data();
+    const int* labels2 = prepared2->labels.data();
+    const int li = lld1[index1];
+    const int lj = lld2[index2];
+    const int rows = interval_calc(li, index1);
+    const int cols = interval_calc(lj, index2);
+    const int w = strip_width;
+    const size_t stride = 2 * (size_t)w + 1;
+    cost_type* fd = strip_forest_dist.data();
+    cost_type* td = strip_tree_dist.data();
+    
+    auto fd_read = [&](int di, int dj) -> cost_type {
+        return std::abs(dj - di) <= w ? fd[di * stride + (dj - di + w)] : cap;
+    };
+    
+    fd[w] = 0;
+    for (int di = 1; di <= std::min(rows, w); di++) {
+        fd[di * stride + (w - di)] = std::min(cap, (cost_type)(fd_read(di-1, 0) + costs.remove(li + di - 1)));
+    }
+    for (int dj = 1; dj <= std::min(cols, w); dj++) {
+        fd[dj + w] = std::min(cap, (cost_type)(fd_read(0, dj-1) + costs.insert(lj + dj - 1)));
+    }
+    
+    for (int di = 1; di <= rows; di++) {
+        int node_i_idx = li + di - 1;
+        int li_i = lld1[node_i_idx];
+        int label_i = labels1[node_i_idx];
+        cost_type remove_i = costs.remove(node_i_idx);
+        cost_type* row = fd + di * stride + (w - di);  // row[dj] is cell (di, dj)
+        cost_type* td_row = td + (size_t)node_i_idx * stride + (w - node_i_idx);  // td_row[y] is pair (x, y)
+        
+        for (int dj = std::max(1, di - w); dj <= std::min(cols, di + w); dj++) {
+            int node_j_idx = lj + dj - 1;
+            int li_j = lld2[node_j_idx];
+            bool pair_in_strip = std::abs(node_j_idx - node_i_idx) <= w;
+            
+            cost_type del_cost = fd_read(di-1, dj) + remove_i;
+            cost_type ins_cost = fd_read(di, dj-1) + costs.insert(node_j_idx);
+            cost_type value;
+            if (li_i == li && li_j == lj) {
+                // Both nodes are leftmost leaves in their respective forests
+                cost_type upd_cost = fd_read(di-1, dj-1) + costs.rename(label_i, labels2[node_j_idx]);
+                value = std::min(cap, std::min(del_cost, std::min(ins_cost, upd_cost)));
+                if (pair_in_strip) {
+                    td_row[node_j_idx] = value;
+                }
+            } else {
+                cost_type sub_cost = pair_in_strip ? (cost_type)(fd_read(li_i - li, li_j - lj) + td_row[node_j_idx]) : cap;
+                value = std::min(cap, std::min(del_cost, std::min(ins_cost, sub_cost)));
+            }
+            row[dj] = value;
+        }
+    }
+    return fd_read(rows, cols);
+}
+
+// Selects how many threads treeEditDistance uses for the keyroot pairs
+template <class Cost_Policy>
+void Basic_Tree_Editing<Cost_Policy>::set_num_threads(int threads) {
+    num_threads = std::max(1, threads);
+}
+
+// Runs all keyroot pairs on the work-stealing pool following their dependency DAG.
+// Pair (a, b) reads tree_dist entries written by pairs (a', b') where a' and b' are
+// keyroots inside the subtrees of a and b, so it waits on its direct predecessors
+// (child keyroot of a, b) and (a, child keyroot of b). Each pair writes a disjoint
+// block of tree_dist, which makes the result identical to the sequential loop.
+template <class Cost_Policy>
+void Basic_Tree_Editing<Cost_Policy>::computeKeyrootPairsParallel() {
+    const vector<int>& keyroots1 = prepared1->keyroots;
+    const vector<int>& keyroots2 = prepared2->keyroots;
+    const vector<int>& parent1 = prepared1->keyroot_parent;
+    const vector<int>& parent2 = prepared2->keyroot_parent;
+    const long long K1 = keyroots1.size();
+    const long long K2 = keyroots2.size();
+    
+    vector<int> children1(K1, 0), children2(K2, 0);
+    for (long long a = 0; a < K1; ++a) {
+        if (parent1[a] >= 0) children1[parent1[a]]++;
+    }
+    for (long long b = 0; b < K2; ++b) {
+        if (parent2[b] >= 0) children2[parent2[b]]++;
+    }
+    
+    // Remaining predecessors of each pair; pairs of leaf keyroots start ready
+    unique_ptr<atomic<int>[]> pending(new atomic<int>[K1 * K2]);
+    vector<Thread_Pool::Task> ready;
+    for (long long a = 0; a < K1; ++a) {
+        for (long long b = 0; b < K2; ++b) {
+            int count = children1[a] + children2[b];
+            pending[a * K2 + b].store(count, memory_order_relaxed);
+            if (count == 0) ready.push_back(a * K2 + b);
+        }
+    }
+    
+    if (!pool || pool->size() != num_threads) {
+        pool.reset(new Thread_Pool(num_threads));
+    }
+    worker_forest_dist.resize(num_threads);
+    worker_forest_aux.resize(num_threads);
+    vector<size_t> worker_allocations(num_threads, 0);
+    vector<size_t> worker_skipped(num_threads, 0);
+    
+    Thread_Pool& workers = *pool;
+    Thread_Pool::Handler run_pair = [&](int worker, Thread_Pool::Task task) {
+        vector<cost_type>& scratch = worker_forest_dist[worker];
+        vector<int>& aux = worker_forest_aux[worker];
+        while (task >= 0) {
+            long long a = task / K2;
+            long long b = task % K2;
+            int i = keyroots1[a];
+            int j = keyroots2[b];
+            
+            int rows = interval_calc(prepared1->lld[i], i);
+            int cols = interval_calc(prepared2->lld[j], j);
+            size_t cells = (size_t)(rows + 1) * (cols + 1);
+            if (scratch.size() < cells) {
+                scratch.resize(cells);
+                worker_allocations[worker]++;
+            }
+            if (kernel != Forest_Kernel::Scalar && aux.size() < diagonalAuxSize(rows, cols)) {
+                aux.resize(diagonalAuxSize(rows, cols));
+                worker_allocations[worker]++;
+            }
+            if (identicalSubtrees(i, j)) {
+                fillIdenticalPair(i, j);
+                worker_skipped[worker]++;
+            } else {
+                forestDistance(i, j, scratch.data(), aux.data());
+            }
+            
+            // Release successors; keep the first one that became ready on this worker
+            Thread_Pool::Task next = -1;
+            Thread_Pool::Task successors[2] = {
+                parent1[a] >= 0 ? parent1[a] * K2 + b : -1,
+                parent2[b] >= 0 ? a * K2 + parent2[b] : -1
+            };
+            for (Thread_Pool::Task successor : successors) {
+                if (successor >= 0 && pending[successor].fetch_sub(1, memory_order_acq_rel) == 1) {
+                    if (next < 0) {
+                        next = successor;
+                    } else {
+                        workers.push(worker, successor);
+                    }
+                }
+            }
+            task = next;
+        }
+    };
+    workers.run(ready, run_pair);
+    
+    for (size_t count : worker_allocations) {
+        allocation_count += count;
+    }
+    for (size_t count : worker_skipped) {
+        skipped_keyroot_pairs += count;
+    }
+}
+
+template class Basic_Tree_Editing<Unit_Cost<short>>;
+template class Basic_Tree_Editing<Unit_Cost<int>>;
+template class Basic_Tree_Editing<Unit_Cost<double>>;
+template class Basic_Tree_Editing<Per_Node_Cost<short>>;
+template class Basic_Tree_Editing<Per_Node_Cost<int>>;
+template class Basic_Tree_Editing<Per_Node_Cost<double>>;
+template class Basic_Tree_Editing<Per_Node_Cost<double, Rename_Table<double>>>;
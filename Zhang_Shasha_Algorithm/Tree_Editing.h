@@ -1,32 +1,175 @@
 #ifndef TREE_EDITING_H
 #define TREE_EDITING_H
 
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <vector>
 #include "Tree.h"
+#include "Prepared_Tree.h"
+#include "Thread_Pool.h"
+#include "Mapped_Tree_Dist.h"
+#include "Cost_Model.h"
 
 using namespace std;
 
-class Tree_Editing {
+// Forest distance kernels, selectable at runtime. The SIMD ones sweep anti-diagonals
+// (cells on one anti-diagonal are independent) and match the scalar loop exactly.
+enum class Forest_Kernel { Scalar, SSE2, AVX2, Auto };
+
+// How a tree_dist column is found: row-major in post-order, tiled in a mapped file, or
+// through the column map an incremental update leaves behind
+enum class Tree_Dist_Layout { Row_Major, Tiled, Indirect };
+
+// One step of an edit script. Nodes are post-order indices, -1 when the operation has none
+// (node2 of a delete, node1 of an insert); a Match maps two nodes with equal labels
+template <typename Cost>
+struct Edit_Operation {
+    enum Kind { Match, Rename, Delete, Insert };
+    Kind kind;
+    int node1;
+    int node2;
+    Cost cost;
+};
+
+// Zhang-Shasha engine over a cost policy (see Cost_Model.h). Member definitions live in
+// Tree_Editing.cpp and Tree_Editing_Simd.cpp, instantiated for the policies listed at the
+// end of this file; Tree_Editing is the unit-cost int engine.
+template <class Cost_Policy = Unit_Cost<int>>
+class Basic_Tree_Editing {
 public:
-    vector<vector<int>> tree_dist;
-    vector<vector<int>> forest_dist;
-    const int remove_cost = 1;
-    const int add_cost = 1;
-    const int rename_cost = 1;
-
-    Tree* t1;
-    Tree* t2;
+    typedef typename Cost_Policy::cost_type cost_type;
+    typedef function<void(const Edit_Operation<cost_type>&)> Edit_Sink;
+    static_assert(is_same<typename Cost_Policy::label_type, int>::value,
+                  "Prepared_Tree labels are interned ints");
+
+    // Tree distance matrix, (|T1|+1) x (|T2|+1) stored row-major in one block, or
+    // tiled in a memory-mapped scratch file in out-of-core mode
+    vector<cost_type> tree_dist;
+    int tree_dist_cols = 0;               // Row stride; after updates it includes the free columns
+    cost_type* tree_dist_data = nullptr;  // Start of whichever storage is in use
+    unique_ptr<Mapped_Tree_Dist> mapped_tree_dist;
+    // Storage column of each T2 post-order index plus one, once updateTreeEditDistance has
+    // kept columns where they were; empty while columns are in post-order
+    vector<int> tree_dist_column;
+    vector<int> free_columns;
+    string tree_dist_directory;     // Empty keeps tree_dist in RAM
+    size_t tree_dist_budget = 0;
+
+    // Forest distance scratch shared by every keyroot pair. It only grows up to the
+    // largest pair seen (high-water mark) and is reused with a per-pair row stride.
+    vector<cost_type> forest_dist;
+    int forest_dist_cols = 0;
+
+    // Number of workspace (re)allocations, and how many of them happened inside
+    // the keyroot loop of the last treeEditDistance call. The sequential loop keeps
+    // it at zero; with num_threads > 1 each worker's scratch grows there to the
+    // largest pair it runs, and those allocations are counted
+    size_t allocation_count = 0;
+    size_t keyroot_loop_allocations = 0;
+
+    // Threads used for the keyroot pairs; 1 runs the sequential keyroot loop
+    int num_threads = 1;
+    unique_ptr<Thread_Pool> pool;
+    vector<vector<cost_type>> worker_forest_dist;  // Per-worker forest scratch in parallel mode
+    vector<vector<int>> worker_forest_aux;
+
+    // Diagonal strips used by boundedDistance: entry (x, y) of a strip of half-width
+    // strip_width lives at x * (2 * strip_width + 1) + (y - x + strip_width)
+    vector<cost_type> strip_tree_dist;
+    vector<cost_type> strip_forest_dist;
+    int strip_width = 0;
+
+    // Identical subtree pairs: under unit costs a keyroot pair whose subtrees are equal (same
+    // Merkle hash, then checked node by node) has a closed-form tree_dist block, filled without
+    // the forest DP. Counts the pairs filled that way in the last run
+    bool skip_identical_subtrees = true;
+    size_t skipped_keyroot_pairs = 0;
+
+    // Kernel used for the forest distance DP and the per-pair index/label arrays it needs
+    Forest_Kernel kernel = Forest_Kernel::Scalar;
+    vector<int> forest_aux;
+
+    Cost_Policy costs;
+
+    Tree* t1 = nullptr;
+    Tree* t2 = nullptr;
     vector<Node*> nodes1;
     vector<Node*> nodes2;
 
-    Tree_Editing(Tree* t1, Tree* t2);
+    // Flat post-order arrays read by the DP inner loop. The Tree entry points flatten into
+    // owned1/owned2 (reusing their capacity); the Prepared_Tree one points at the caller's
+    // trees instead of copying them
+    Prepared_Tree owned1;
+    Prepared_Tree owned2;
+    const Prepared_Tree* prepared1 = &owned1;
+    const Prepared_Tree* prepared2 = &owned2;
+
+    Basic_Tree_Editing(Tree* t1, Tree* t2, const Cost_Policy& costs = Cost_Policy());
+    // Engine not bound to a Tree pair, for the Prepared_Tree entry point
+    explicit Basic_Tree_Editing(const Cost_Policy& costs = Cost_Policy());
+    // Not copyable or movable: prepared1/prepared2 may point into the engine itself
+    Basic_Tree_Editing(const Basic_Tree_Editing&) = delete;
+    Basic_Tree_Editing& operator=(const Basic_Tree_Editing&) = delete;
 
     // Main tree edit distance calculation methods
-    int treeEditDistance(Tree T1, Tree T2);
-    int tree_dist_calc(Tree T1, Tree T2);  // Legacy name for compatibility
-    int computeTreeDistance(int index1, int index2);
-    int comput_tree_dist(int index1, int index2);  // Legacy name for compatibility
+    cost_type treeEditDistance(Tree T1, Tree T2);
+    // Same distance for trees flattened beforehand; nodes1/nodes2 are left empty. The trees
+    // are not copied, so they must outlive any later use of this run (editScript, update)
+    cost_type treeEditDistance(const Prepared_Tree& T1, const Prepared_Tree& T2);
+    cost_type computePreparedDistance();
+    cost_type tree_dist_calc(Tree T1, Tree T2);  // Legacy name for compatibility
+    cost_type computeTreeDistance(int index1, int index2);
+    cost_type comput_tree_dist(int index1, int index2);  // Legacy name for compatibility
+    cost_type forestDistance(int index1, int index2, cost_type* forest, int* aux);
+    cost_type forestDistanceScalar(int index1, int index2, cost_type* forest);
+    template <Tree_Dist_Layout Layout> cost_type forestDistanceScalarIn(int index1, int index2, cost_type* forest);
+    cost_type forestDistanceDiagonal(int index1, int index2, cost_type* forest, int* aux);
+    bool identicalSubtrees(int index1, int index2) const;
+    void fillIdenticalPair(int index1, int index2);
+
+    // The diagonal kernels are written for unit int costs; other policies run scalar
+    static const bool diagonal_kernels = Is_Unit_Cost<Cost_Policy>::value && is_same<cost_type, int>::value;
+
+    // Bounded distance (Touzet's k-strip): the distance when it is at most k, otherwise k + 1.
+    // Only node pairs and forest cells within k / (cheapest insert or delete) of the
+    // diagonal are evaluated, in O(|T1| k) memory
+    cost_type boundedDistance(Tree T1, Tree T2, cost_type k);
+    cost_type forestDistanceStrip(int index1, int index2, cost_type cap);
+
+    // Incremental mode: after treeEditDistance(T1, T2), T2's nodes were edited in place and
+    // `edited` is indexed again (post_order/find_keyroots on a Tree over the same root).
+    // `changed` lists every node of the edited tree that was inserted, relabeled or whose
+    // children list changed (the parent of an inserted or deleted node). Surviving nodes
+    // keep their tree_dist column and inserted ones take the columns of deleted ones, so no
+    // cell moves; only keyroots of T2 on the paths from the changed nodes to the root are
+    // recomputed. Falls back to a full run when the previous state is missing or tree_dist
+    // is memory-mapped
+    cost_type updateTreeEditDistance(const Tree& edited, const vector<Node*>& changed);
+    void growTreeDistColumns(int columns);
+    size_t updated_keyroot_pairs = 0;  // Keyroot pairs the last update recomputed
+
+    // Optimal edit script, streamed to `sink` one operation at a time. editScript backtracks
+    // the last treeEditDistance run: it keeps a stack of subtree pairs and recomputes the
+    // forest table of one pair at a time from tree_dist, so it needs no memory beyond the
+    // distance run's. Operations come out right to left within each forest
+    cost_type editScript(Tree T1, Tree T2, const Edit_Sink& sink);
+    void editScript(const Edit_Sink& sink);
+
+    // Kernel selection; unsupported instruction sets fall back to the best available one
+    void set_kernel(Forest_Kernel requested);
+    static Forest_Kernel bestAvailableKernel();
+    static bool kernelSupported(Forest_Kernel requested);
+    static size_t diagonalAuxSize(int rows, int cols);
+
+    // Parallel mode over the keyroot pair dependency DAG
+    void set_num_threads(int threads);
+    void computeKeyrootPairsParallel();
+
+    // Out-of-core mode: tree_dist lives in an unlinked scratch file in `directory` and at
+    // most about `resident_budget_bytes` of it is kept in memory. Falls back to RAM (with
+    // a warning) where the file cannot be mapped
+    void set_tree_dist_file(const string& directory, size_t resident_budget_bytes);
 
     // Node access methods with bounds checking
     Node* get_node1(int index) {
@@ -44,12 +187,39 @@ public:
         return nodes2[index];
     }
 
+    // Workspace access and sizing
+    size_t tree_dist_row(int i) const { return mapped_tree_dist ? mapped_tree_dist->rowOffset(i) : (size_t)i * tree_dist_cols; }
+    size_t tree_dist_col(int j) const {
+        return mapped_tree_dist ? Mapped_Tree_Dist::colOffset(j) : tree_dist_column.empty() ? (size_t)j : (size_t)tree_dist_column[j];
+    }
+    cost_type& tree_dist_at(int i, int j) { return tree_dist_data[tree_dist_row(i) + tree_dist_col(j)]; }
+    size_t tree_dist_cells() const { return mapped_tree_dist ? mapped_tree_dist->size() : tree_dist.size(); }
+    void touchTreeDist(int first_row, int last_row, int first_col, int last_col) {
+        if (mapped_tree_dist) mapped_tree_dist->touch(first_row, last_row, first_col, last_col);
+    }
+    cost_type& forest_dist_at(int di, int dj) { return forest_dist[(size_t)di * forest_dist_cols + dj]; }
+    void prepareTreeDist();
+    void prepareForestDist(int rows, int cols);
+    void reserveForestDist(size_t cells);
+    void reserveForestAux(size_t cells);
+
     // Utility method
     int interval_calc(int li, int i);
 };
 
+// Policies the engine is compiled for; other policies need their own instantiation
+extern template class Basic_Tree_Editing<Unit_Cost<short>>;
+extern template class Basic_Tree_Editing<Unit_Cost<int>>;
+extern template class Basic_Tree_Editing<Unit_Cost<double>>;
+extern template class Basic_Tree_Editing<Per_Node_Cost<short>>;
+extern template class Basic_Tree_Editing<Per_Node_Cost<int>>;
+extern template class Basic_Tree_Editing<Per_Node_Cost<double>>;
+extern template class Basic_Tree_Editing<Per_Node_Cost<double, Rename_Table<double>>>;
+
+typedef Basic_Tree_Editing<> Tree_Editing;
+
 // Utility functions for printing matrices (after Node definition)
-void printTreeEditingMatrix(const vector<vector<int>>& matrix, const vector<Node*>& nodes1, const vector<Node*>& nodes2, const string& title);
+void printTreeEditingMatrix(const vector<int>& matrix, const vector<Node*>& nodes1, const vector<Node*>& nodes2, const string& title, size_t stride = 0);
 
 #endif // TREE_EDITING_H
 void print_tree_editing_keyroots(const vector<Node*>& keyroots, const string& title);
\ No newline at end of file
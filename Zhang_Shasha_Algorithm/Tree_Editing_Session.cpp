@@ -0,0 +1,90 @@
+#include "Tree_Editing_Session.h"
+
+#include <utility>
+
+using namespace std;
+
+/**
+* @brief Starts a session on a copy of an already flattened query.
+* @param query Post-order arrays of the query tree.
+* @param costs Cost policy of every comparison.
+*/
+template <class Cost_Policy>
+Basic_Tree_Editing_Session<Cost_Policy>::Basic_Tree_Editing_Session(const Prepared_Tree& query, const Cost_Policy& costs)
+   : query_tree(query), editor(costs) {
+}
+
+/**
+* @brief Starts a session that takes over the query's arrays.
+* @param query Post-order arrays of the query tree.
+* @param costs Cost policy of every comparison.
+*/
+template <class Cost_Policy>
+Basic_Tree_Editing_Session<Cost_Policy>::Basic_Tree_Editing_Session(Prepared_Tree&& query, const Cost_Policy& costs)
+   : query_tree(move(query)), editor(costs) {
+}
+
+/**
+* @brief Starts a session on a query Tree, flattened once here.
+* @param query Tree whose post-order indices and keyroots are already computed.
+* @param costs Cost policy of every comparison.
+*/
+template <class Cost_Policy>
+Basic_Tree_Editing_Session<Cost_Policy>::Basic_Tree_Editing_Session(const Tree& query, const Cost_Policy& costs)
+   : query_tree(query), editor(costs) {
+}
+
+/**
+* @brief Distance from the query to a prepared candidate, which is read in place.
+* @param candidate Post-order arrays of the candidate; only read during the call.
+*/
+template <class Cost_Policy>
+typename Basic_Tree_Editing_Session<Cost_Policy>::cost_type Basic_Tree_Editing_Session<Cost_Policy>::distance(const Prepared_Tree& candidate) {
+   ++call_count;
+   return editor.treeEditDistance(query_tree, candidate);
+}
+
+/**
+* @brief Distance from the query to a Tree, flattened into the session's scratch.
+* @param candidate Tree whose post-order indices and keyroots are already computed.
+*/
+template <class Cost_Policy>
+typename Basic_Tree_Editing_Session<Cost_Policy>::cost_type Basic_Tree_Editing_Session<Cost_Policy>::distance(const Tree& candidate) {
+   candidate_scratch.assign(candidate);
+   return distance(candidate_scratch);
+}
+
+/**
+* @brief Distance from the query to a tree of a memory-mapped corpus. The DP reads
+* vectors, so the mapped arrays are copied into the session's scratch first; that is
+* linear in the candidate, against the quadratic DP, and allocates only while the scratch grows.
+* @param candidate View returned by Corpus_File::tree.
+*/
+template <class Cost_Policy>
+typename Basic_Tree_Editing_Session<Cost_Policy>::cost_type Basic_Tree_Editing_Session<Cost_Policy>::distance(const Corpus_Tree& candidate) {
+   candidate.copyTo(candidate_scratch);
+   return distance(candidate_scratch);
+}
+
+/**
+* @brief Distances from the query to every candidate.
+* @param candidates Prepared candidate trees.
+* @return One distance per candidate, in the same order.
+*/
+template <class Cost_Policy>
+vector<typename Basic_Tree_Editing_Session<Cost_Policy>::cost_type> Basic_Tree_Editing_Session<Cost_Policy>::distances(const vector<Prepared_Tree>& candidates) {
+   vector<cost_type> result;
+   result.reserve(candidates.size());
+   for (const Prepared_Tree& candidate : candidates) {
+       result.push_back(distance(candidate));
+   }
+   return result;
+}
+
+template class Basic_Tree_Editing_Session<Unit_Cost<short>>;
+template class Basic_Tree_Editing_Session<Unit_Cost<int>>;
+template class Basic_Tree_Editing_Session<Unit_Cost<double>>;
+template class Basic_Tree_Editing_Session<Per_Node_Cost<short>>;
+template class Basic_Tree_Editing_Session<Per_Node_Cost<int>>;
+template class Basic_Tree_Editing_Session<Per_Node_Cost<double>>;
+template class Basic_Tree_Editing_Session<Per_Node_Cost<double, Rename_Table<double>>>;
@@ -0,0 +1,60 @@
+#ifndef TREE_EDITING_SESSION_H
+#define TREE_EDITING_SESSION_H
+
+#include <vector>
+#include "Tree.h"
+#include "Prepared_Tree.h"
+#include "Tree_Editing.h"
+#include "Corpus_File.h"
+
+using namespace std;
+
+// One query tree against many candidates. The query is flattened once when the session is
+// created and the engine is kept between calls, so tree_dist and the forest scratch only
+// grow to the largest candidate seen and are reset, not reallocated, for the next one.
+// Prepared candidates are read where they are, without a copy; Trees and corpus views are
+// flattened into one scratch Prepared_Tree that is reused the same way.
+//
+// Any number of distance() calls may follow each other. The engine can be tuned through
+// engine() (kernel, threads, identical subtree skipping); with Per_Node_Cost the insert
+// costs of each candidate go into engine().costs.insert_costs before its call.
+template <class Cost_Policy = Unit_Cost<int>>
+class Basic_Tree_Editing_Session {
+public:
+    typedef typename Basic_Tree_Editing<Cost_Policy>::cost_type cost_type;
+
+    explicit Basic_Tree_Editing_Session(const Prepared_Tree& query, const Cost_Policy& costs = Cost_Policy());
+    explicit Basic_Tree_Editing_Session(Prepared_Tree&& query, const Cost_Policy& costs = Cost_Policy());
+    // Tree after Tree::post_order and Tree::find_keyroots
+    explicit Basic_Tree_Editing_Session(const Tree& query, const Cost_Policy& costs = Cost_Policy());
+
+    // Distance from the query to one candidate
+    cost_type distance(const Prepared_Tree& candidate);
+    cost_type distance(const Tree& candidate);
+    cost_type distance(const Corpus_Tree& candidate);
+
+    // Distances to every candidate, in order
+    vector<cost_type> distances(const vector<Prepared_Tree>& candidates);
+
+    const Prepared_Tree& query() const { return query_tree; }
+    Basic_Tree_Editing<Cost_Policy>& engine() { return editor; }
+    size_t calls() const { return call_count; }
+
+private:
+    Prepared_Tree query_tree;
+    Prepared_Tree candidate_scratch;  // Flattened Tree or corpus candidate
+    Basic_Tree_Editing<Cost_Policy> editor;
+    size_t call_count = 0;
+};
+
+extern template class Basic_Tree_Editing_Session<Unit_Cost<short>>;
+extern template class Basic_Tree_Editing_Session<Unit_Cost<int>>;
+extern template class Basic_Tree_Editing_Session<Unit_Cost<double>>;
+extern template class Basic_Tree_Editing_Session<Per_Node_Cost<short>>;
+extern template class Basic_Tree_Editing_Session<Per_Node_Cost<int>>;
+extern template class Basic_Tree_Editing_Session<Per_Node_Cost<double>>;
+extern template class Basic_Tree_Editing_Session<Per_Node_Cost<double, Rename_Table<double>>>;
+
+typedef Basic_Tree_Editing_Session<> Tree_Editing_Session;
+
+#endif // TREE_EDITING_SESSION_H
@@ -0,0 +1,325 @@
+#include "Tree_Editing.h"
+#include <algorithm> // For min() and max()
+#include <climits>   // For INT_MAX
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TREE_EDITING_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+// Anti-diagonal forest distance kernels.
+//
+// Cell (di, dj) only depends on cells of the two previous anti-diagonals (and on the
+// forest/tree distances of subtrees, which lie on even earlier ones), so a whole
+// anti-diagonal can be computed at once. Cells are stored diagonal by diagonal so the
+// up/left/diagonal neighbours are contiguous loads, and the second tree's segment is
+// stored reversed so its labels and leftmost leaves are contiguous along a diagonal too.
+// The leftmost-path case and the tree_dist lookup case are both evaluated and blended
+// with a mask; the tree_dist entries of leftmost-path pairs are written after the sweep.
+
+// Inputs of one sweep, laid out in the aux scratch by forestDistanceDiagonal
+struct Diagonal_Pair {
+    int rows;
+    int cols;
+    int* fd;              // Forest cells, diagonal by diagonal
+    const int* base;      // Cell (di, dj) lives at fd[base[di + dj] + di]
+    const int* label1;    // Indexed by di (1..rows)
+    const int* sub1;      // Leftmost leaf of node di, relative to the forest start
+    const int* td_row1;   // Offset of node di's row in tree_dist
+    const int* label2;    // Indexed by r = cols - dj (reversed second segment)
+    const int* sub2;
+    const int* td_col2;
+    const int* td;
+    int remove_cost;
+    int add_cost;
+    int rename_cost;
+};
+
+// One inner cell; used by every kernel for the cells that do not fill a whole vector
+static inline int diagonalCell(const Diagonal_Pair& p, int d, int di) {
+    int r = p.cols - d + di;
+    const int* prev = p.fd + p.base[d-1];
+    int del_cost = prev[di-1] + p.remove_cost;
+    int ins_cost = prev[di] + p.add_cost;
+    int s1 = p.sub1[di];
+    int s2 = p.sub2[r];
+    int sub_cost;
+    if ((s1 | s2) == 0) {
+        sub_cost = p.fd[p.base[d-2] + di - 1] + (p.label1[di] == p.label2[r] ? 0 : p.rename_cost);
+    } else {
+        sub_cost = p.fd[p.base[s1 + s2] + s1] + p.td[p.td_row1[di] + p.td_col2[r]];
+    }
+    return std::min(del_cost, std::min(ins_cost, sub_cost));
+}
+
+static void sweepRange(const Diagonal_Pair& p, int d, int from, int to) {
+    int* out = p.fd + p.base[d];
+    for (int di = from; di <= to; ++di) {
+        out[di] = diagonalCell(p, d, di);
+    }
+}
+
+#ifdef TREE_EDITING_X86_KERNELS
+
+// SSE2 has no gather and no signed 32-bit min, so both are emulated
+__attribute__((target("sse2")))
+static inline __m128i select128(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+__attribute__((target("sse2")))
+static inline __m128i min128(__m128i a, __m128i b) {
+    return select128(_mm_cmpgt_epi32(a, b), b, a);
+}
+
+__attribute__((target("sse2")))
+static void sweepDiagonalsSse2(const Diagonal_Pair& p) {
+    const __m128i del = _mm_set1_epi32(p.remove_cost);
+    const __m128i ins = _mm_set1_epi32(p.add_cost);
+    const __m128i ren = _mm_set1_epi32(p.rename_cost);
+    const __m128i zero = _mm_setzero_si128();
+
+    for (int d = 2; d <= p.rows + p.cols; ++d) {
+        int from = std::max(1, d - p.cols);
+        int to = std::min(p.rows, d - 1);
+        int* out = p.fd + p.base[d];
+        const int* prev = p.fd + p.base[d-1];
+        const int* prev2 = p.fd + p.base[d-2];
+        const int r0 = p.cols - d;
+
+        int di = from;
+        for (; di + 3 <= to; di += 4) {
+            __m128i del_cost = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(prev + di - 1)), del);
+            __m128i ins_cost = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(prev + di)), ins);
+            __m128i diag = _mm_loadu_si128((const __m128i*)(prev2 + di - 1));
+
+            __m128i s1 = _mm_loadu_si128((const __m128i*)(p.sub1 + di));
+            __m128i s2 = _mm_loadu_si128((const __m128i*)(p.sub2 + r0 + di));
+            __m128i on_path = _mm_cmpeq_epi32(_mm_or_si128(s1, s2), zero);
+            __m128i same_label = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(p.label1 + di)),
+                                                 _mm_loadu_si128((const __m128i*)(p.label2 + r0 + di)));
+            __m128i upd_cost = _mm_add_epi32(diag, _mm_andnot_si128(same_label, ren));
+
+            int subtree[4];
+            for (int k = 0; k < 4; ++k) {
+                int a = p.sub1[di + k];
+                int b = p.sub2[r0 + di + k];
+                subtree[k] = p.fd[p.base[a + b] + a] + p.td[p.td_row1[di + k] + p.td_col2[r0 + di + k]];
+            }
+            __m128i sub_cost = _mm_loadu_si128((const __m128i*)subtree);
+
+            __m128i best = min128(del_cost, min128(ins_cost, select128(on_path, upd_cost, sub_cost)));
+            _mm_storeu_si128((__m128i*)(out + di), best);
+        }
+        sweepRange(p, d, di, to);
+    }
+}
+
+__attribute__((target("avx2")))
+static void sweepDiagonalsAvx2(const Diagonal_Pair& p) {
+    const __m256i del = _mm256_set1_epi32(p.remove_cost);
+    const __m256i ins = _mm256_set1_epi32(p.add_cost);
+    const __m256i ren = _mm256_set1_epi32(p.rename_cost);
+    const __m256i zero = _mm256_setzero_si256();
+
+    for (int d = 2; d <= p.rows + p.cols; ++d) {
+        int from = std::max(1, d - p.cols);
+        int to = std::min(p.rows, d - 1);
+        int* out = p.fd + p.base[d];
+        const int* prev = p.fd + p.base[d-1];
+        const int* prev2 = p.fd + p.base[d-2];
+        const int r0 = p.cols - d;
+
+        int di = from;
+        for (; di + 7 <= to; di += 8) {
+            __m256i del_cost = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(prev + di - 1)), del);
+            __m256i ins_cost = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(prev + di)), ins);
+            __m256i diag = _mm256_loadu_si256((const __m256i*)(prev2 + di - 1));
+
+            __m256i s1 = _mm256_loadu_si256((const __m256i*)(p.sub1 + di));
+            __m256i s2 = _mm256_loadu_si256((const __m256i*)(p.sub2 + r0 + di));
+            __m256i on_path = _mm256_cmpeq_epi32(_mm256_or_si256(s1, s2), zero);
+            __m256i same_label = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(p.label1 + di)),
+                                                    _mm256_loadu_si256((const __m256i*)(p.label2 + r0 + di)));
+            __m256i upd_cost = _mm256_add_epi32(diag, _mm256_andnot_si256(same_label, ren));
+
+            // Forest left of both subtrees: cell (s1, s2) on diagonal s1 + s2
+            __m256i sub_base = _mm256_i32gather_epi32(p.base, _mm256_add_epi32(s1, s2), 4);
+            __m256i forest = _mm256_i32gather_epi32(p.fd, _mm256_add_epi32(sub_base, s1), 4);
+            __m256i td_index = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(p.td_row1 + di)),
+                                                _mm256_loadu_si256((const __m256i*)(p.td_col2 + r0 + di)));
+            __m256i subtree = _mm256_i32gather_epi32(p.td, td_index, 4);
+            __m256i sub_cost = _mm256_add_epi32(forest, subtree);
+
+            __m256i best = _mm256_min_epi32(del_cost,
+                               _mm256_min_epi32(ins_cost, _mm256_blendv_epi8(sub_cost, upd_cost, on_path)));
+            _mm256_storeu_si256((__m256i*)(out + di), best);
+        }
+        sweepRange(p, d, di, to);
+    }
+}
+
+#endif // TREE_EDITING_X86_KERNELS
+
+// Size of the per-pair aux arrays used by forestDistanceDiagonal
+template <class Cost_Policy>
+size_t Basic_Tree_Editing<Cost_Policy>::diagonalAuxSize(int rows, int cols) {
+    return 5 * ((size_t)rows + cols) + 8;
+}
+
+// Fastest kernel the running CPU supports. SSE2 sweeps only four cells per step and loses
+// to the row-by-row scalar kernel, so without AVX2 the scalar one is used.
+template <class Cost_Policy>
+Forest_Kernel Basic_Tree_Editing<Cost_Policy>::bestAvailableKernel() {
+#ifdef TREE_EDITING_X86_KERNELS
+    if (__builtin_cpu_supports("avx2")) {
+        return Forest_Kernel::AVX2;
+    }
+#endif
+    return Forest_Kernel::Scalar;
+}
+
+// Whether the running CPU can execute a kernel
+template <class Cost_Policy>
+bool Basic_Tree_Editing<Cost_Policy>::kernelSupported(Forest_Kernel requested) {
+    switch (requested) {
+    case Forest_Kernel::Scalar:
+        return true;
+#ifdef TREE_EDITING_X86_KERNELS
+    case Forest_Kernel::SSE2:
+        return true;
+    case Forest_Kernel::AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+// Selects the forest kernel, falling back when the CPU lacks the requested instruction set
+// or the cost policy has no diagonal kernel
+template <class Cost_Policy>
+void Basic_Tree_Editing<Cost_Policy>::set_kernel(Forest_Kernel requested) {
+    if (!diagonal_kernels) {
+        kernel = Forest_Kernel::Scalar;
+    } else if (requested == Forest_Kernel::Auto || !kernelSupported(requested)) {
+        kernel = bestAvailableKernel();
+    } else {
+        kernel = requested;
+    }
+}
+
+// Forest distance for one keyroot pair swept by anti-diagonals with the selected SIMD kernel.
+// The forest scratch needs the same (rows+1) x (cols+1) cells as the scalar layout.
+template <class Cost_Policy>
+typename Basic_Tree_Editing<Cost_Policy>::cost_type Basic_Tree_Editing<Cost_Policy>::forestDistanceDiagonal(int index1, int index2, cost_type* fd, int* aux) {
+    if constexpr (!diagonal_kernels) {
+        (void)aux;
+        return forestDistanceScalar(index1, index2, fd);
+    } else {
+        const int* lld1 = prepared1->lld.data();
+        const int* lld2 = prepared2->lld.data();
+        int li = lld1[index1];
+        int lj = lld2[index2];
+        int rows = interval_calc(li, index1);
+        int cols = interval_calc(lj, index2);
+
+        // Narrow pairs gain nothing from vectors, and gathers need 32-bit offsets
+        if (std::min(rows, cols) < 8 ||
+            (size_t)(rows + 1) * (cols + 1) > INT_MAX || tree_dist_cells() > INT_MAX) {
+            return forestDistanceScalar(index1, index2, fd);
+        }
+        // Diagonals cross every row of the pair, so its whole rectangle stays resident
+        touchTreeDist(li + 1, index1 + 1, lj + 1, index2 + 1);
+
+        // Aux layout: diagonal bases, first segment arrays, reversed second segment arrays,
+        // and the leftmost-path positions of both segments
+        int* base = aux;
+        int* label1 = base + rows + cols + 1;
+        int* sub1 = label1 + rows + 1;
+        int* td_row1 = sub1 + rows + 1;
+        int* label2 = td_row1 + rows + 1;
+        int* sub2 = label2 + cols;
+        int* td_col2 = sub2 + cols;
+        int* path1 = td_col2 + cols;
+        int* path2 = path1 + rows;
+
+        int offset = 0;
+        for (int d = 0; d <= rows + cols; ++d) {
+            int lo = std::max(0, d - cols);
+            int hi = std::min(rows, d);
+            base[d] = offset - lo;
+            offset += hi - lo + 1;
+        }
+
+        int path1_size = 0, path2_size = 0;
+        for (int di = 1; di <= rows; ++di) {
+            int node = li + di - 1;
+            label1[di] = prepared1->labels[node];
+            sub1[di] = lld1[node] - li;
+            td_row1[di] = (int)tree_dist_row(node + 1);
+            if (sub1[di] == 0) path1[path1_size++] = di;
+        }
+        for (int dj = 1; dj <= cols; ++dj) {
+            int node = lj + dj - 1;
+            int r = cols - dj;
+            label2[r] = prepared2->labels[node];
+            sub2[r] = lld2[node] - lj;
+            td_col2[r] = (int)tree_dist_col(node + 1);
+            if (sub2[r] == 0) path2[path2_size++] = dj;
+        }
+
+        // Boundary cells: deleting the first forest, inserting the second
+        for (int di = 0; di <= rows; ++di) {
+            fd[base[di] + di] = di * costs.remove(li);
+        }
+        for (int dj = 1; dj <= cols; ++dj) {
+            fd[base[dj]] = dj * costs.insert(lj);
+        }
+
+        Diagonal_Pair pair = {rows, cols, fd, base, label1, sub1, td_row1, label2, sub2, td_col2,
+                              tree_dist_data, costs.remove(li), costs.insert(lj), costs.rename(0, 1)};
+        switch (kernel) {
+#ifdef TREE_EDITING_X86_KERNELS
+        case Forest_Kernel::AVX2:
+            sweepDiagonalsAvx2(pair);
+            break;
+        case Forest_Kernel::SSE2:
+            sweepDiagonalsSse2(pair);
+            break;
+#endif
+        default:
+            for (int d = 2; d <= rows + cols; ++d) {
+                sweepRange(pair, d, std::max(1, d - cols), std::min(rows, d - 1));
+            }
+            break;
+        }
+
+        // Subtree pairs on both leftmost paths were solved by this pair; publish them
+        for (int a = 0; a < path1_size; ++a) {
+            int di = path1[a];
+            for (int b = 0; b < path2_size; ++b) {
+                int dj = path2[b];
+                tree_dist_data[td_row1[di] + tree_dist_col(lj + dj)] = fd[base[di + dj] + di];
+            }
+        }
+        return fd[base[rows + cols] + rows];
+    }
+}
+
+// Variadic so policies with several template arguments pass through the commas
+#define INSTANTIATE_DIAGONAL_MEMBERS(...) \
+    template size_t Basic_Tree_Editing<__VA_ARGS__>::diagonalAuxSize(int, int); \
+    template Forest_Kernel Basic_Tree_Editing<__VA_ARGS__>::bestAvailableKernel(); \
+    template bool Basic_Tree_Editing<__VA_ARGS__>::kernelSupported(Forest_Kernel); \
+    template void Basic_Tree_Editing<__VA_ARGS__>::set_kernel(Forest_Kernel); \
+    template Basic_Tree_Editing<__VA_ARGS__>::cost_type \
+        Basic_Tree_Editing<__VA_ARGS__>::forestDistanceDiagonal(int, int, cost_type*, int*);
+
+INSTANTIATE_DIAGONAL_MEMBERS(Unit_Cost<short>)
+INSTANTIATE_DIAGONAL_MEMBERS(Unit_Cost<int>)
+INSTANTIATE_DIAGONAL_MEMBERS(Unit_Cost<double>)
+INSTANTIATE_DIAGONAL_MEMBERS(Per_Node_Cost<short>)
+INSTANTIATE_DIAGONAL_MEMBERS(Per_Node_Cost<int>)
+INSTANTIATE_DIAGONAL_MEMBERS(Per_Node_Cost<double>)
+INSTANTIATE_DIAGONAL_MEMBERS(Per_Node_Cost<double, Rename_Table<double>>)
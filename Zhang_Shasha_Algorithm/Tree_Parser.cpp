@@ -0,0 +1,397 @@
+#include "Tree_Parser.h"
+
+#include <algorithm>
+
+using namespace std;
+
+/**
+* @brief Returns the id of a label, adding it if it is new.
+* @param name Label text; must outlive the dictionary.
+*/
+int Label_Dictionary::intern(string_view name) {
+   if (2 * (names.size() + 1) > slots.size()) {
+       // Grow to keep the table at most half full
+       vector<int> grown(max<size_t>(64, 2 * slots.size()), -1);
+       for (int id : slots) {
+           if (id < 0) continue;
+           size_t k = hashName(names[id]) & (grown.size() - 1);
+           while (grown[k] >= 0) k = (k + 1) & (grown.size() - 1);
+           grown[k] = id;
+       }
+       slots.swap(grown);
+   }
+   size_t k = hashName(name) & (slots.size() - 1);
+   while (slots[k] >= 0) {
+       if (names[slots[k]] == name) {
+           return slots[k];
+       }
+       k = (k + 1) & (slots.size() - 1);
+   }
+   slots[k] = (int)names.size();
+   names.push_back(name);
+   return slots[k];
+}
+
+/**
+* @brief FNV-1a hash of a label; labels are short, so a bytewise hash is cheapest.
+* @param name Label text.
+*/
+size_t Label_Dictionary::hashName(string_view name) {
+   unsigned long long hash = 14695981039346656037ull;
+   for (char c : name) {
+       hash = (hash ^ (unsigned char)c) * 1099511628211ull;
+   }
+   return (size_t)(hash ^ (hash >> 29));
+}
+
+/**
+* @brief Forgets every label.
+*/
+void Label_Dictionary::clear() {
+   slots.clear();
+   names.clear();
+}
+
+static bool isSpace(char c) {
+   return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/**
+* @brief Maps a file and makes it the input of next(). Files opened before stay mapped, since
+* the dictionary may point into them.
+* @param path File to parse.
+* @param format Notation of the trees in the file.
+* @return False if the file could not be opened.
+*/
+bool Tree_Parser::open(const string& path, Tree_Format format) {
+   unique_ptr<Mapped_File> file(new Mapped_File());
+   if (!file->open(path)) {
+       return false;
+   }
+   openBuffer(file->data(), file->size(), format);
+   files.push_back(move(file));
+   return true;
+}
+
+/**
+* @brief Makes a caller-owned buffer the input of next().
+* @param data First byte of the input.
+* @param size Input length in bytes.
+* @param input_format Notation of the trees in the buffer.
+*/
+void Tree_Parser::openBuffer(const char* data, size_t size, Tree_Format input_format) {
+   begin = cursor = data;
+   end = data + size;
+   format = input_format;
+   last_error.clear();
+}
+
+/**
+* @brief Parses the next tree of the input.
+* @param out Tree to fill; its previous contents are replaced.
+* @return True if a tree was read; false at the end of the input or on an error (see error()).
+*/
+bool Tree_Parser::next(Prepared_Tree& out) {
+   last_error.clear();
+   out.labels.clear();
+   out.lld.clear();
+   out.parent.clear();
+   out.hashes.clear();
+   out.keyroots.clear();
+   out.keyroot_parent.clear();
+   open_nodes.clear();
+   child_stack.clear();
+   if (cursor == nullptr) {
+       return false;
+   }
+
+   tree = &out;
+   bool found = false;
+   switch (format) {
+       case Tree_Format::Bracket: found = nextBracket(); break;
+       case Tree_Format::XML: found = nextXML(); break;
+       case Tree_Format::JSON: found = nextJSON(); break;
+   }
+   tree = nullptr;
+   if (found) {
+       out.linkKeyroots();
+   }
+   return found;
+}
+
+/**
+* @brief Opens a node as the next child of the innermost open node.
+* @param label Label text.
+* @param kind Format-specific tag kept with the open node.
+*/
+void Tree_Parser::openNode(string_view label, char kind) {
+   Open_Node node;
+   node.label = labels.intern(label);
+   node.first = (int)tree->labels.size();
+   node.children = child_stack.size();
+   node.hash = labelHash(node.label);
+   node.kind = kind;
+   node.has_child = false;
+   open_nodes.push_back(node);
+}
+
+/**
+* @brief Closes the innermost open node: gives it the next post-order index, links its
+* children to it and folds it into its parent.
+*/
+void Tree_Parser::closeNode() {
+   const Open_Node node = open_nodes.back();
+   open_nodes.pop_back();
+   const int index = (int)tree->labels.size();
+   tree->labels.push_back(node.label);
+   tree->lld.push_back(node.first);
+   tree->hashes.push_back(node.hash);
+   tree->parent.push_back(-1);
+   for (size_t k = node.children; k < child_stack.size(); ++k) {
+       tree->parent[child_stack[k]] = index;
+   }
+   child_stack.resize(node.children);
+
+   if (open_nodes.empty()) {
+       tree->keyroots.push_back(index);  // The root
+       return;
+   }
+   Open_Node& up = open_nodes.back();
+   if (up.has_child) {
+       tree->keyroots.push_back(index);  // Has a left sibling
+   }
+   up.has_child = true;
+   up.hash = combineSubtreeHash(up.hash, node.hash);
+   child_stack.push_back(index);
+}
+
+/**
+* @brief Records a parse error at the current position.
+* @param message What was wrong.
+* @return False, for returning straight from the parse loop.
+*/
+bool Tree_Parser::fail(const string& message) {
+   last_error = message + " at byte " + to_string(position());
+   cursor = end;
+   return false;
+}
+
+void Tree_Parser::skipSpace() {
+   while (cursor < end && isSpace(*cursor)) ++cursor;
+}
+
+/**
+* @brief Reads one {label{child}...} tree.
+*/
+bool Tree_Parser::nextBracket() {
+   skipSpace();
+   if (cursor == end) {
+       return false;
+   }
+   if (*cursor != '{') {
+       return fail("Expected '{'");
+   }
+   while (cursor < end) {
+       const char c = *cursor;
+       if (c == '{') {
+           const char* label = ++cursor;
+           while (cursor < end && *cursor != '{' && *cursor != '}') {
+               cursor += *cursor == '\\' ? 2 : 1;
+           }
+           cursor = min(cursor, end);
+           const char* label_end = cursor;
+           while (label_end > label && isSpace(label_end[-1])) --label_end;
+           openNode(string_view(label, label_end - label));
+       } else if (c == '}') {
+           ++cursor;
+           closeNode();
+           if (open_nodes.empty()) {
+               return true;
+           }
+       } else if (isSpace(c)) {
+           ++cursor;
+       } else {
+           return fail("Expected '{' or '}'");
+       }
+   }
+   return fail("Unexpected end of input inside a tree");
+}
+
+/**
+* @brief Reads one top-level XML element.
+*/
+bool Tree_Parser::nextXML() {
+   auto skipPast = [&](string_view terminator) {
+       size_t found = string_view(cursor, end - cursor).find(terminator);
+       cursor = found == string_view::npos ? end : cursor + found + terminator.size();
+       return found != string_view::npos;
+   };
+   auto startsWith = [&](string_view prefix) {
+       return (size_t)(end - cursor) >= prefix.size() && string_view(cursor, prefix.size()) == prefix;
+   };
+
+   while (cursor < end) {
+       if (*cursor != '<') {
+           // Text; only non-blank text inside an element becomes a node
+           const char* text = cursor;
+           cursor = find(cursor, end, '<');
+           const char* text_end = cursor;
+           while (text < text_end && isSpace(*text)) ++text;
+           while (text_end > text && isSpace(text_end[-1])) --text_end;
+           if (text < text_end && !open_nodes.empty()) {
+               openNode(string_view(text, text_end - text));
+               closeNode();
+           }
+           continue;
+       }
+
+       if (startsWith("<?")) {
+           if (!skipPast("?>")) return fail("Unterminated processing instruction");
+       } else if (startsWith("<!--")) {
+           if (!skipPast("-->")) return fail("Unterminated comment");
+       } else if (startsWith("<![CDATA[")) {
+           cursor += 9;
+           const char* text = cursor;
+           if (!skipPast("]]>")) return fail("Unterminated CDATA section");
+           if (!open_nodes.empty() && cursor - 3 > text) {
+               openNode(string_view(text, cursor - 3 - text));
+               closeNode();
+           }
+       } else if (startsWith("<!")) {
+           // DOCTYPE and other declarations, with a bracketed internal subset
+           int depth = 0;
+           for (; cursor < end; ++cursor) {
+               if (*cursor == '[') ++depth;
+               else if (*cursor == ']') --depth;
+               else if (*cursor == '>' && depth <= 0) break;
+           }
+           if (cursor == end) return fail("Unterminated declaration");
+           ++cursor;
+       } else if (startsWith("</")) {
+           const char* tag = cursor;
+           cursor += 2;
+           const char* name = cursor;
+           while (cursor < end && *cursor != '>' && !isSpace(*cursor)) ++cursor;
+           string_view closing(name, cursor - name);
+           if (!skipPast(">")) return fail("Unterminated closing tag");
+           if (open_nodes.empty() || labels.name(open_nodes.back().label) != closing) {
+               cursor = tag;
+               return fail("Unexpected closing tag </" + string(closing) + ">");
+           }
+           closeNode();
+           if (open_nodes.empty()) {
+               return true;
+           }
+       } else {
+           ++cursor;
+           const char* name = cursor;
+           while (cursor < end && *cursor != '>' && *cursor != '/' && !isSpace(*cursor)) ++cursor;
+           if (cursor == name) return fail("Expected a tag name");
+           openNode(string_view(name, cursor - name));
+           // Attributes are skipped; quoted values may hold '>' and '/'
+           bool self_closing = false;
+           while (cursor < end && *cursor != '>') {
+               if (*cursor == '"' || *cursor == '\'') {
+                   cursor = find(cursor + 1, end, *cursor);
+                   if (cursor == end) break;
+               } else if (*cursor == '/') {
+                   self_closing = true;
+               } else if (!isSpace(*cursor)) {
+                   self_closing = false;
+               }
+               ++cursor;
+           }
+           if (cursor == end) return fail("Unterminated tag");
+           ++cursor;
+           if (self_closing) {
+               closeNode();
+               if (open_nodes.empty()) {
+                   return true;
+               }
+           }
+       }
+   }
+   if (!open_nodes.empty()) {
+       return fail("Unexpected end of input inside an element");
+   }
+   return false;
+}
+
+/**
+* @brief Reads one top-level JSON value.
+*/
+bool Tree_Parser::nextJSON() {
+   const char OBJECT = 'o', ARRAY = 'a', MEMBER = 'm';
+   // String contents (cursor on the opening quote), escapes left as they are
+   auto readString = [&](string_view& text) {
+       const char* start = ++cursor;
+       while (cursor < end && *cursor != '"') {
+           cursor += *cursor == '\\' ? 2 : 1;
+       }
+       if (cursor >= end) {
+           cursor = end;
+           return false;
+       }
+       text = string_view(start, cursor - start);
+       ++cursor;
+       return true;
+   };
+   // A value was completed: it ends its member, and maybe the tree
+   auto valueDone = [&]() {
+       if (!open_nodes.empty() && open_nodes.back().kind == MEMBER) {
+           closeNode();
+       }
+       return open_nodes.empty();
+   };
+
+   while (true) {
+       skipSpace();
+       if (cursor == end) {
+           if (!open_nodes.empty()) return fail("Unexpected end of input inside a value");
+           return false;
+       }
+       const char c = *cursor;
+       const char container = open_nodes.empty() ? 0 : open_nodes.back().kind;
+       if (c == ',') {
+           if (container != OBJECT && container != ARRAY) return fail("Unexpected ','");
+           ++cursor;
+           continue;
+       }
+       if (c == '}' || c == ']') {
+           if (container != (c == '}' ? OBJECT : ARRAY)) return fail(string("Unexpected '") + c + "'");
+           ++cursor;
+           closeNode();
+           if (valueDone()) return true;
+           continue;
+       }
+       if (container == OBJECT) {
+           string_view key;
+           if (c != '"' || !readString(key)) return fail("Expected a member name");
+           openNode(key, MEMBER);
+           skipSpace();
+           if (cursor == end || *cursor != ':') return fail("Expected ':'");
+           ++cursor;
+           continue;
+       }
+
+       if (c == '{') {
+           ++cursor;
+           openNode("{}", OBJECT);
+       } else if (c == '[') {
+           ++cursor;
+           openNode("[]", ARRAY);
+       } else {
+           string_view scalar;
+           if (c == '"') {
+               if (!readString(scalar)) return fail("Unterminated string");
+           } else {
+               const char* start = cursor;
+               while (cursor < end && *cursor != ',' && *cursor != '}' && *cursor != ']' && !isSpace(*cursor)) ++cursor;
+               scalar = string_view(start, cursor - start);
+           }
+           openNode(scalar);
+           closeNode();
+           if (valueDone()) return true;
+       }
+   }
+}
@@ -0,0 +1,98 @@
+#ifndef TREE_PARSER_H
+#define TREE_PARSER_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Prepared_Tree.h"
+#include "Mapped_File.h"
+
+using namespace std;
+
+// Interned labels: every distinct label text gets the next int id, the label value the
+// engines compare. Names are views into the parsed input, so they stay valid only while
+// the parser that produced them keeps its files open. Lookups probe an open-addressing
+// table of ids, since interning runs once per parsed node.
+class Label_Dictionary {
+public:
+    int intern(string_view name);
+    string_view name(int id) const { return names[id]; }
+    int size() const { return (int)names.size(); }
+    void clear();
+
+private:
+    vector<int> slots;  // Power-of-two table of ids, -1 for empty slots
+    vector<string_view> names;
+
+    static size_t hashName(string_view name);
+};
+
+enum class Tree_Format { Bracket, XML, JSON };
+
+// Streaming parser that builds Prepared_Trees straight from text, without Node objects.
+// Each tree is built in one pass: a node gets its post-order index when it closes, and by
+// then its leftmost leaf (the number of nodes closed when it opened), its hash (folded in
+// as its children close) and whether it is a keyroot (it is unless it was its parent's
+// first child) are all known. A file holds any number of trees one after another:
+//   Bracket  {a{b}{c}}, one tree per outer pair of braces; \ escapes a brace in a label
+//   XML      one tree per top-level element; elements are labelled by their tag name and
+//            non-blank text or CDATA becomes a leaf; attributes, comments, processing
+//            instructions and DOCTYPE are skipped
+//   JSON     one tree per top-level value; an object is a "{}" node with one node per
+//            member labelled by its key, over the member's value; an array is a "[]" node
+//            over its elements; scalars are leaves labelled by their text (strings
+//            without quotes)
+// Labels are the raw text of the input (escapes are not decoded) and are interned in
+// `labels`, which every file opened by the same parser shares, so trees from different
+// files and formats can be compared with each other.
+class Tree_Parser {
+public:
+    Label_Dictionary labels;
+
+    // Maps a file and starts reading trees from it; earlier files stay mapped
+    bool open(const string& path, Tree_Format format);
+    // Reads trees from a caller-owned buffer, which must outlive the labels
+    void openBuffer(const char* data, size_t size, Tree_Format format);
+
+    // Parses the next tree into `tree`, reusing its capacity. Returns false at the end of
+    // the input, or on malformed input with error() set
+    bool next(Prepared_Tree& tree);
+    const string& error() const { return last_error; }
+
+    // Bytes of input consumed so far in the current file
+    size_t position() const { return (size_t)(cursor - begin); }
+
+private:
+    // Node still open in the tree being built
+    struct Open_Node {
+        int label;
+        int first;                 // Leftmost leaf: nodes closed before this one opened
+        size_t children;           // Start of its closed children in child_stack
+        unsigned long long hash;
+        char kind;                 // Format-specific container kind
+        bool has_child;
+    };
+
+    vector<unique_ptr<Mapped_File>> files;
+    const char* begin = nullptr;
+    const char* cursor = nullptr;
+    const char* end = nullptr;
+    Tree_Format format = Tree_Format::Bracket;
+    string last_error;
+
+    Prepared_Tree* tree = nullptr;
+    vector<Open_Node> open_nodes;
+    vector<int> child_stack;
+
+    void openNode(string_view label, char kind = 0);
+    void closeNode();
+    bool fail(const string& message);
+    void skipSpace();
+
+    bool nextBracket();
+    bool nextXML();
+    bool nextJSON();
+};
+
+#endif // TREE_PARSER_H
@@ -5,14 +5,30 @@
 #include <algorithm>
 #include <fstream>
 #include <chrono>
+#include <cstdio>
+#include <cmath>
+#include <map>
+#include <tuple>
 #include "Tree.h"
 #include "Tree_Editing.h"
+#include "Path_Tree_Editing.h"
+#include "Demaine_Tree_Editing.h"
+#include "Similarity_Join.h"
+#include "Distance_Matrix.h"
+#include "Metric_Index.h"
+#include "Tree_Parser.h"
+#include "Node_Arena.h"
+#include "Memory_Usage.h"
+#include "Corpus_File.h"
+#include "Tree_Editing_Session.h"
+#include <thread>
 #include <unordered_set>
 
 using namespace std;
 
-// Print distance matrix in readable format
-void printMatrix(const vector<vector<int>>& matrix, const vector<Node*>& nodes1, const vector<Node*>& nodes2, const string& title) {
+// Print distance matrix in readable format; `stride` is the row stride when it exceeds |T2| + 1
+void printMatrix(const vector<int>& matrix, const vector<Node*>& nodes1, const vector<Node*>& nodes2, const string& title, size_t stride = 0) {
+    const size_t cols = stride ? stride : nodes2.size() + 1; // Row stride of the flat matrix
     cout << "\n" << title << ":\n";
     cout << setw(8) << " ";
     cout << setw(10) << "∅";
@@ -23,13 +39,13 @@ void printMatrix(const vector<vector<int>>& matrix, const vector<Node*>& nodes1,
     cout << string(8 * (nodes2.size() + 2), '-') << endl;
     cout << setw(10) << "∅";
     for (size_t j = 0; j <= nodes2.size(); ++j) {
-        cout << setw(8) << matrix[0][j];
+        cout << setw(8) << matrix[j];
     }
     cout << endl;
     for (size_t i = 0; i < nodes1.size(); ++i) {
         cout << setw(8) << nodes1[i]->label;
         for (size_t j = 0; j <= nodes2.size(); ++j) {
-            cout << setw(8) << matrix[i+1][j];
+            cout << setw(8) << matrix[(i+1) * cols + j];
         }
         cout << endl;
     }
@@ -110,13 +126,24 @@ Tree createTestTree2(vector<Node*>& nodes) {
 }
 
 
-// Utility function to create a new Node*
-Node* createNode(const char& label) {
-    return new Node(label, -1, -1);
+// Utility function to create a new Node*, in the arena if one is given (freed with it)
+// and on the heap otherwise
+Node* createNode(const char& label, Node_Arena* arena = nullptr) {
+    return arena ? arena->create(label) : new Node(label, -1, -1);
+}
+
+// Index a tree built or edited by hand: post-order, Li values, hashes and keyroots
+Tree indexTree(Node* root) {
+    Tree tree(root);
+    int counter = 0;
+    tree.post_order(root, counter);
+    int last_li = -1;
+    tree.find_keyroots(root, last_li);
+    return tree;
 }
 
 // Create random tree with numNodes nodes and given seed
-Tree createRandomTree(int numNodes, int seed, bool debug) {
+Tree createRandomTree(int numNodes, int seed, bool debug, Node_Arena* arena = nullptr) {
     if (numNodes <= 0) {
         cerr << "Number of nodes must be greater than zero." << endl;
         return Tree(nullptr); // Return empty tree
@@ -125,12 +152,12 @@ Tree createRandomTree(int numNodes, int seed, bool debug) {
     srand(seed);
     vector<Node*> availableNodes;
     // Create root node
-    Node* root = createNode(nodeChar);
+    Node* root = createNode(nodeChar, arena);
     nodeChar++;
     availableNodes.push_back(root);
     // Add remaining nodes
     for (int i = 1; i < numNodes; ++i) {
-        Node* newNode = createNode(nodeChar);
+        Node* newNode = createNode(nodeChar, arena);
         nodeChar = nodeChar < 'z' ? nodeChar + 1 : 'a'; // Cycle from 'z' to 'a'
         // Choose random parent
         Node* parent = availableNodes[rand() % availableNodes.size()];
@@ -159,22 +186,52 @@ Tree createRandomTree(int numNodes, int seed, bool debug) {
     return tree;
 }
 
+// Create the random tree of (numNodes, seed) with `relabels` random nodes relabeled
+Tree createRelabeledTree(int numNodes, int seed, int relabels, int editSeed, Node_Arena* arena = nullptr) {
+    Tree tree = createRandomTree(numNodes, seed, false, arena);
+    vector<Node*> nodes = tree.get_indices();
+    srand(editSeed);
+    for (int edit = 0; edit < relabels && !nodes.empty(); ++edit) {
+        nodes[rand() % nodes.size()]->label = 'a' + rand() % 26;
+    }
+    return tree;
+}
+
+// Copy of the subtree under `node`; the motif trees it copies are shallow, so plain recursion is fine
+Node* copySubtree(const Node* node, Node_Arena* arena) {
+    Node* copy = createNode(node->label, arena);
+    for (const Node* child : node->children) {
+        copy->add_child(copySubtree(child, arena));
+    }
+    return copy;
+}
+
+// A document of `records` children under one root, each a copy of one of the motif roots
+Tree createMotifDocument(const vector<Node*>& motifs, int records, int seed, Node_Arena* arena = nullptr) {
+    srand(seed);
+    Node* root = createNode('r', arena);
+    for (int record = 0; record < records; ++record) {
+        root->add_child(copySubtree(motifs[rand() % motifs.size()], arena));
+    }
+    return indexTree(root);
+}
+
 // Create worst-case tree structure (linear chain - maximizes keyroots and computation)
-Tree createWorstCaseTree(int numNodes, bool leftChain = true, bool debug = false) {
+Tree createWorstCaseTree(int numNodes, bool leftChain = true, bool debug = false, Node_Arena* arena = nullptr) {
     if (numNodes <= 0) {
         cerr << "Number of nodes must be greater than zero." << endl;
         return Tree(nullptr);
     }
     
     char nodeChar = 'a';
-    Node* root = createNode(nodeChar);
+    Node* root = createNode(nodeChar, arena);
     nodeChar++;
     
     Node* current = root;
     
     // Create a linear chain structure (worst case for Zhang-Shasha)
     for (int i = 1; i < numNodes; ++i) {
-        Node* newNode = createNode(nodeChar);
+        Node* newNode = createNode(nodeChar, arena);
         nodeChar = nodeChar < 'z' ? nodeChar + 1 : 'a';
         
         if (leftChain) {
@@ -211,7 +268,7 @@ Tree createWorstCaseTree(int numNodes, bool leftChain = true, bool debug = false
 }
 
 // Create balanced tree (best case scenario)
-Tree createBestCaseTree(int numNodes, bool debug = false) {
+Tree createBestCaseTree(int numNodes, bool debug = false, Node_Arena* arena = nullptr) {
     if (numNodes <= 0) {
         cerr << "Number of nodes must be greater than zero." << endl;
         return Tree(nullptr);
@@ -219,7 +276,7 @@ Tree createBestCaseTree(int numNodes, bool debug = false) {
     
     char nodeChar = 'a';
     vector<Node*> currentLevel;
-    Node* root = createNode(nodeChar);
+    Node* root = createNode(nodeChar, arena);
     nodeChar++;
     currentLevel.push_back(root);
     
@@ -231,14 +288,14 @@ Tree createBestCaseTree(int numNodes, bool debug = false) {
         for (Node* parent : currentLevel) {
             // Create two children for each parent if possible
             if (nodesCreated < numNodes) {
-                Node* leftChild = createNode(nodeChar);
+                Node* leftChild = createNode(nodeChar, arena);
                 nodeChar = nodeChar < 'z' ? nodeChar + 1 : 'a';
                 parent->add_child(leftChild);
                 nextLevel.push_back(leftChild);
                 nodesCreated++;
             }
             if (nodesCreated < numNodes) {
-                Node* rightChild = createNode(nodeChar);
+                Node* rightChild = createNode(nodeChar, arena);
                 nodeChar = nodeChar < 'z' ? nodeChar + 1 : 'a';
                 parent->add_child(rightChild);
                 nextLevel.push_back(rightChild);
@@ -306,15 +363,15 @@ public:
         cout << "Forest 2 size: " << cols << endl;
         
         // Ensure matrices have correct size
-        forest_dist.resize(rows + 1, vector<int>(cols + 1, 0));
+        prepareForestDist(rows, cols);
         
         // Initialize forest_dist matrix
-        forest_dist[0][0] = 0;
+        forest_dist_at(0, 0) = 0;
         for (int di = 1; di <= rows; di++) {
-            forest_dist[di][0] = forest_dist[di-1][0] + remove_cost;
+            forest_dist_at(di, 0) = forest_dist_at(di-1, 0) + costs.remove(li + di - 1);
         }
         for (int dj = 1; dj <= cols; dj++) {
-            forest_dist[0][dj] = forest_dist[0][dj-1] + add_cost;
+            forest_dist_at(0, dj) = forest_dist_at(0, dj-1) + costs.insert(lj + dj - 1);
         }        // Extract relevant nodes for this subtree
         vector<Node*> subnodes1;
         vector<Node*> subnodes2;
@@ -342,35 +399,35 @@ public:
                 Node* nj = get_node2(node_j_idx);
                 if (ni->li == li && nj->li == lj) {
                     // Both are left-most leaves
-                    int update_cost = (ni->label == nj->label) ? 0 : rename_cost;
-                    int del_cost = forest_dist[di-1][dj] + remove_cost;      // Deletion
-                    int ins_cost = forest_dist[di][dj-1] + add_cost;         // Insertion
-                    int upd_cost = forest_dist[di-1][dj-1] + update_cost;    // Substitution
+                    int update_cost = costs.rename(ni->label, nj->label);
+                    int del_cost = forest_dist_at(di-1, dj) + costs.remove(node_i_idx);      // Deletion
+                    int ins_cost = forest_dist_at(di, dj-1) + costs.insert(node_j_idx);      // Insertion
+                    int upd_cost = forest_dist_at(di-1, dj-1) + update_cost;    // Substitution
                     
                     // Use min for each pair
-                    forest_dist[di][dj] = std::min(del_cost, std::min(ins_cost, upd_cost));
+                    forest_dist_at(di, dj) = std::min(del_cost, std::min(ins_cost, upd_cost));
                     
-                    tree_dist[ni->walking_index+1][nj->walking_index+1] = forest_dist[di][dj]; //index +1 to skip index 0, corresponding to empty                    
+                    tree_dist_at(ni->walking_index+1, nj->walking_index+1) = forest_dist_at(di, dj); //index +1 to skip index 0, corresponding to empty                    
                     cout << "Nodes " << ni->label << " and " << nj->label << " are left-most leaves." << endl;
                     cout << "Update cost: " << update_cost << endl;
                     cout << "Costs: del=" << del_cost << ", ins=" << ins_cost << ", upd=" << upd_cost << endl;
                 } else {
                     // At least one is not left-most leaf
-                    int del_cost = forest_dist[di-1][dj] + remove_cost;      // Deletion
-                    int ins_cost = forest_dist[di][dj-1] + add_cost;         // Insertion
-                    int sub_cost = forest_dist[ni->li - li][nj->li - lj] + 
-                                   tree_dist[ni->walking_index+1][nj->walking_index+1];  // Subtree operation, 
+                    int del_cost = forest_dist_at(di-1, dj) + costs.remove(node_i_idx);      // Deletion
+                    int ins_cost = forest_dist_at(di, dj-1) + costs.insert(node_j_idx);      // Insertion
+                    int sub_cost = forest_dist_at(ni->li - li, nj->li - lj) + 
+                                   tree_dist_at(ni->walking_index+1, nj->walking_index+1);  // Subtree operation, 
                                                                                          //index +1 to skip index 0, corresponding to empty
                     
                     // Use min for each pair
-                    forest_dist[di][dj] = std::min(del_cost, std::min(ins_cost, sub_cost));
+                    forest_dist_at(di, dj) = std::min(del_cost, std::min(ins_cost, sub_cost));
                     
                     cout << "Nodes " << ni->label << " and " << nj->label << " are not both left-most leaves." << endl;
                     cout << "Using tree_dist[" << ni->walking_index << "][" << nj->walking_index 
-                         << "] = " << tree_dist[ni->walking_index][nj->walking_index] << endl;
+                         << "] = " << tree_dist_at(ni->walking_index, nj->walking_index) << endl;
                 }
                 
-                cout << "forest_dist[" << di << "][" << dj << "] = " << forest_dist[di][dj] << endl;
+                cout << "forest_dist[" << di << "][" << dj << "] = " << forest_dist_at(di, dj) << endl;
             }
         }
         
@@ -378,12 +435,16 @@ public:
         printMatrix(forest_dist, subnodes1, subnodes2, "Forest Distance (Final)");
         
         // Return distance for complete forest
-        return forest_dist[rows][cols];
+        return forest_dist_at(rows, cols);
     }
       int treeEditDistance(Tree T1, Tree T2) {
         // Update node vectors with those from received trees
         nodes1 = T1.get_indices();
         nodes2 = T2.get_indices();
+        owned1.assign(T1);
+        owned2.assign(T2);
+        prepared1 = &owned1;
+        prepared2 = &owned2;
         
         // Get keyroots of trees and reverse them correctly
         vector<Node*> keyroots1 = T1.get_LR_keyroots();
@@ -398,7 +459,7 @@ public:
         printKeyroots(keyroots2, "\nTree 2 Keyroots:");
 
         // Prepare matrix for tree distance
-        tree_dist.resize(nodes1.size() + 1, vector<int>(nodes2.size() + 1, 0));
+        prepareTreeDist();
 
         // For each pair of keyroots, calculate distance between subtrees
         for (Node* n1 : keyroots1) {
@@ -420,51 +481,108 @@ public:
 
         // Print final tree_dist matrix
         cout << "\nFinal tree distance matrix:" << endl;
-        printMatrix(tree_dist, nodes1, nodes2, "Tree Distance");
+        printMatrix(tree_dist, nodes1, nodes2, "Tree Distance", tree_dist_cols);
 
         // Return distance between complete trees
-        return tree_dist[nodes1.back()->walking_index][nodes2.back()->walking_index];
+        return tree_dist_at(nodes1.back()->walking_index, nodes2.back()->walking_index);
     }
 };
 
+// Edit distance engines the benchmark drivers can run on the same trees
+enum class TED_Engine { ZhangShasha, PathDecomposition, Demaine };
+
+const char* engineName(TED_Engine engine) {
+    switch (engine) {
+    case TED_Engine::PathDecomposition:
+        return "PathDecomposition";
+    case TED_Engine::Demaine:
+        return "Demaine";
+    default:
+        return "ZhangShasha";
+    }
+}
+
+// Runs one engine on a tree pair; `memory` gets what the engine allocated, sampled before
+// its workspace is freed. Zhang-Shasha also reports its keyroot loop allocations
+int runEngine(TED_Engine engine, Tree& tree1, Tree& tree2, Heap_Sample& memory, size_t* loopAllocations = nullptr) {
+    Heap_Scope scope;
+    switch (engine) {
+    case TED_Engine::PathDecomposition: {
+        Path_Tree_Editing ted(&tree1, &tree2);
+        int distance = ted.treeEditDistance(tree1, tree2);
+        memory = scope.sample();
+        return distance;
+    }
+    case TED_Engine::Demaine: {
+        Demaine_Tree_Editing ted(&tree1, &tree2);
+        int distance = ted.treeEditDistance(tree1, tree2);
+        memory = scope.sample();
+        return distance;
+    }
+    default: {
+        Tree_Editing ted(&tree1, &tree2);
+        int distance = ted.treeEditDistance(tree1, tree2);
+        memory = scope.sample();
+        if (loopAllocations != nullptr) {
+            *loopAllocations = ted.keyroot_loop_allocations;
+        }
+        return distance;
+    }
+    }
+}
+
 // Performance result structure
 struct PerformanceResult {
+    string engine;
     int tree1Size;
     int tree1RootKeys;
     int tree2Size;
     int tree2RootKeys;
     double executionTimeMs;
     int distance;
-    double memoryKB; // Adicionado para armazenar o uso médio de memória
+    double peakHeapKB;   // Most heap the engine held at once, counted by Memory_Usage
+    double liveHeapKB;   // Heap the engine still held when it returned the distance
+    size_t allocations;  // Heap allocations made by the engine
+    size_t keyrootLoopAllocations = 0;  // Workspace allocations inside the Zhang-Shasha keyroot loop
+    long peakRssKB;      // Process peak RSS during the run (trees included)
 };
 
+// Fills the memory fields of a result from the engine's heap sample and the process peak RSS
+void recordMemory(PerformanceResult& result, const Heap_Sample& memory) {
+    result.peakHeapKB = memory.peak_bytes / 1024.0;
+    result.liveHeapKB = memory.live_bytes / 1024.0;
+    result.allocations = memory.allocations;
+    result.peakRssKB = peakRssKb();
+}
+
 /**
  * @brief Run worst-case performance test
  */
 PerformanceResult runBestCaseTest(int size, bool debug = false) {
-    Tree tree1 = createWorstCaseTree(size, true, debug);   // Left chain
-    Tree tree2 = createWorstCaseTree(size, false, debug);  // Right chain
-
-    // Cálculo estimado de memória (duas tabelas |T1| x |T2| de int)
-    size_t mem_bytes = 2ULL * tree1.get_indices().size() * tree2.get_indices().size() * sizeof(int);
-    double mem_kb = mem_bytes / (1024.0 * 1024.0);
+    Node_Arena arena;
+    Tree tree1 = createWorstCaseTree(size, true, debug, &arena);   // Left chain
+    Tree tree2 = createWorstCaseTree(size, false, debug, &arena);  // Right chain
 
+    resetPeakRss();
+    Heap_Sample memory;
     auto start = std::chrono::high_resolution_clock::now();
 
-    Tree_Editing ted(&tree1, &tree2);
-    int distance = ted.treeEditDistance(tree1, tree2);
+    size_t loopAllocations = 0;
+    int distance = runEngine(TED_Engine::ZhangShasha, tree1, tree2, memory, &loopAllocations);
 
     auto end = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
 
     PerformanceResult result;
+    result.engine = engineName(TED_Engine::ZhangShasha);
     result.tree1Size = size;
     result.tree1RootKeys = tree1.get_LR_keyroots().size();
     result.tree2Size = size;
     result.tree2RootKeys = tree2.get_LR_keyroots().size();
     result.executionTimeMs = duration.count() / 1000.0;
     result.distance = distance;
-    result.memoryKB = mem_kb; // Salva o valor estimado de memória
+    result.keyrootLoopAllocations = loopAllocations;
+    recordMemory(result, memory);
 
     return result;
 }
@@ -473,29 +591,30 @@ PerformanceResult runBestCaseTest(int size, bool debug = false) {
  * @brief Run best-case performance test
  */
 PerformanceResult runWorstCaseTest(int size, bool debug = false) {
-    Tree tree1 = createBestCaseTree(size, debug);
-    Tree tree2 = createBestCaseTree(size, debug);
-
-    // Cálculo estimado de memória (duas tabelas |T1| x |T2| de int)
-    size_t mem_bytes = 2ULL * tree1.get_indices().size() * tree2.get_indices().size() * sizeof(int);
-    double mem_kb = mem_bytes / (1024.0 * 1024.0);
+    Node_Arena arena;
+    Tree tree1 = createBestCaseTree(size, debug, &arena);
+    Tree tree2 = createBestCaseTree(size, debug, &arena);
 
+    resetPeakRss();
+    Heap_Sample memory;
     auto start = std::chrono::high_resolution_clock::now();
 
-    Tree_Editing ted(&tree1, &tree2);
-    int distance = ted.treeEditDistance(tree1, tree2);
+    size_t loopAllocations = 0;
+    int distance = runEngine(TED_Engine::ZhangShasha, tree1, tree2, memory, &loopAllocations);
 
     auto end = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
 
     PerformanceResult result;
+    result.engine = engineName(TED_Engine::ZhangShasha);
     result.tree1Size = size;
     result.tree1RootKeys = tree1.get_LR_keyroots().size();
     result.tree2Size = size;
     result.tree2RootKeys = tree2.get_LR_keyroots().size();
     result.executionTimeMs = duration.count() / 1000.0;
     result.distance = distance;
-    result.memoryKB = mem_kb; // Salva o valor estimado de memória
+    result.keyrootLoopAllocations = loopAllocations;
+    recordMemory(result, memory);
 
     return result;
 }
@@ -503,31 +622,30 @@ PerformanceResult runWorstCaseTest(int size, bool debug = false) {
 /**
  * @brief Run performance test for a pair of trees
  */
-PerformanceResult runPerformanceTest(int size1, int size2, int seed1, int seed2, bool debug = false) {
-    Tree tree1 = createRandomTree(size1, seed1, debug);
-    Tree tree2 = createRandomTree(size2, seed2, debug);
-
-    // Cálculo estimado de memória (duas tabelas |T1| x |T2| de int)
-    size_t mem_bytes = 2ULL * tree1.get_indices().size() * tree2.get_indices().size() * sizeof(int);
-    mem_bytes += tree1.get_indices().size() * sizeof(Node*) + tree2.get_indices().size() * sizeof(Node*); // Adiciona o tamanho dos vetores de nós
-    double mem_kb = mem_bytes / (1024.0);
+PerformanceResult runPerformanceTest(int size1, int size2, int seed1, int seed2, bool debug = false,
+                                     TED_Engine engine = TED_Engine::ZhangShasha) {
+    Node_Arena arena;
+    Tree tree1 = createRandomTree(size1, seed1, debug, &arena);
+    Tree tree2 = createRandomTree(size2, seed2, debug, &arena);
 
+    resetPeakRss();
+    Heap_Sample memory;
     auto start = std::chrono::high_resolution_clock::now();
 
-    Tree_Editing ted(&tree1, &tree2);
-    int distance = ted.treeEditDistance(tree1, tree2);
+    int distance = runEngine(engine, tree1, tree2, memory);
 
     auto end = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
 
     PerformanceResult result;
+    result.engine = engineName(engine);
     result.tree1Size = size1;
     result.tree1RootKeys = tree1.get_LR_keyroots().size();
     result.tree2Size = size2;
     result.tree2RootKeys = tree2.get_LR_keyroots().size();
     result.executionTimeMs = duration.count() / 1000.0;
     result.distance = distance;
-    result.memoryKB = mem_kb; // Salva o valor estimado de memória
+    recordMemory(result, memory);
 
     return result;
 }
@@ -544,23 +662,360 @@ void saveResultsToCSV(const vector<PerformanceResult>& results, const string& fi
     }
 
     // CSV header
-    file << "Tree1Size,Tree1RootKeys,Tree2Size,Tree2RootKeys,ExecutionTimeMs,Distance,MemoryKB\n";
+    file << "Engine,Tree1Size,Tree1RootKeys,Tree2Size,Tree2RootKeys,ExecutionTimeMs,Distance,PeakHeapKB,LiveHeapKB,Allocations,PeakRssKB\n";
 
     // Data
     for (const auto& result : results) {
-        file << result.tree1Size << ","
+        file << result.engine << ","
+                << result.tree1Size << ","
                 << result.tree1RootKeys << ","
                 << result.tree2Size << ","
                 << result.tree2RootKeys << ","
                 << fixed << setprecision(4) << result.executionTimeMs << ","
                 << result.distance << ","
-                << fixed << setprecision(2) << result.memoryKB << "\n";
+                << fixed << setprecision(2) << result.peakHeapKB << ","
+                << result.liveHeapKB << ","
+                << result.allocations << ","
+                << result.peakRssKB << "\n";
     }
 
     file.close();
     cout << "Results saved to: " << filename << endl;
 }
 
+/**
+ * @brief Writes a tree in one of the parser formats. Leaves are written as "a" in JSON and
+ * inner nodes as {"a": [children]}
+ */
+void writeTree(ostream& out, Tree& tree, Tree_Format format) {
+    // Stack of (node, next child to write)
+    vector<pair<Node*, size_t>> stack = {{tree.get_root(), 0}};
+    while (!stack.empty()) {
+        Node* node = stack.back().first;
+        size_t child = stack.back().second++;
+        if (child == 0) {
+            if (format == Tree_Format::Bracket) out << '{' << node->label;
+            else if (format == Tree_Format::XML) out << '<' << node->label << (node->children.empty() ? "/>" : ">");
+            else if (node->children.empty()) out << '"' << node->label << '"';
+            else out << "{\"" << node->label << "\": [";
+        } else if (child < node->children.size() && format == Tree_Format::JSON) {
+            out << ", ";
+        }
+        if (child < node->children.size()) {
+            stack.push_back({node->children[child], 0});
+            continue;
+        }
+        if (format == Tree_Format::Bracket) out << '}';
+        else if (format == Tree_Format::XML && !node->children.empty()) out << "</" << node->label << '>';
+        else if (format == Tree_Format::JSON && !node->children.empty()) out << "]}";
+        stack.pop_back();
+    }
+    out << '\n';
+}
+
+// Post-order labels and leftmost leaves of the tree the JSON parser builds from writeTree's
+// JSON output: a leaf stays a leaf, and an inner node becomes a "{}" node over its label,
+// over a "[]" node over its children. All three share the leftmost leaf of the first child
+void jsonShape(Tree& tree, vector<string>& labels, vector<int>& lld) {
+    labels.clear();
+    lld.clear();
+    // Stack of (node, next child, index of its first post-order node)
+    vector<tuple<Node*, size_t, int>> stack = {make_tuple(tree.get_root(), 0, 0)};
+    while (!stack.empty()) {
+        Node* node = get<0>(stack.back());
+        size_t child = get<1>(stack.back())++;
+        if (child < node->children.size()) {
+            stack.push_back(make_tuple(node->children[child], 0, (int)labels.size()));
+            continue;
+        }
+        const int first = get<2>(stack.back());
+        if (node->children.empty()) {
+            labels.push_back(string(1, node->label));
+            lld.push_back(first);
+        } else {
+            for (const string& label : {string("[]"), string(1, node->label), string("{}")}) {
+                labels.push_back(label);
+                lld.push_back(first);
+            }
+        }
+        stack.pop_back();
+    }
+}
+
+/**
+ * @brief Parses corpus files in every format and checks the parsed trees against the originals
+ */
+void parser_tests() {
+    cout << "========================================" << endl;
+    cout << "  TREE PARSERS - STREAMING THROUGHPUT" << endl;
+    cout << "       Tree Edit Distance (TED)" << endl;
+    cout << "========================================" << endl;
+    cout << endl;
+
+    const int corpusSize = 400;
+    Node_Arena arena;  // Frees the corpus trees on return
+    vector<Tree> corpus;
+    corpus.reserve(corpusSize);
+    for (int k = 0; k < corpusSize; ++k) {
+        corpus.push_back(createRandomTree(500 + (k * 37) % 1000, k + 1, false, &arena));
+    }
+
+    const Tree_Format formats[] = {Tree_Format::Bracket, Tree_Format::XML, Tree_Format::JSON};
+    const char* names[] = {"Bracket", "XML", "JSON"};
+    ofstream file("PARSER_throughput_results.csv");
+    file << "Format,Trees,Nodes,Bytes,ParseTimeMs,GBPerSecond,Verified\n";
+    for (int f = 0; f < 3; ++f) {
+        string path = string("parser_corpus.") + names[f];
+        {
+            ofstream corpusFile(path);
+            for (Tree& tree : corpus) {
+                writeTree(corpusFile, tree, formats[f]);
+            }
+        }
+
+        Tree_Parser parser;
+        auto start = std::chrono::high_resolution_clock::now();
+        if (!parser.open(path, formats[f])) {
+            continue;
+        }
+        long long nodes = 0;
+        Prepared_Tree tree;
+        while (parser.next(tree)) {
+            nodes += tree.size();
+        }
+        size_t bytes = parser.position();
+        auto end = std::chrono::high_resolution_clock::now();
+        double ms = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0;
+        if (!parser.error().empty()) {
+            cout << "  " << names[f] << ": " << parser.error() << endl;
+        }
+
+        // Second pass keeping the trees; labels are shared through the parser's dictionary
+        vector<Prepared_Tree> parsed;
+        parser.open(path, formats[f]);
+        while (parser.next(tree)) {
+            parsed.push_back(tree);
+        }
+
+        // Bracket and XML keep the shape, so distances must match the original trees
+        bool verified = parsed.size() == corpus.size();
+        if (verified && formats[f] == Tree_Format::JSON) {
+            // JSON wraps every inner node, so each tree must have exactly the expected labels and shape
+            vector<string> labels;
+            vector<int> lld;
+            for (int k = 0; k < corpusSize && verified; ++k) {
+                jsonShape(corpus[k], labels, lld);
+                verified = parsed[k].size() == (int)labels.size() && parsed[k].lld == lld;
+                for (int node = 0; node < parsed[k].size() && verified; ++node) {
+                    verified = parser.labels.name(parsed[k].labels[node]) == labels[node];
+                }
+            }
+        }
+        if (verified && formats[f] != Tree_Format::JSON) {
+            Tree_Editing editor;
+            for (int k = 0; k + 1 < corpusSize && verified; k += 40) {
+                Tree_Editing original(&corpus[k], &corpus[k + 1]);
+                verified = editor.treeEditDistance(parsed[k], parsed[k + 1]) == original.treeEditDistance(corpus[k], corpus[k + 1])
+                           && editor.treeEditDistance(parsed[k], parsed[k]) == 0;
+            }
+        }
+        double gbPerSecond = bytes / (ms / 1000.0) / 1e9;
+        cout << "  " << setw(8) << names[f] << ": " << parsed.size() << " trees, " << nodes << " nodes, "
+             << bytes << " bytes in " << fixed << setprecision(2) << ms << " ms (" << setprecision(3)
+             << gbPerSecond << " GB/s)" << (verified ? "" : " - MISMATCH") << endl;
+        file << names[f] << "," << parsed.size() << "," << nodes << "," << bytes << "," << fixed << setprecision(4)
+             << ms << "," << gbPerSecond << "," << (verified ? "yes" : "no") << "\n";
+        remove(path.c_str());
+    }
+    cout << "Results saved to: PARSER_throughput_results.csv" << endl;
+    cout << endl;
+}
+
+/**
+ * @brief Build and teardown time and peak memory of random trees with heap and arena nodes
+ */
+void arena_tests() {
+    cout << "========================================" << endl;
+    cout << "  NODE ALLOCATION - HEAP VS ARENA" << endl;
+    cout << "       Tree Edit Distance (TED)" << endl;
+    cout << "========================================" << endl;
+    cout << endl;
+
+    ofstream file("ARENA_allocation_results.csv");
+    file << "Allocator,Nodes,BuildMs,TeardownMs,PeakRssKB\n";
+    for (int size : {10000, 100000, 1000000}) {
+        for (int useArena = 0; useArena < 2; ++useArena) {
+            // Peak growth over the memory in use before the tree is built
+            resetPeakRss();
+            long baselineKb = currentRssKb();
+            unique_ptr<Node_Arena> arena(useArena ? new Node_Arena() : nullptr);
+
+            auto start = std::chrono::high_resolution_clock::now();
+            Tree tree = createRandomTree(size, size, false, arena.get());
+            auto built = std::chrono::high_resolution_clock::now();
+            long peakKb = peakRssKb() - baselineKb;
+
+            vector<Node*> nodes = tree.get_indices();
+            auto teardown = std::chrono::high_resolution_clock::now();
+            if (arena) {
+                arena->clear();
+            } else {
+                freeNodes(nodes);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+
+            double buildMs = std::chrono::duration_cast<std::chrono::microseconds>(built - start).count() / 1000.0;
+            double teardownMs = std::chrono::duration_cast<std::chrono::microseconds>(end - teardown).count() / 1000.0;
+            const char* allocator = useArena ? "Arena" : "Heap";
+            cout << "  " << setw(5) << allocator << " " << setw(8) << size << " nodes: build " << fixed << setprecision(2)
+                 << buildMs << " ms, teardown " << teardownMs << " ms, peak RSS +" << peakKb << " KB" << endl;
+            file << allocator << "," << size << "," << fixed << setprecision(4) << buildMs << "," << teardownMs << ","
+                 << peakKb << "\n";
+        }
+    }
+    cout << "Results saved to: ARENA_allocation_results.csv" << endl;
+    cout << endl;
+}
+
+/**
+ * @brief Startup from a binary corpus file against generating and preparing the trees
+ */
+void corpus_file_tests() {
+    cout << "========================================" << endl;
+    cout << "  CORPUS FILE - STARTUP TIME" << endl;
+    cout << "       Tree Edit Distance (TED)" << endl;
+    cout << "========================================" << endl;
+    cout << endl;
+
+    const int corpusSize = 2000;
+    const string path = "corpus_test.ted";
+    ofstream file("CORPUS_startup_results.csv");
+    file << "Step,Trees,Nodes,TimeMs\n";
+    auto report = [&](const char* step, long long nodes, std::chrono::high_resolution_clock::time_point start) {
+        auto end = std::chrono::high_resolution_clock::now();
+        double ms = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0;
+        cout << "  " << setw(18) << left << step << right << fixed << setprecision(2) << ms << " ms" << endl;
+        file << step << "," << corpusSize << "," << nodes << "," << fixed << setprecision(4) << ms << "\n";
+    };
+
+    // What every run does without a corpus file
+    auto start = std::chrono::high_resolution_clock::now();
+    Node_Arena arena;
+    vector<Prepared_Tree> generated;
+    generated.reserve(corpusSize);
+    long long nodes = 0;
+    for (int k = 0; k < corpusSize; ++k) {
+        Tree tree = createRandomTree(200 + (k * 37) % 1000, k + 1, false, &arena);
+        generated.push_back(Prepared_Tree(tree));
+        nodes += generated.back().size();
+    }
+    report("Generate+prepare", nodes, start);
+
+    start = std::chrono::high_resolution_clock::now();
+    Corpus_Writer writer;
+    writer.open(path);
+    for (const Prepared_Tree& tree : generated) {
+        writer.add(tree);
+    }
+    if (!writer.close()) {
+        cout << "Error: Could not write " << path << endl;
+        return;
+    }
+    report("Write", nodes, start);
+
+    start = std::chrono::high_resolution_clock::now();
+    Corpus_File corpus;
+    if (!corpus.open(path)) {
+        cout << "Error: " << corpus.error() << endl;
+        return;
+    }
+    report("Open", corpus.nodeCount(), start);
+
+    start = std::chrono::high_resolution_clock::now();
+    vector<Prepared_Tree> loaded(corpus.size());
+    for (int k = 0; k < corpus.size(); ++k) {
+        corpus.load(k, loaded[k]);
+    }
+    report("Load all", corpus.nodeCount(), start);
+
+    // Loaded trees give the same distances as the generated ones
+    bool verified = corpus.size() == corpusSize;
+    Tree_Editing editor;
+    for (int k = 0; k + 1 < corpusSize && verified; k += 200) {
+        verified = editor.treeEditDistance(loaded[k], loaded[k + 1]) == editor.treeEditDistance(generated[k], generated[k + 1]);
+    }
+    cout << "  Distances " << (verified ? "match" : "DO NOT MATCH") << " the generated trees" << endl;
+    remove(path.c_str());
+    cout << "Results saved to: CORPUS_startup_results.csv" << endl;
+    cout << endl;
+}
+
+/**
+ * @brief One query against many candidates with a new engine per pair and with one session
+ */
+void session_tests() {
+    cout << "========================================" << endl;
+    cout << "  SESSION - ONE QUERY, MANY CANDIDATES" << endl;
+    cout << "       Tree Edit Distance (TED)" << endl;
+    cout << "========================================" << endl;
+    cout << endl;
+
+    const int candidateCount = 2000;
+    Node_Arena arena;
+    Tree queryTree = createRandomTree(100, 7, false, &arena);
+    vector<Tree> trees;
+    vector<Prepared_Tree> candidates;
+    trees.reserve(candidateCount);
+    candidates.reserve(candidateCount);
+    for (int k = 0; k < candidateCount; ++k) {
+        trees.push_back(createRandomTree(20 + (k * 37) % 100, k + 100, false, &arena));
+        candidates.push_back(Prepared_Tree(trees.back()));
+    }
+
+    ofstream file("SESSION_results.csv");
+    file << "Mode,Candidates,TimeMs,Allocations,PeakHeapKB\n";
+    auto report = [&](const char* mode, std::chrono::high_resolution_clock::time_point start, const Heap_Sample& memory) {
+        auto end = std::chrono::high_resolution_clock::now();
+        double ms = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0;
+        cout << "  " << setw(22) << left << mode << right << fixed << setprecision(2) << setw(10) << ms << " ms, "
+             << memory.allocations << " allocations, peak heap " << memory.peak_bytes / 1024 << " KB" << endl;
+        file << mode << "," << candidateCount << "," << fixed << setprecision(4) << ms << ","
+             << memory.allocations << "," << memory.peak_bytes / 1024 << "\n";
+    };
+
+    // One engine per pair, both trees flattened on every call
+    vector<int> expected(candidateCount);
+    auto start = std::chrono::high_resolution_clock::now();
+    {
+        Heap_Scope scope;
+        for (int k = 0; k < candidateCount; ++k) {
+            Tree_Editing ted(&queryTree, &trees[k]);
+            expected[k] = ted.treeEditDistance(queryTree, trees[k]);
+        }
+        report("Engine per candidate", start, scope.sample());
+    }
+
+    // The query flattened once, prepared candidates read in place, workspaces kept warm
+    vector<int> distances;
+    start = std::chrono::high_resolution_clock::now();
+    {
+        Heap_Scope scope;
+        Tree_Editing_Session session(queryTree);
+        distances = session.distances(candidates);
+        report("Session", start, scope.sample());
+    }
+
+    // Node trees through the session's scratch
+    bool verified = distances == expected;
+    Tree_Editing_Session session(queryTree);
+    for (int k = 0; k < candidateCount && verified; k += 100) {
+        verified = session.distance(trees[k]) == expected[k] && session.distance(candidates[k]) == expected[k];
+    }
+    cout << "  Distances " << (verified ? "match" : "DO NOT MATCH") << " the engine per candidate" << endl;
+    cout << "Results saved to: SESSION_results.csv" << endl;
+    cout << endl;
+}
+
 /**
  * @brief Main function with test menu
  */
@@ -603,8 +1058,9 @@ int best_worst_case_tests() {
         cout << "  Algorithm time: " << fixed << setprecision(2) 
              << bestResult.executionTimeMs << " ms" << endl;
         cout << "  Edit distance: " << bestResult.distance << endl;
-        cout << "  Estimated memory usage: " << fixed << setprecision(2) 
-             << bestResult.memoryKB << " KB" << endl;
+        cout << "  Peak heap: " << fixed << setprecision(2) << bestResult.peakHeapKB << " KB in "
+             << bestResult.allocations << " allocations, peak RSS: " << bestResult.peakRssKB << " KB" << endl;
+        cout << "  Keyroot loop allocations: " << bestResult.keyrootLoopAllocations << endl;
         
         // 2. Worst Case Test
         cout << "\n2. WORST CASE TEST (Linear Chains):" << endl;
@@ -626,6 +1082,9 @@ int best_worst_case_tests() {
         cout << "  Algorithm time: " << fixed << setprecision(2) 
              << worstResult.executionTimeMs << " ms" << endl;
         cout << "  Edit distance: " << worstResult.distance << endl;
+        cout << "  Peak heap: " << fixed << setprecision(2) << worstResult.peakHeapKB << " KB in "
+             << worstResult.allocations << " allocations, peak RSS: " << worstResult.peakRssKB << " KB" << endl;
+        cout << "  Keyroot loop allocations: " << worstResult.keyrootLoopAllocations << endl;
         
         // Performance comparison
         cout << "\n3. PERFORMANCE COMPARISON:" << endl;
@@ -633,6 +1092,27 @@ int best_worst_case_tests() {
              << (worstResult.executionTimeMs / bestResult.executionTimeMs) << "x slower" << endl;
     }
     
+    // The sequential keyroot loop runs on scratch sized beforehand; with threads, each
+    // worker's scratch grows inside the loop
+    bool sequentialLoopClean = true;
+    for (const PerformanceResult& result : results) {
+        sequentialLoopClean = sequentialLoopClean && result.keyrootLoopAllocations == 0;
+    }
+    cout << "\n4. KEYROOT LOOP ALLOCATIONS:" << endl;
+    cout << "  Sequential runs: " << (sequentialLoopClean ? "none" : "SOME - SCRATCH NOT PRE-SIZED") << endl;
+    {
+        Node_Arena arena;
+        Tree tree1 = createBestCaseTree(2000, false, &arena);
+        Tree tree2 = createRandomTree(2000, 2001, false, &arena);
+        for (int threads : {1, 2}) {
+            Tree_Editing ted(&tree1, &tree2);
+            ted.set_num_threads(threads);
+            ted.treeEditDistance(tree1, tree2);
+            cout << "  Balanced x random, 2000 nodes, " << threads << (threads == 1 ? " thread:  " : " threads: ")
+                 << ted.keyroot_loop_allocations << endl;
+        }
+    }
+    
     cout << "\n" << string(70, '=') << endl;
     
     // Save results to CSV file
@@ -683,8 +1163,8 @@ void random_tests(){
         cout << "  Algorithm time: " << fixed << setprecision(2) 
              << result.executionTimeMs << " ms" << endl;
         cout << "  Edit distance (TED): " << result.distance << endl;
-        cout << "  Estimated memory usage: " << fixed << setprecision(2) 
-             << result.memoryKB << " KB" << endl;
+        cout << "  Peak heap: " << fixed << setprecision(2) << result.peakHeapKB << " KB in "
+             << result.allocations << " allocations, peak RSS: " << result.peakRssKB << " KB" << endl;
         cout << endl;
         cout << endl;
     }
@@ -700,6 +1180,995 @@ void random_tests(){
     cout << endl;
 }
 
+/**
+ * @brief Runs every engine on the same random trees
+ */
+void engine_comparison_tests() {
+    cout << "========================================" << endl;
+    cout << "  ENGINE COMPARISON - ZHANG-SHASHA, PATH DECOMPOSITION, DEMAINE" << endl;
+    cout << "       Tree Edit Distance (TED)" << endl;
+    cout << "========================================" << endl;
+    cout << endl;
+
+    vector<PerformanceResult> results;
+    vector<int> sizes = {10, 100, 1000}; // Demaine is cubic on random trees, too slow beyond this
+    vector<TED_Engine> engines = {TED_Engine::ZhangShasha, TED_Engine::PathDecomposition, TED_Engine::Demaine};
+
+    cout << "Sizes tested: 10, 100, 1000 nodes" << endl;
+    cout << string(60, '-') << endl;
+
+    for (int size : sizes) {
+        cout << "Trees of size " << size << ":" << endl;
+        for (TED_Engine engine : engines) {
+            PerformanceResult result = runPerformanceTest(size, size, size * 10, size * 20, false, engine);
+            results.push_back(result);
+            cout << "  " << left << setw(18) << result.engine << right
+                 << " time: " << fixed << setprecision(2) << result.executionTimeMs << " ms"
+                 << ", distance: " << result.distance
+                 << ", peak heap: " << setprecision(1) << result.peakHeapKB << " KB" << endl;
+        }
+        cout << endl;
+    }
+
+    cout << string(60, '-') << endl;
+
+    // Save results to CSV file
+    saveResultsToCSV(results, "ENGINE_complexity_results.csv");
+    cout << endl;
+}
+
+/**
+ * @brief Self-join of random trees and relabeled copies at a small threshold
+ */
+void similarity_join_tests() {
+    cout << "========================================" << endl;
+    cout << "  SIMILARITY JOIN - FILTER CASCADE" << endl;
+    cout << "       Tree Edit Distance (TED)" << endl;
+    cout << "========================================" << endl;
+    cout << endl;
+
+    const int baseTrees = 500;
+    const int copiesPerTree = 4;
+    const int threshold = 2;
+
+    // Each base tree plus copies with up to `threshold + 1` nodes relabeled
+    Node_Arena arena;
+    vector<Tree> corpus;
+    corpus.reserve(baseTrees * (copiesPerTree + 1));
+    for (int base = 0; base < baseTrees; ++base) {
+        int size = 20 + base % 40;
+        corpus.push_back(createRandomTree(size, base, false, &arena));
+        for (int copy = 1; copy <= copiesPerTree; ++copy) {
+            corpus.push_back(createRelabeledTree(size, base, copy % (threshold + 2), base * 100 + copy, &arena));
+        }
+    }
+
+    Similarity_Join join(threshold);
+    for (Tree& tree : corpus) {
+        join.add(&tree);
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    vector<Join_Match> matches = join.selfJoin();
+    auto end = std::chrono::high_resolution_clock::now();
+
+    cout << "Corpus: " << join.size() << " trees, threshold " << threshold << endl;
+    cout << "Pairs within threshold: " << matches.size() << " in "
+         << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << endl;
+    cout << string(64, '-') << endl;
+    join.printStages();
+    cout << string(64, '-') << endl;
+
+    ofstream file("JOIN_filter_results.csv");
+    if (!file.is_open()) {
+        cout << "Error: Could not create file JOIN_filter_results.csv" << endl;
+        return;
+    }
+    file << "Stage,Entered,Passed,PassRate\n";
+    for (const Join_Stage& stage : join.stages()) {
+        file << stage.name << "," << stage.entered << "," << stage.passed << ","
+             << fixed << setprecision(6) << stage.pass_rate() << "\n";
+    }
+    cout << "Results saved to: JOIN_filter_results.csv" << endl;
+
+    // Small corpus: the join must return exactly the pairs an exact TED over all pairs finds,
+    // so an unsound lower bound shows up as a missing pair
+    vector<Tree> small;
+    small.reserve(60 * (copiesPerTree + 1));
+    for (int base = 0; base < 60; ++base) {
+        int size = 4 + base % 12;
+        small.push_back(createRandomTree(size, base + 1000, false, &arena));
+        for (int copy = 1; copy <= copiesPerTree; ++copy) {
+            small.push_back(createRelabeledTree(size, base + 1000, copy % (threshold + 2), base * 100 + copy + 7, &arena));
+        }
+    }
+    Similarity_Join smallJoin(threshold);
+    for (Tree& tree : small) {
+        smallJoin.add(&tree);
+    }
+    vector<tuple<int, int, int>> joined;
+    for (const Join_Match& match : smallJoin.selfJoin()) {
+        joined.push_back(make_tuple(match.first, match.second, match.distance));
+    }
+    vector<tuple<int, int, int>> exact;
+    for (int a = 0; a < (int)small.size(); ++a) {
+        for (int b = a + 1; b < (int)small.size(); ++b) {
+            Tree_Editing ted(&small[a], &small[b]);
+            int distance = ted.treeEditDistance(small[a], small[b]);
+            if (distance <= threshold) {
+                exact.push_back(make_tuple(a, b, distance));
+            }
+        }
+    }
+    sort(joined.begin(), joined.end());
+    cout << "  " << small.size() << " small trees: " << joined.size() << " pairs joined, " << exact.size()
+         << " within threshold by exact TED over all pairs - " << (joined == exact ? "match" : "DO NOT MATCH") << endl;
+    cout << endl;
+}
+
+/**
+ * @brief All-pairs distance matrix of a random corpus with growing thread counts
+ */
+void all_pairs_tests() {
+    cout << "========================================" << endl;
+    cout << "  ALL-PAIRS DISTANCE MATRIX - THREAD SCALING" << endl;
+    cout << "       Tree Edit Distance (TED)" << endl;
+    cout << "========================================" << endl;
+    cout << endl;
+
+    const int corpusSize = 60;
+    Node_Arena arena;
+    vector<Tree> corpus;
+    corpus.reserve(corpusSize);
+    for (int k = 0; k < corpusSize; ++k) {
+        corpus.push_back(createRandomTree(50 + (k * 37) % 200, k + 1, false, &arena));
+    }
+
+    vector<int> threadCounts = {1, 2, 4};
+    int hardware = (int)std::thread::hardware_concurrency();
+    if (hardware > 4) {
+        threadCounts.push_back(hardware);
+    }
+    cout << "Hardware threads: " << hardware << " (speedups above this count are not expected)" << endl;
+
+    ofstream file("ALLPAIRS_scaling_results.csv");
+    file << "Threads,Trees,Pairs,ExecutionTimeMs,Speedup,Checksum\n";
+    double baselineMs = 0;
+    for (int threads : threadCounts) {
+        Distance_Matrix matrix(threads);
+        for (Tree& tree : corpus) {
+            matrix.add(tree);
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        matrix.compute();
+        auto end = std::chrono::high_resolution_clock::now();
+        double ms = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0;
+        if (threads == 1) {
+            baselineMs = ms;
+        }
+
+        long long checksum = 0;
+        for (int a = 0; a < matrix.size(); ++a) {
+            for (int b = a + 1; b < matrix.size(); ++b) {
+                checksum += matrix.distance(a, b);
+            }
+        }
+        size_t pairs = (size_t)corpusSize * (corpusSize - 1) / 2;
+        cout << "  " << setw(3) << threads << " threads: " << fixed << setprecision(2) << ms << " ms"
+             << ", speedup " << setprecision(2) << baselineMs / ms << "x"
+             << ", checksum " << checksum << endl;
+        file << threads << "," << corpusSize << "," << pairs << "," << fixed << setprecision(4) << ms << ","
+             << setprecision(4) << baselineMs / ms << "," << checksum << "\n";
+    }
+    cout << "Results saved to: ALLPAIRS_scaling_results.csv" << endl;
+    cout << endl;
+}
+
+/**
+ * @brief One large comparison with 1 and more threads over the keyroot pair DAG
+ */
+void single_pair_thread_tests() {
+    cout << "========================================" << endl;
+    cout << "  SINGLE PAIR - THREAD SCALING" << endl;
+    cout << "       Tree Edit Distance (TED)" << endl;
+    cout << "========================================" << endl;
+    cout << endl;
+
+    // Balanced trees (the worst-case test's shape) have the most keyroots, so the most
+    // pairs the pool can run at once; the copy is relabeled so no pair is skipped as identical
+    const int size = 3000;
+    Node_Arena arena;
+    Tree balanced1 = createBestCaseTree(size, false, &arena);
+    Tree balanced2 = createBestCaseTree(size, false, &arena);
+    srand(size);
+    for (int edit = 0; edit < size / 10; ++edit) {
+        balanced2.get_indices()[rand() % size]->label = 'a' + rand() % 26;
+    }
+    balanced2 = indexTree(balanced2.get_root());
+    Tree random1 = createRandomTree(size, 31, false, &arena);
+    Tree random2 = createRandomTree(size, 32, false, &arena);
+
+    vector<int> threadCounts = {1, 2, 4};
+    int hardware = (int)std::thread::hardware_concurrency();
+    if (hardware > 4) {
+        threadCounts.push_back(hardware);
+    }
+
+    ofstream file("THREADS_single_pair_results.csv");
+    file << "Shape,Nodes,Threads,ExecutionTimeMs,Speedup,Distance,Matches\n";
+    const pair<const char*, pair<Tree*, Tree*>> shapes[] = {
+        {"Balanced", {&balanced1, &balanced2}},
+        {"Random", {&random1, &random2}}
+    };
+    for (const auto& shape : shapes) {
+        Tree& tree1 = *shape.second.first;
+        Tree& tree2 = *shape.second.second;
+        double baselineMs = 0;
+        int baseline = 0;
+        for (int threads : threadCounts) {
+            Tree_Editing ted(&tree1, &tree2);
+            ted.set_num_threads(threads);
+            auto start = std::chrono::high_resolution_clock::now();
+            int distance = ted.treeEditDistance(tree1, tree2);
+            auto end = std::chrono::high_resolution_clock::now();
+            double ms = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0;
+            if (threads == 1) {
+                baselineMs = ms;
+                baseline = distance;
+            }
+            bool matches = distance == baseline;
+            cout << "  " << setw(8) << left << shape.first << right << setw(3) << threads << " threads: " << fixed
+                 << setprecision(2) << ms << " ms, speedup " << baselineMs / ms << "x, distance " << distance
+                 << (matches ? "" : " - MISMATCH") << endl;
+            file << shape.first << "," << size << "," << threads << "," << fixed << setprecision(4) << ms << ","
+                 << baselineMs / ms << "," << distance << "," << (matches ? "yes" : "no") << "\n";
+        }
+    }
+    cout << "Results saved to: THREADS_single_pair_results.csv" << endl;
+    cout << endl;
+}
+
+/**
+ * @brief Forest distance kernels on the same pairs: distances against the scalar kernel and timings
+ */
+void kernel_tests() {
+    cout << "========================================" << endl;
+    cout << "  FOREST KERNELS - SCALAR, SSE2, AVX2" << endl;
+    cout << "       Tree Edit Distance (TED)" << endl;
+    cout << "========================================" << endl;
+    cout << endl;
+
+    const char* kernelNames[] = {"Scalar", "SSE2", "AVX2", "Auto"};
+    const Forest_Kernel kernels[] = {Forest_Kernel::Scalar, Forest_Kernel::SSE2, Forest_Kernel::AVX2, Forest_Kernel::Auto};
+    cout << "Auto selects: " << kernelNames[(int)Tree_Editing::bestAvailableKernel()] << endl;
+
+    ofstream file("KERNEL_comparison_results.csv");
+    file << "Shape,Nodes,Requested,Used,ExecutionTimeMs,Distance,Matches\n";
+    bool verified = true;
+    for (int size : {500, 2000}) {
+        Node_Arena arena;
+        Tree random1 = createRandomTree(size, size + 1, false, &arena);
+        Tree random2 = createRandomTree(size, size + 2, false, &arena);
+        Tree balanced1 = createBestCaseTree(size, false, &arena);
+        Tree balanced2 = createRandomTree(size, size + 3, false, &arena);
+        const pair<const char*, pair<Tree*, Tree*>> shapes[] = {
+            {"Random", {&random1, &random2}},
+            {"Balanced", {&balanced1, &balanced2}}
+        };
+        for (const auto& shape : shapes) {
+            Tree& tree1 = *shape.second.first;
+            Tree& tree2 = *shape.second.second;
+            int scalar = 0;
+            for (int k = 0; k < 4; ++k) {
+                Tree_Editing ted(&tree1, &tree2);
+                ted.set_kernel(kernels[k]);
+                auto start = std::chrono::high_resolution_clock::now();
+                int distance = ted.treeEditDistance(tree1, tree2);
+                auto end = std::chrono::high_resolution_clock::now();
+                double ms = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0;
+                if (k == 0) {
+                    scalar = distance;
+                }
+                bool matches = distance == scalar;
+                verified = verified && matches;
+                cout << "  " << setw(8) << left << shape.first << right << setw(6) << size << " nodes, "
+                     << setw(6) << left << kernelNames[k] << right << " -> " << setw(6) << left
+                     << kernelNames[(int)ted.kernel] << right << fixed << setprecision(2) << setw(10) << ms
+                     << " ms, distance " << distance << endl;
+                file << shape.first << "," << size << "," << kernelNames[k] << "," << kernelNames[(int)ted.kernel]
+                     << "," << fixed << setprecision(4) << ms << "," << distance << "," << (matches ? "yes" : "no") << "\n";
+            }
+        }
+    }
+    cout << "  Distances " << (verified ? "match" : "DO NOT MATCH") << " the scalar kernel" << endl;
+    cout << "Results saved to: KERNEL_comparison_results.csv" << endl;
+    cout << endl;
+}
+
+/**
+ * @brief One pair with tree_dist in RAM and in a memory-mapped scratch file with a small resident budget
+ */
+void out_of_core_tests() {
+    cout << "========================================" << endl;
+    cout << "  OUT-OF-CORE - MAPPED DISTANCE MATRIX" << endl;
+    cout << "       Tree Edit Distance (TED)" << endl;
+    cout << "========================================" << endl;
+    cout << endl;
+
+    // 3000 x 3000 ints is about 36 MB of tree_dist; the budget keeps a 4 MB strip resident.
+    // The forest scratch of the root keyroot pair stays on the heap in both modes
+    const int size = 3000;
+    const size_t budget = size_t(4) << 20;
+    Node_Arena arena;
+    Tree tree1 = createRandomTree(size, 41, false, &arena);
+    Tree tree2 = createRandomTree(size, 42, false, &arena);
+
+    ofstream file("OUTOFCORE_results.csv");
+    file << "Mode,Nodes,BudgetKB,ExecutionTimeMs,PeakRssGrowthKB,PeakHeapKB,Distance\n";
+    int distances[2] = {0, 0};
+    for (int mode = 0; mode < 2; ++mode) {
+        const char* name = mode == 0 ? "RAM" : "Mapped file";
+        resetPeakRss();
+        long baselineKb = currentRssKb();
+        auto start = std::chrono::high_resolution_clock::now();
+        Heap_Sample memory;
+        {
+            Heap_Scope scope;
+            Tree_Editing ted(&tree1, &tree2);
+            if (mode == 1) {
+                ted.set_tree_dist_file(".", budget);
+            }
+            distances[mode] = ted.treeEditDistance(tree1, tree2);
+            memory = scope.sample();
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        double ms = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0;
+        long peakKb = peakRssKb() - baselineKb;
+        cout << "  " << setw(12) << left << name << right << fixed << setprecision(2) << setw(10) << ms
+             << " ms, peak RSS growth " << peakKb << " KB, peak heap " << memory.peak_bytes / 1024
+             << " KB, distance " << distances[mode] << endl;
+        file << name << "," << size << "," << (mode == 1 ? budget / 1024 : 0) << "," << fixed << setprecision(4)
+             << ms << "," << peakKb << "," << memory.peak_bytes / 1024 << "," << distances[mode] << "\n";
+    }
+    cout << "  Distances " << (distances[0] == distances[1] ? "match" : "DO NOT MATCH") << " the in-memory run" << endl;
+    cout << "Results saved to: OUTOFCORE_results.csv" << endl;
+    cout << endl;
+}
+
+// Forest distance straight from the recursive definition: delete, insert or match the
+// rightmost roots of the post-order ranges [i1, j1] and [i2, j2], memoized. No keyroots
+// and no shared tables, so it checks the engines independently; small trees only
+template <class Cost_Policy>
+typename Cost_Policy::cost_type bruteForceDistance(const Prepared_Tree& tree1, const Prepared_Tree& tree2,
+                                                    const Cost_Policy& costs, int i1, int j1, int i2, int j2,
+                                                    map<tuple<int, int, int, int>, typename Cost_Policy::cost_type>& memo) {
+    typedef typename Cost_Policy::cost_type cost_type;
+    if (j1 < i1 && j2 < i2) {
+        return 0;
+    }
+    auto key = make_tuple(i1, j1, i2, j2);
+    auto found = memo.find(key);
+    if (found != memo.end()) {
+        return found->second;
+    }
+    cost_type best;
+    if (j2 < i2) {
+        best = bruteForceDistance(tree1, tree2, costs, i1, j1 - 1, i2, j2, memo) + costs.remove(j1);
+    } else if (j1 < i1) {
+        best = bruteForceDistance(tree1, tree2, costs, i1, j1, i2, j2 - 1, memo) + costs.insert(j2);
+    } else {
+        const int l1 = tree1.lld[j1];
+        const int l2 = tree2.lld[j2];
+        best = min(bruteForceDistance(tree1, tree2, costs, i1, j1 - 1, i2, j2, memo) + costs.remove(j1),
+                   bruteForceDistance(tree1, tree2, costs, i1, j1, i2, j2 - 1, memo) + costs.insert(j2));
+        best = min(best, bruteForceDistance(tree1, tree2, costs, i1, l1 - 1, i2, l2 - 1, memo)
+                       + bruteForceDistance(tree1, tree2, costs, l1, j1 - 1, l2, j2 - 1, memo)
+                       + costs.rename(tree1.labels[j1], tree2.labels[j2]));
+    }
+    memo[key] = best;
+    return best;
+}
+
+template <class Cost_Policy>
+typename Cost_Policy::cost_type bruteForceDistance(const Prepared_Tree& tree1, const Prepared_Tree& tree2, const Cost_Policy& costs) {
+    map<tuple<int, int, int, int>, typename Cost_Policy::cost_type> memo;
+    return bruteForceDistance(tree1, tree2, costs, 0, tree1.size() - 1, 0, tree2.size() - 1, memo);
+}
+
+/**
+ * @brief Per_Node_Cost with constant and table rename functors, checked against the recursive definition
+ */
+void cost_policy_tests() {
+    cout << "========================================" << endl;
+    cout << "  COST POLICIES - PER-NODE COSTS" << endl;
+    cout << "       Tree Edit Distance (TED)" << endl;
+    cout << "========================================" << endl;
+    cout << endl;
+
+    typedef Per_Node_Cost<int> Constant_Costs;
+    typedef Per_Node_Cost<double, Rename_Table<double>> Table_Costs;
+
+    // Rename cost grows with the distance between the letters, capped at the cost of a delete and an insert
+    auto letterDistance = [](int label1, int label2) { return min(0.25 * abs(label1 - label2), 3.0); };
+    auto makeCosts = [&](int nodes1, int nodes2, int seed, Constant_Costs& constant, Table_Costs& table) {
+        srand(seed);
+        constant.remove_costs.resize(nodes1);
+        constant.insert_costs.resize(nodes2);
+        table.remove_costs.resize(nodes1);
+        table.insert_costs.resize(nodes2);
+        for (int k = 0; k < nodes1; ++k) {
+            constant.remove_costs[k] = 1 + rand() % 3;
+            table.remove_costs[k] = 0.5 * (1 + rand() % 4);
+        }
+        for (int k = 0; k < nodes2; ++k) {
+            constant.insert_costs[k] = 1 + rand() % 3;
+            table.insert_costs[k] = 0.5 * (1 + rand() % 4);
+        }
+        constant.rename_function.cost = 2;
+        table.rename_function.assign(256, letterDistance);
+    };
+
+    // Small pairs against the recursive definition
+    const int pairs = 300;
+    int mismatches = 0;
+    for (int k = 0; k < pairs; ++k) {
+        Node_Arena arena;
+        Tree tree1 = createRandomTree(1 + k % 10, 2 * k + 1, false, &arena);
+        Tree tree2 = createRandomTree(1 + (k * 7) % 10, 2 * k + 2, false, &arena);
+        Prepared_Tree prepared1(tree1);
+        Prepared_Tree prepared2(tree2);
+        Constant_Costs constant;
+        Table_Costs table;
+        makeCosts(prepared1.size(), prepared2.size(), k, constant, table);
+
+        Basic_Tree_Editing<Constant_Costs> constantEngine(&tree1, &tree2, constant);
+        Basic_Tree_Editing<Table_Costs> tableEngine(&tree1, &tree2, table);
+        if (constantEngine.treeEditDistance(tree1, tree2) != bruteForceDistance(prepared1, prepared2, constant)) {
+            ++mismatches;
+        }
+        if (fabs(tableEngine.treeEditDistance(tree1, tree2) - bruteForceDistance(prepared1, prepared2, table)) > 1e-9) {
+            ++mismatches;
+        }
+    }
+    cout << "  " << pairs << " small pairs, constant and table renames: distances "
+         << (mismatches == 0 ? "match" : "DO NOT MATCH") << " the recursive definition" << endl;
+
+    // Cost of each policy on one larger pair
+    const int size = 1500;
+    Node_Arena arena;
+    Tree tree1 = createRandomTree(size, 51, false, &arena);
+    Tree tree2 = createRandomTree(size, 52, false, &arena);
+    Constant_Costs constant;
+    Table_Costs table;
+    makeCosts(size, size, 53, constant, table);
+
+    ofstream file("COSTPOLICY_results.csv");
+    file << "Policy,Nodes,ExecutionTimeMs,Distance\n";
+    auto timeRun = [&](const char* name, auto& engine) {
+        auto start = std::chrono::high_resolution_clock::now();
+        double distance = engine.treeEditDistance(tree1, tree2);
+        auto end = std::chrono::high_resolution_clock::now();
+        double ms = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0;
+        cout << "  " << setw(26) << left << name << right << fixed << setprecision(2) << setw(10) << ms
+             << " ms, distance " << distance << endl;
+        file << name << "," << size << "," << fixed << setprecision(4) << ms << "," << distance << "\n";
+    };
+    Basic_Tree_Editing<Unit_Cost<double>> unitEngine(&tree1, &tree2);
+    Basic_Tree_Editing<Constant_Costs> constantEngine(&tree1, &tree2, constant);
+    Basic_Tree_Editing<Table_Costs> tableEngine(&tree1, &tree2, table);
+    timeRun("Unit_Cost<double>", unitEngine);
+    timeRun("Per_Node_Cost constant", constantEngine);
+    timeRun("Per_Node_Cost table", tableEngine);
+    cout << "Results saved to: COSTPOLICY_results.csv" << endl;
+    cout << endl;
+}
+
+/**
+ * @brief boundedDistance(k) against min(full distance, k + 1) over several k, and its time against the full DP
+ */
+void bounded_distance_tests() {
+    cout << "========================================" << endl;
+    cout << "  BOUNDED DISTANCE - K-STRIP" << endl;
+    cout << "       Tree Edit Distance (TED)" << endl;
+    cout << "========================================" << endl;
+    cout << endl;
+
+    const vector<int> limits = {0, 1, 2, 4, 8, 16, 32, 64};
+
+    // Small pairs: relabeled copies (distance up to the relabels) and unrelated trees
+    int checks = 0;
+    int mismatches = 0;
+    for (int k = 0; k < 200; ++k) {
+        Node_Arena arena;
+        const int size = 1 + k % 40;
+        Tree tree1 = createRandomTree(size, 3 * k + 1, false, &arena);
+        Tree tree2 = k % 2 == 0 ? createRelabeledTree(size, 3 * k + 1, k % 7, k, &arena)
+                                : createRandomTree(1 + (k * 13) % 40, 3 * k + 2, false, &arena);
+        Tree_Editing ted(&tree1, &tree2);
+        int full = ted.treeEditDistance(tree1, tree2);
+        for (int limit : limits) {
+            Tree_Editing bounded(&tree1, &tree2);
+            mismatches += bounded.boundedDistance(tree1, tree2, limit) != min(full, limit + 1);
+            ++checks;
+        }
+    }
+    cout << "  " << checks << " small checks: boundedDistance(k) " << (mismatches == 0 ? "matches" : "DOES NOT MATCH")
+         << " min(distance, k + 1)" << endl;
+
+    // Timing on a near-duplicate pair and an unrelated pair
+    const int size = 2000;
+    Node_Arena arena;
+    Tree original = createRandomTree(size, 61, false, &arena);
+    Tree relabeled = createRelabeledTree(size, 61, 5, 62, &arena);
+    Tree unrelated = createRandomTree(size, 63, false, &arena);
+
+    ofstream file("BOUNDED_distance_results.csv");
+    file << "Pair,Nodes,K,BoundedTimeMs,FullTimeMs,Bounded,Full,Matches\n";
+    const pair<const char*, Tree*> pairs[] = {{"Relabeled", &relabeled}, {"Unrelated", &unrelated}};
+    bool verified = mismatches == 0;
+    for (const auto& other : pairs) {
+        Tree& tree2 = *other.second;
+        auto start = std::chrono::high_resolution_clock::now();
+        Tree_Editing ted(&original, &tree2);
+        int full = ted.treeEditDistance(original, tree2);
+        auto end = std::chrono::high_resolution_clock::now();
+        double fullMs = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0;
+        cout << "  " << other.first << " pair, full DP: " << fixed << setprecision(2) << fullMs << " ms, distance " << full << endl;
+        for (int limit : limits) {
+            start = std::chrono::high_resolution_clock::now();
+            Tree_Editing bounded(&original, &tree2);
+            int distance = bounded.boundedDistance(original, tree2, limit);
+            end = std::chrono::high_resolution_clock::now();
+            double ms = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0;
+            bool matches = distance == min(full, limit + 1);
+            verified = verified && matches;
+            cout << "    k = " << setw(2) << limit << ": " << setw(8) << ms << " ms, bounded distance " << distance
+                 << (matches ? "" : " - MISMATCH") << endl;
+            file << other.first << "," << size << "," << limit << "," << fixed << setprecision(4) << ms << ","
+                 << fullMs << "," << distance << "," << full << "," << (matches ? "yes" : "no") << "\n";
+        }
+    }
+    cout << "  Bounded distances " << (verified ? "match" : "DO NOT MATCH") << " the full DP" << endl;
+    cout << "Results saved to: BOUNDED_distance_results.csv" << endl;
+    cout << endl;
+}
+
+// Checks a streamed edit script: every node of T1 is matched, renamed or deleted exactly once,
+// every node of T2 matched, renamed or inserted exactly once, Match/Rename agree with the labels,
+// the mapped pairs keep ancestry and post-order (checked only when `checkMapping`, it is quadratic),
+// and the costs add up to `distance`
+template <class Cost_Policy>
+bool checkEditScript(const vector<Edit_Operation<typename Cost_Policy::cost_type>>& script, const Prepared_Tree& tree1,
+                     const Prepared_Tree& tree2, const Cost_Policy& costs, typename Cost_Policy::cost_type distance,
+                     bool checkMapping) {
+    typedef Edit_Operation<typename Cost_Policy::cost_type> Operation;
+    vector<int> covered1(tree1.size(), 0);
+    vector<int> covered2(tree2.size(), 0);
+    vector<pair<int, int>> mapping;
+    double total = 0;
+    for (const Operation& op : script) {
+        total += op.cost;
+        if (op.kind != Operation::Insert) {
+            if (op.node1 < 0 || op.node1 >= tree1.size()) return false;
+            ++covered1[op.node1];
+        }
+        if (op.kind != Operation::Delete) {
+            if (op.node2 < 0 || op.node2 >= tree2.size()) return false;
+            ++covered2[op.node2];
+        }
+        if (op.kind == Operation::Match || op.kind == Operation::Rename) {
+            bool sameLabel = tree1.labels[op.node1] == tree2.labels[op.node2];
+            if (sameLabel != (op.kind == Operation::Match)) return false;
+            if (op.cost != costs.rename(tree1.labels[op.node1], tree2.labels[op.node2])) return false;
+            mapping.push_back({op.node1, op.node2});
+        } else if (op.cost != (op.kind == Operation::Delete ? costs.remove(op.node1) : costs.insert(op.node2))) {
+            return false;
+        }
+    }
+    for (int count : covered1) if (count != 1) return false;
+    for (int count : covered2) if (count != 1) return false;
+    if (checkMapping) {
+        // x is an ancestor of y in post-order when lld[x] <= y < x
+        for (const auto& a : mapping) {
+            for (const auto& b : mapping) {
+                bool ancestor1 = tree1.lld[a.first] <= b.first && b.first < a.first;
+                bool ancestor2 = tree2.lld[a.second] <= b.second && b.second < a.second;
+                if (ancestor1 != ancestor2 || (a.first < b.first) != (a.second < b.second)) return false;
+            }
+        }
+    }
+    return fabs(total - distance) < 1e-9;
+}
+
+/**
+ * @brief Edit scripts streamed by editScript, checked for node coverage and cost against the distance
+ */
+void edit_script_tests() {
+    cout << "========================================" << endl;
+    cout << "  EDIT SCRIPT - STREAMED BACKTRACE" << endl;
+    cout << "       Tree Edit Distance (TED)" << endl;
+    cout << "========================================" << endl;
+    cout << endl;
+
+    // Small pairs with unit and per-node costs
+    const int pairs = 300;
+    int failures = 0;
+    for (int k = 0; k < pairs; ++k) {
+        Node_Arena arena;
+        Tree tree1 = createRandomTree(1 + k % 60, 5 * k + 1, false, &arena);
+        Tree tree2 = k % 3 == 0 ? createRelabeledTree(1 + k % 60, 5 * k + 1, k % 9, k, &arena)
+                                : createRandomTree(1 + (k * 17) % 60, 5 * k + 2, false, &arena);
+        Prepared_Tree prepared1(tree1);
+        Prepared_Tree prepared2(tree2);
+
+        vector<Edit_Operation<int>> script;
+        Tree_Editing ted(&tree1, &tree2);
+        int distance = ted.editScript(tree1, tree2, [&](const Edit_Operation<int>& op) { script.push_back(op); });
+        failures += !checkEditScript(script, prepared1, prepared2, Unit_Cost<int>(), distance, true);
+
+        Per_Node_Cost<double, Rename_Table<double>> costs;
+        srand(k);
+        for (int node = 0; node < prepared1.size(); ++node) costs.remove_costs.push_back(0.5 * (1 + rand() % 4));
+        for (int node = 0; node < prepared2.size(); ++node) costs.insert_costs.push_back(0.5 * (1 + rand() % 4));
+        costs.rename_function.assign(256, [](int label1, int label2) { return min(0.25 * abs(label1 - label2), 3.0); });
+        vector<Edit_Operation<double>> weighted;
+        Basic_Tree_Editing<Per_Node_Cost<double, Rename_Table<double>>> weightedTed(&tree1, &tree2, costs);
+        double weightedDistance = weightedTed.editScript(tree1, tree2, [&](const Edit_Operation<double>& op) { weighted.push_back(op); });
+        failures += !checkEditScript(weighted, prepared1, prepared2, costs, weightedDistance, true);
+    }
+    cout << "  " << pairs << " small pairs, unit and per-node costs: edit scripts "
+         << (failures == 0 ? "cover every node once and sum to the distance" : "ARE INVALID") << endl;
+
+    // One larger pair in every execution mode, against the distance-only run
+    const int size = 2000;
+    Node_Arena arena;
+    Tree tree1 = createRandomTree(size, 71, false, &arena);
+    Tree tree2 = createRelabeledTree(size, 71, 50, 73, &arena);
+    Prepared_Tree prepared1(tree1);
+    Prepared_Tree prepared2(tree2);
+
+    ofstream file("EDITSCRIPT_results.csv");
+    file << "Mode,Nodes,DistanceTimeMs,ScriptTimeMs,Operations,Distance,Valid\n";
+    auto start = std::chrono::high_resolution_clock::now();
+    Tree_Editing plain(&tree1, &tree2);
+    int expected = plain.treeEditDistance(tree1, tree2);
+    auto end = std::chrono::high_resolution_clock::now();
+    double distanceMs = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0;
+    bool verified = failures == 0;
+    for (int mode = 0; mode < 3; ++mode) {
+        const char* name = mode == 0 ? "Scalar" : mode == 1 ? "Auto kernel" : "2 threads";
+        vector<Edit_Operation<int>> script;
+        start = std::chrono::high_resolution_clock::now();
+        Tree_Editing ted(&tree1, &tree2);
+        if (mode == 1) ted.set_kernel(Forest_Kernel::Auto);
+        if (mode == 2) ted.set_num_threads(2);
+        int distance = ted.editScript(tree1, tree2, [&](const Edit_Operation<int>& op) { script.push_back(op); });
+        end = std::chrono::high_resolution_clock::now();
+        double ms = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0;
+        bool valid = distance == expected && checkEditScript(script, prepared1, prepared2, Unit_Cost<int>(), expected, false);
+        verified = verified && valid;
+        cout << "  " << setw(12) << left << name << right << fixed << setprecision(2) << setw(10) << ms << " ms ("
+             << distanceMs << " ms distance only), " << script.size() << " operations, distance " << distance
+             << (valid ? "" : " - INVALID") << endl;
+        file << name << "," << size << "," << fixed << setprecision(4) << distanceMs << "," << ms << ","
+             << script.size() << "," << distance << "," << (valid ? "yes" : "no") << "\n";
+    }
+    cout << "  Edit scripts " << (verified ? "match" : "DO NOT MATCH") << " the distances" << endl;
+    cout << "Results saved to: EDITSCRIPT_results.csv" << endl;
+    cout << endl;
+}
+
+// One random edit of the Node structure under `root`: relabel a node, insert a node that
+// adopts a run of a parent's children, or delete a non-root node (its children take its
+// place). Appends the nodes updateTreeEditDistance must be told about to `changed` and
+// returns the kind of edit: 0 relabel, 1 insert, 2 delete
+int applyRandomEdit(const Tree& indexed, Node_Arena* arena, vector<Node*>& changed) {
+    const vector<Node*>& nodes = indexed.get_indices();
+    int kind = rand() % 3;
+    if (kind == 0 || nodes.size() < 2) {
+        Node* node = nodes[rand() % nodes.size()];
+        node->label = 'a' + rand() % 26;
+        changed.push_back(node);
+        return 0;
+    }
+    if (kind == 1) {
+        Node* parent = nodes[rand() % nodes.size()];
+        const int count = (int)parent->children.size();
+        const int first = rand() % (count + 1);
+        const int last = first + rand() % (count - first + 1);
+        Node* inserted = createNode('a' + rand() % 26, arena);
+        for (int k = first; k < last; ++k) {
+            inserted->add_child(parent->children[k]);
+        }
+        parent->children.erase(parent->children.begin() + first, parent->children.begin() + last);
+        parent->children.insert(parent->children.begin() + first, inserted);
+        changed.push_back(inserted);
+        changed.push_back(parent);
+        return 1;
+    }
+    Node* removed = nodes[rand() % (nodes.size() - 1)];  // The root is last in post-order
+    for (Node* parent : nodes) {
+        auto position = find(parent->children.begin(), parent->children.end(), removed);
+        if (position == parent->children.end()) continue;
+        vector<Node*> grandchildren(removed->children.begin(), removed->children.end());
+        position = parent->children.erase(position);
+        parent->children.insert(position, grandchildren.begin(), grandchildren.end());
+        changed.push_back(parent);
+        break;
+    }
+    return 2;
+}
+
+/**
+ * @brief Trees sharing subtrees: keyroot pairs skipped as identical, checked against the full DP
+ */
+void identical_subtree_tests() {
+    cout << "========================================" << endl;
+    cout << "  IDENTICAL SUBTREES - SKIPPED PAIRS" << endl;
+    cout << "       Tree Edit Distance (TED)" << endl;
+    cout << "========================================" << endl;
+    cout << endl;
+
+    // Small pairs of relabeled copies and motif documents, in every execution mode
+    int mismatches = 0;
+    size_t skipped = 0;
+    for (int k = 0; k < 300; ++k) {
+        Node_Arena arena;
+        Tree tree1 = createRandomTree(5 + k % 40, k + 1, false, &arena);
+        Tree tree2 = createRelabeledTree(5 + k % 40, k + 1, k % 4, k + 1000, &arena);
+        if (k % 2 == 1) {
+            vector<Node*> motifs;
+            for (int motif = 0; motif < 3; ++motif) {
+                motifs.push_back(createRandomTree(3 + (k + motif) % 6, 3 * k + motif, false, &arena).get_root());
+            }
+            tree1 = createMotifDocument(motifs, 2 + k % 8, 2 * k, &arena);
+            tree2 = createMotifDocument(motifs, 2 + k % 9, 2 * k + 1, &arena);
+        }
+        Tree_Editing skipping(&tree1, &tree2);
+        Tree_Editing full(&tree1, &tree2);
+        full.skip_identical_subtrees = false;
+        if (k % 3 == 1) {
+            skipping.set_kernel(Forest_Kernel::Auto);
+        } else if (k % 3 == 2) {
+            skipping.set_num_threads(2);
+        }
+        mismatches += skipping.treeEditDistance(tree1, tree2) != full.treeEditDistance(tree1, tree2);
+        skipped += skipping.skipped_keyroot_pairs;
+    }
+    cout << "  300 small pairs (" << skipped << " keyroot pairs skipped): distances "
+         << (mismatches == 0 ? "match" : "DO NOT MATCH") << " skip_identical_subtrees = false" << endl;
+
+    // Large pairs with the shortcut on and off
+    Node_Arena arena;
+    const int size = 3000;
+    Tree random1 = createRandomTree(size, 61, false, &arena);
+    Tree random2 = createRelabeledTree(size, 61, 5, 62, &arena);
+    Tree balanced1 = createBestCaseTree(size, false, &arena);
+    Tree balanced2 = createBestCaseTree(size, false, &arena);
+    srand(63);
+    for (int edit = 0; edit < 5; ++edit) {
+        balanced2.get_indices()[rand() % size]->label = 'a' + rand() % 26;
+    }
+    balanced2 = indexTree(balanced2.get_root());
+    vector<Node*> motifs;
+    for (int motif = 0; motif < 4; ++motif) {
+        motifs.push_back(createRandomTree(25, 64 + motif, false, &arena).get_root());
+    }
+    Tree document1 = createMotifDocument(motifs, 80, 68, &arena);
+    Tree document2 = createMotifDocument(motifs, 80, 69, &arena);
+
+    ofstream file("IDENTICAL_subtree_results.csv");
+    file << "Shape,Nodes1,Nodes2,SkippedPairs,AllPairs,SkipTimeMs,FullTimeMs,Distance,Matches\n";
+    bool verified = mismatches == 0;
+    const pair<const char*, pair<Tree*, Tree*>> shapes[] = {
+        {"Relabeled", {&random1, &random2}},
+        {"Balanced", {&balanced1, &balanced2}},
+        {"Motifs", {&document1, &document2}}
+    };
+    for (const auto& shape : shapes) {
+        Tree& tree1 = *shape.second.first;
+        Tree& tree2 = *shape.second.second;
+        Tree_Editing skipping(&tree1, &tree2);
+        auto start = std::chrono::high_resolution_clock::now();
+        int distance = skipping.treeEditDistance(tree1, tree2);
+        auto end = std::chrono::high_resolution_clock::now();
+        double skipMs = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0;
+        Tree_Editing full(&tree1, &tree2);
+        full.skip_identical_subtrees = false;
+        start = std::chrono::high_resolution_clock::now();
+        int expected = full.treeEditDistance(tree1, tree2);
+        end = std::chrono::high_resolution_clock::now();
+        double fullMs = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0;
+        const size_t allPairs = Prepared_Tree(tree1).keyroots.size() * Prepared_Tree(tree2).keyroots.size();
+        bool matches = distance == expected;
+        verified = verified && matches;
+        cout << "  " << setw(10) << left << shape.first << right << setw(5) << tree1.get_indices().size() << " x "
+             << tree2.get_indices().size() << " nodes: " << skipping.skipped_keyroot_pairs << " of " << allPairs
+             << " pairs skipped, " << fixed << setprecision(2) << skipMs << " ms against " << fullMs
+             << " ms, distance " << distance << (matches ? "" : " - MISMATCH") << endl;
+        file << shape.first << "," << tree1.get_indices().size() << "," << tree2.get_indices().size() << ","
+             << skipping.skipped_keyroot_pairs << "," << allPairs << "," << fixed << setprecision(4) << skipMs << ","
+             << fullMs << "," << distance << "," << (matches ? "yes" : "no") << "\n";
+    }
+    cout << "  Distances " << (verified ? "match" : "DO NOT MATCH") << " the full DP" << endl;
+    cout << "Results saved to: IDENTICAL_subtree_results.csv" << endl;
+    cout << endl;
+}
+
+/**
+ * @brief updateTreeEditDistance after random edits against a fresh treeEditDistance, and its time
+ */
+void incremental_update_tests() {
+    cout << "========================================" << endl;
+    cout << "  INCREMENTAL UPDATE - EDITED T2" << endl;
+    cout << "       Tree Edit Distance (TED)" << endl;
+    cout << "========================================" << endl;
+    cout << endl;
+
+    // Small trees, one engine kept across many rounds of 1 to 3 edits
+    int rounds = 0;
+    int mismatches = 0;
+    for (int trial = 0; trial < 20; ++trial) {
+        Node_Arena arena;
+        Tree tree1 = createRandomTree(30 + trial * 5, 2 * trial + 1, false, &arena);
+        Tree tree2 = createRandomTree(30 + trial * 7, 2 * trial + 2, false, &arena);
+        Node* root2 = tree2.get_root();
+        Tree_Editing ted(&tree1, &tree2);
+        if (trial % 2 == 1) {
+            ted.set_kernel(Forest_Kernel::Auto);
+        }
+        ted.treeEditDistance(tree1, tree2);
+        Tree current = indexTree(root2);
+        for (int round = 0; round < 25; ++round) {
+            vector<Node*> changed;
+            srand(trial * 100 + round);
+            for (int edit = rand() % 3; edit >= 0; --edit) {
+                applyRandomEdit(current, &arena, changed);
+                current = indexTree(root2);
+            }
+            int updated = ted.updateTreeEditDistance(current, changed);
+            Tree_Editing fresh(&tree1, &current);
+            mismatches += updated != fresh.treeEditDistance(tree1, current);
+            ++rounds;
+        }
+    }
+    cout << "  " << rounds << " rounds of random edits: updated distances " << (mismatches == 0 ? "match" : "DO NOT MATCH")
+         << " a fresh run" << endl;
+
+    // Large pair: time of single edits against a full run
+    const int size = 3000;
+    Node_Arena arena;
+    Tree tree1 = createRandomTree(size, 81, false, &arena);
+    Tree tree2 = createRandomTree(size, 82, false, &arena);
+    Node* root2 = tree2.get_root();
+    Tree_Editing ted(&tree1, &tree2);
+    auto start = std::chrono::high_resolution_clock::now();
+    ted.treeEditDistance(tree1, tree2);
+    auto end = std::chrono::high_resolution_clock::now();
+    double fullMs = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0;
+    const size_t allPairs = Prepared_Tree(tree1).keyroots.size() * Prepared_Tree(tree2).keyroots.size();
+    cout << "  Full run: " << fixed << setprecision(2) << fullMs << " ms, " << allPairs << " keyroot pairs" << endl;
+
+    ofstream file("INCREMENTAL_update_results.csv");
+    file << "Edit,Nodes,UpdateTimeMs,FullTimeMs,UpdatedPairs,AllPairs,Distance,Matches\n";
+    Tree current = indexTree(root2);
+    bool verified = mismatches == 0;
+    const char* kinds[] = {"Relabel", "Insert", "Delete"};
+    for (int edit = 0; edit < 6; ++edit) {
+        vector<Node*> changed;
+        srand(90 + edit);
+        const char* kind = kinds[applyRandomEdit(current, &arena, changed)];
+        current = indexTree(root2);
+        start = std::chrono::high_resolution_clock::now();
+        int updated = ted.updateTreeEditDistance(current, changed);
+        end = std::chrono::high_resolution_clock::now();
+        double ms = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0;
+        Tree_Editing fresh(&tree1, &current);
+        bool matches = updated == fresh.treeEditDistance(tree1, current);
+        verified = verified && matches;
+        cout << "  " << setw(8) << left << kind << right << setw(10) << ms << " ms, " << ted.updated_keyroot_pairs
+             << " keyroot pairs, distance " << updated << (matches ? "" : " - MISMATCH") << endl;
+        file << kind << "," << size << "," << fixed << setprecision(4) << ms << "," << fullMs << ","
+             << ted.updated_keyroot_pairs << "," << allPairs << "," << updated << "," << (matches ? "yes" : "no") << "\n";
+    }
+    cout << "  Updates " << (verified ? "match" : "DO NOT MATCH") << " fresh runs" << endl;
+    cout << "Results saved to: INCREMENTAL_update_results.csv" << endl;
+    cout << endl;
+}
+
+/**
+ * @brief Nearest-neighbour and range queries on a VP-tree against a linear scan
+ */
+void metric_index_tests() {
+    cout << "========================================" << endl;
+    cout << "  METRIC INDEX - VP-TREE QUERIES" << endl;
+    cout << "       Tree Edit Distance (TED)" << endl;
+    cout << "========================================" << endl;
+    cout << endl;
+
+    // Families of relabeled copies, so the corpus has clusters to find
+    const int families = 200;
+    const int copiesPerFamily = 10;
+    Metric_Index index;
+    Node_Arena arena;
+    vector<Tree> corpus;
+    corpus.reserve(families * copiesPerFamily);
+    for (int family = 0; family < families; ++family) {
+        for (int copy = 0; copy < copiesPerFamily; ++copy) {
+            corpus.push_back(createRelabeledTree(20 + family % 30, family, copy % 3, family * 1000 + copy, &arena));
+            index.insert(corpus.back());
+        }
+    }
+    cout << "Corpus: " << index.size() << " trees, " << index.build_distance_calls << " TED calls to build" << endl;
+
+    const int queries = 50;
+    const int k = 10;
+    const int radius = 3;
+
+    // Linear scan over the live items: every distance, sorted by distance then id. The k-NN
+    // answer must have the scan's first k distances (ties at the k-th may pick other ids),
+    // each with its true distance; the range answer must equal the scan's prefix within radius
+    vector<bool> live(corpus.size(), true);
+    Tree_Editing scanner;
+    auto matchesScan = [&](const Prepared_Tree& query, const vector<Metric_Index::Neighbour>& nearest,
+                           const vector<Metric_Index::Neighbour>& inRange) {
+        vector<Metric_Index::Neighbour> scan;
+        vector<int> distances(corpus.size(), -1);
+        for (int id = 0; id < (int)corpus.size(); ++id) {
+            if (!live[id]) continue;
+            distances[id] = scanner.treeEditDistance(query, index.item(id));
+            scan.push_back(make_pair(distances[id], id));
+        }
+        sort(scan.begin(), scan.end());
+        bool ok = nearest.size() == min((size_t)k, scan.size());
+        for (size_t r = 0; ok && r < nearest.size(); ++r) {
+            int id = nearest[r].second;
+            ok = nearest[r].first == scan[r].first && id >= 0 && id < (int)corpus.size() && distances[id] == nearest[r].first;
+        }
+        vector<Metric_Index::Neighbour> expected;
+        for (const Metric_Index::Neighbour& entry : scan) {
+            if (entry.first > radius) break;
+            expected.push_back(entry);
+        }
+        return ok && inRange == expected;
+    };
+
+    size_t knnCalls = 0, rangeCalls = 0, rangeResults = 0;
+    int mismatches = 0;
+    for (int q = 0; q < queries; ++q) {
+        Tree queryTree = createRelabeledTree(20 + (q * 4) % 30, q * 4, 2, q, &arena);
+        Prepared_Tree query(queryTree);
+        vector<Metric_Index::Neighbour> nearest = index.nearest(query, k);
+        knnCalls += index.last_distance_calls;
+        vector<Metric_Index::Neighbour> inRange = index.range(query, radius);
+        rangeResults += inRange.size();
+        rangeCalls += index.last_distance_calls;
+        mismatches += !matchesScan(query, nearest, inRange);
+    }
+    cout << "  " << k << "-NN query:        " << fixed << setprecision(1) << (double)knnCalls / queries
+         << " TED calls on average (linear scan: " << index.size() << ")" << endl;
+    cout << "  Range query (r=" << radius << "): " << (double)rangeCalls / queries
+         << " TED calls on average, " << (double)rangeResults / queries << " results" << endl;
+
+    // Remove half of the corpus and query again
+    for (int id = 0; id < families * copiesPerFamily; id += 2) {
+        index.remove(id);
+        live[id] = false;
+    }
+    knnCalls = 0;
+    for (int q = 0; q < queries; ++q) {
+        Tree queryTree = createRelabeledTree(20 + (q * 4) % 30, q * 4, 2, q, &arena);
+        Prepared_Tree query(queryTree);
+        vector<Metric_Index::Neighbour> nearest = index.nearest(query, k);
+        knnCalls += index.last_distance_calls;
+        mismatches += !matchesScan(query, nearest, index.range(query, radius));
+    }
+    cout << "  After removing half: " << (double)knnCalls / queries << " TED calls per " << k << "-NN query over "
+         << index.size() << " trees" << endl;
+    cout << "  " << 2 * queries << " queries before and after removal: results "
+         << (mismatches == 0 ? "match" : "DO NOT MATCH") << " a linear scan" << endl;
+    cout << endl;
+}
+
 /**
  * @brief Main function with test menu
  */
@@ -707,6 +2176,22 @@ int main() {
     
     random_tests();
     best_worst_case_tests();
+    engine_comparison_tests();
+    similarity_join_tests();
+    all_pairs_tests();
+    single_pair_thread_tests();
+    kernel_tests();
+    out_of_core_tests();
+    cost_policy_tests();
+    bounded_distance_tests();
+    edit_script_tests();
+    identical_subtree_tests();
+    incremental_update_tests();
+    metric_index_tests();
+    parser_tests();
+    arena_tests();
+    corpus_file_tests();
+    session_tests();
     
     return 0;
 }